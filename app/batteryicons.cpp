@@ -0,0 +1,164 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "batteryicons.h"
+#include "def.h"
+
+#include <QApplication>
+#include <QPainter>
+#include <QPolygonF>
+#include <QMap>
+#include <QDebug>
+
+static const int atlasSizes[] = { 16, 22, 24, 32, 48 };
+static const int atlasSizeCount = sizeof(atlasSizes)/sizeof(atlasSizes[0]);
+
+// one atlas per size: row 0 is discharging, row 1 is charging
+static QMap<int, QPixmap> atlas;
+static QIcon ac;
+static int renders = 0;
+
+static void drawBattery(QPainter *painter,
+                        const QRectF &cell,
+                        int percent,
+                        bool charging)
+{
+    qreal size = cell.width();
+    qreal line = qMax((qreal)1.0, size/16);
+    QColor outline = QApplication::palette().color(QPalette::WindowText);
+
+    QRectF body(cell.x()+size*0.06, cell.y()+size*0.25, size*0.8, size*0.5);
+    QRectF tip(body.right(), cell.y()+size*0.38, size*0.08, size*0.24);
+
+    painter->setPen(QPen(outline, line));
+    painter->setBrush(Qt::NoBrush);
+    painter->drawRoundedRect(body.adjusted(line/2, line/2, -line/2, -line/2),
+                             line, line);
+    painter->fillRect(tip, outline);
+
+    QColor fill("#4caf50");
+    if (percent <= 10) { fill = QColor("#e53935"); }
+    else if (percent <= 25) { fill = QColor("#fb8c00"); }
+    QRectF level = body.adjusted(line*2, line*2, -line*2, -line*2);
+    level.setWidth(level.width()*percent/100.0);
+    if (percent>0) { painter->fillRect(level, fill); }
+
+    if (!charging) { return; }
+    QPolygonF bolt;
+    qreal cx = body.center().x();
+    qreal cy = body.center().y();
+    qreal h = body.height()*0.8;
+    bolt << QPointF(cx+h*0.10, cy-h*0.50)
+         << QPointF(cx-h*0.30, cy+h*0.08)
+         << QPointF(cx-h*0.02, cy+h*0.08)
+         << QPointF(cx-h*0.10, cy+h*0.50)
+         << QPointF(cx+h*0.30, cy-h*0.08)
+         << QPointF(cx+h*0.02, cy-h*0.08);
+    painter->setPen(QPen(outline, line/2));
+    painter->setBrush(QColor("#fdd835"));
+    painter->drawPolygon(bolt);
+}
+
+// render all states (call again after theme/palette change)
+void BatteryIcons::render()
+{
+    atlas.clear();
+    for (int i=0;i<atlasSizeCount;++i) {
+        int size = atlasSizes[i];
+        QPixmap pixmap(size*BATTERY_ICON_STATES, size*2);
+        pixmap.fill(Qt::transparent);
+        QPainter painter(&pixmap);
+        painter.setRenderHint(QPainter::Antialiasing);
+        for (int row=0;row<2;++row) {
+            for (int percent=0;percent<BATTERY_ICON_STATES;++percent) {
+                drawBattery(&painter,
+                            QRectF(percent*size, row*size, size, size),
+                            percent,
+                            row == 1);
+            }
+        }
+        painter.end();
+        atlas[size] = pixmap;
+    }
+
+    ac = QIcon::fromTheme(DEFAULT_AC_ICON);
+    renders++;
+    qDebug() << "rendered battery icons" << atlas.keys();
+}
+
+void BatteryIcons::invalidate()
+{
+    atlas.clear();
+    ac = QIcon();
+    renders++;
+}
+
+int BatteryIcons::generation()
+{
+    return renders;
+}
+
+int BatteryIcons::index(double left, bool charging)
+{
+    int percent = qBound(0, qRound(left), BATTERY_ICON_STATES-1);
+    return (charging?BATTERY_ICON_STATES:0)+percent;
+}
+
+// only the requested state is copied out of the atlas
+QIcon BatteryIcons::icon(int index)
+{
+    if (atlas.isEmpty()) { render(); }
+    if (index<0 || index>=BATTERY_ICON_STATES*2) { return QIcon(); }
+    int row = index/BATTERY_ICON_STATES;
+    int percent = index%BATTERY_ICON_STATES;
+    QIcon result;
+    QMapIterator<int, QPixmap> sizes(atlas);
+    while (sizes.hasNext()) {
+        sizes.next();
+        int size = sizes.key();
+        result.addPixmap(sizes.value().copy(percent*size, row*size, size, size));
+    }
+    return result;
+}
+
+QIcon BatteryIcons::icon(double left, bool charging)
+{
+    return icon(index(left, charging));
+}
+
+QPixmap BatteryIcons::pixmap(double left, bool charging, int size)
+{
+    if (atlas.isEmpty()) { render(); }
+    if (!atlas.contains(size)) { return icon(left, charging).pixmap(size, size); }
+    int state = index(left, charging);
+    return atlas[size].copy((state%BATTERY_ICON_STATES)*size,
+                            (state/BATTERY_ICON_STATES)*size,
+                            size,
+                            size);
+}
+
+QIcon BatteryIcons::acIcon()
+{
+    if (atlas.isEmpty()) { render(); }
+    return ac;
+}
+
+// closest theme icon name (for trays that want names)
+QString BatteryIcons::iconName(double left, bool charging)
+{
+    if (left <= 10) {
+        return charging?DEFAULT_BATTERY_ICON_CRIT_AC:DEFAULT_BATTERY_ICON_CRIT;
+    } else if (left <= 25) {
+        return charging?DEFAULT_BATTERY_ICON_LOW_AC:DEFAULT_BATTERY_ICON_LOW;
+    } else if (left <= 75) {
+        return charging?DEFAULT_BATTERY_ICON_GOOD_AC:DEFAULT_BATTERY_ICON_GOOD;
+    } else if (left <= 90) {
+        return charging?DEFAULT_BATTERY_ICON_FULL_AC:DEFAULT_BATTERY_ICON_FULL;
+    }
+    return charging?DEFAULT_BATTERY_ICON_CHARGED:DEFAULT_BATTERY_ICON_FULL;
+}
@@ -0,0 +1,33 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BATTERYICONS_H
+#define BATTERYICONS_H
+
+#include <QIcon>
+#include <QPixmap>
+
+#define BATTERY_ICON_STATES 101 // 0-100%
+
+// battery icons for every percent (charging/discharging),
+// rendered once into one atlas per size, icons are cut on demand
+class BatteryIcons
+{
+public:
+    static void render();
+    static void invalidate();
+    static int generation(); // changes when icons must be reloaded
+    static int index(double left, bool charging);
+    static QIcon icon(int index);
+    static QIcon icon(double left, bool charging);
+    static QPixmap pixmap(double left, bool charging, int size);
+    static QIcon acIcon();
+    static QString iconName(double left, bool charging);
+};
+
+#endif // BATTERYICONS_H
@@ -0,0 +1,163 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "devicemodel.h"
+#include "def.h"
+#include "powerkit.h"
+
+#include <QApplication>
+#include <QStyle>
+#include <QStyleOptionProgressBar>
+#include <QPainter>
+#include <QSet>
+
+DeviceModel::DeviceModel(QObject *parent)
+    : QAbstractTableModel(parent)
+{
+}
+
+int DeviceModel::rowCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) { return 0; }
+    return items.size();
+}
+
+int DeviceModel::columnCount(const QModelIndex &parent) const
+{
+    if (parent.isValid()) { return 0; }
+    return DeviceColumnCount;
+}
+
+QVariant DeviceModel::data(const QModelIndex &index, int role) const
+{
+    if (!index.isValid() || index.row()>=items.size()) { return QVariant(); }
+    const DeviceItem &item = items.at(index.row());
+    switch (role) {
+    case Qt::DisplayRole:
+        if (index.column() == DeviceNameColumn) { return item.name; }
+        if (index.column() == DevicePercentColumn) { return item.percentage; }
+        break;
+    case Qt::DecorationRole:
+        if (index.column() == DeviceNameColumn) { return item.icon; }
+        break;
+    case DEVICE_UUID:
+        return item.path;
+    case DEVICE_TYPE:
+        return item.type;
+    default:;
+    }
+    return QVariant();
+}
+
+// fix row index after insert/remove
+void DeviceModel::reindex(int from)
+{
+    for (int i=from;i<items.size();++i) { rows[items.at(i).path] = i; }
+}
+
+// sync model with device list, remove devices not in the list
+void DeviceModel::setDevices(const QList<QVariantMap> &devices)
+{
+    QSet<QString> paths;
+    for (int i=0;i<devices.size();++i) {
+        const QVariantMap &device = devices.at(i);
+        if (!device.value(PK_DEVICE_PRESENT).toBool()) { continue; }
+        paths << device.value(PK_DEVICE_PATH).toString();
+        updateDevice(device);
+    }
+    for (int i=items.size()-1;i>=0;--i) {
+        if (paths.contains(items.at(i).path)) { continue; }
+        removeDevice(items.at(i).path);
+    }
+}
+
+// add or update device, only emits for changed rows
+void DeviceModel::updateDevice(const QVariantMap &device)
+{
+    QString path = device.value(PK_DEVICE_PATH).toString();
+    if (path.isEmpty()) { return; }
+    if (!device.value(PK_DEVICE_PRESENT).toBool()) {
+        removeDevice(path);
+        return;
+    }
+
+    DeviceItem item;
+    item.path = path;
+    item.name = device.value(PK_DEVICE_MODEL).toString();
+    if (item.name.isEmpty()) { item.name = device.value(PK_DEVICE_NAME).toString(); }
+    item.type = device.value(PK_DEVICE_TYPE).toUInt();
+    item.percentage = (int)device.value(PK_DEVICE_PERCENT).toDouble();
+
+    QHash<QString, int>::const_iterator row = rows.constFind(path);
+    if (row == rows.constEnd()) {
+        switch(item.type) {
+        case Device::DeviceKeyboard:
+            item.icon = QIcon::fromTheme(DEFAULT_KEYBOARD_ICON);
+            break;
+        case Device::DeviceMouse:
+            item.icon = QIcon::fromTheme(DEFAULT_MOUSE_ICON);
+            break;
+        default:
+            item.icon = QIcon::fromTheme(DEFAULT_BATTERY_ICON);
+        }
+        beginInsertRows(QModelIndex(), items.size(), items.size());
+        rows[path] = items.size();
+        items.append(item);
+        endInsertRows();
+        return;
+    }
+
+    DeviceItem &current = items[row.value()];
+    int first = DeviceColumnCount;
+    int last = -1;
+    if (current.name != item.name) {
+        current.name = item.name;
+        first = qMin(first, (int)DeviceNameColumn);
+        last = qMax(last, (int)DeviceNameColumn);
+    }
+    if (current.percentage != item.percentage) {
+        current.percentage = item.percentage;
+        first = qMin(first, (int)DevicePercentColumn);
+        last = qMax(last, (int)DevicePercentColumn);
+    }
+    if (last<0) { return; } // nothing changed
+    emit dataChanged(index(row.value(), first), index(row.value(), last));
+}
+
+void DeviceModel::removeDevice(const QString &path)
+{
+    if (!rows.contains(path)) { return; }
+    int row = rows.take(path);
+    beginRemoveRows(QModelIndex(), row, row);
+    items.removeAt(row);
+    reindex(row);
+    endRemoveRows();
+}
+
+void DeviceDelegate::paint(QPainter *painter,
+                           const QStyleOptionViewItem &option,
+                           const QModelIndex &index) const
+{
+    if (index.column() != DeviceModel::DevicePercentColumn) {
+        QStyledItemDelegate::paint(painter, option, index);
+        return;
+    }
+    int percentage = index.data().toInt();
+    QStyleOptionProgressBar bar;
+    bar.rect = option.rect.adjusted(2, 2, -2, -2);
+    bar.state = option.state;
+    bar.direction = option.direction;
+    bar.fontMetrics = option.fontMetrics;
+    bar.palette = option.palette;
+    bar.minimum = 0;
+    bar.maximum = 100;
+    bar.progress = percentage;
+    bar.text = QString("%1%").arg(percentage);
+    bar.textVisible = true;
+    QApplication::style()->drawControl(QStyle::CE_ProgressBar, &bar, painter);
+}
@@ -0,0 +1,70 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef DEVICEMODEL_H
+#define DEVICEMODEL_H
+
+#include <QAbstractTableModel>
+#include <QStyledItemDelegate>
+#include <QVariantMap>
+#include <QHash>
+#include <QList>
+#include <QIcon>
+
+#define DEVICE_UUID Qt::UserRole+1
+#define DEVICE_TYPE Qt::UserRole+2
+
+// devices (from PowerKit::Status) with a path to row index
+class DeviceModel : public QAbstractTableModel
+{
+    Q_OBJECT
+
+public:
+    enum DeviceColumn {
+        DeviceNameColumn,
+        DevicePercentColumn,
+        DeviceColumnCount
+    };
+
+    explicit DeviceModel(QObject *parent = NULL);
+    int rowCount(const QModelIndex &parent = QModelIndex()) const;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const;
+
+private:
+    struct DeviceItem {
+        QString path;
+        QString name;
+        uint type;
+        int percentage;
+        QIcon icon;
+    };
+    QList<DeviceItem> items;
+    QHash<QString, int> rows;
+    void reindex(int from);
+
+public slots:
+    void setDevices(const QList<QVariantMap> &devices);
+    void updateDevice(const QVariantMap &device);
+    void removeDevice(const QString &path);
+};
+
+// draws the device percentage as a progress bar
+class DeviceDelegate : public QStyledItemDelegate
+{
+    Q_OBJECT
+
+public:
+    explicit DeviceDelegate(QObject *parent = NULL)
+        : QStyledItemDelegate(parent) {}
+    void paint(QPainter *painter,
+               const QStyleOptionViewItem &option,
+               const QModelIndex &index) const;
+};
+
+#endif // DEVICEMODEL_H
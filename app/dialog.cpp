@@ -32,10 +32,12 @@ Dialog::Dialog(QWidget *parent)
     , hasBacklight(false)
     , backlightSlider(0)
     , backlightWatcher(0)
+    , backlightTransition(0)
     , man(0)
     , batteryIcon(0)
     , batteryLabel(0)
     , deviceTree(0)
+    , deviceModel(0)
     , batteryLeftLCD(0)
     , backlightSliderBattery(0)
     , backlightSliderAC(0)
@@ -55,6 +57,12 @@ Dialog::Dialog(QWidget *parent)
     , suspendLockScreen(0)
     , resumeLockScreen(0)
     , bypassKernel(0)
+    , writer(0)
+    , containerWidget(0)
+    , settingsContainerArea(0)
+    , settingsWidget(0)
+    , hasState(false)
+    , backlightProbed(false)
 {
     // setup dialog
     setAttribute(Qt::WA_QuitOnClose, true);
@@ -67,15 +75,46 @@ Dialog::Dialog(QWidget *parent)
                               POWERKIT_PATH,
                               POWERKIT_SERVICE,
                               session, this);
-    session.connect(dbus->service(),
-                   dbus->path(),
-                   dbus->service(),
-                   "UpdatedInhibitors",
-                   this,
-                   SLOT(handleUpdatedInhibitors()));
+    if (dbus->isValid()) { // use the running session
+        session.connect(dbus->service(),
+                        dbus->path(),
+                        dbus->service(),
+                        "UpdatedInhibitors",
+                        this,
+                        SLOT(handleUpdatedInhibitors()));
+        session.connect(dbus->service(),
+                        dbus->path(),
+                        dbus->service(),
+                        "UpdatedDevices",
+                        this,
+                        SLOT(handleUpdatedDevices()));
+        session.connect(dbus->service(),
+                        dbus->path(),
+                        dbus->service(),
+                        "DeviceWasRemoved",
+                        this,
+                        SLOT(deviceRemove(QString)));
+        session.connect(dbus->service(),
+                        dbus->path(),
+                        dbus->service(),
+                        "DeviceWasAdded",
+                        this,
+                        SLOT(handleDeviceAdded(QString)));
+    } else { // no session, setup powerkit
+        qDebug() << "no powerkit session, using local powerkit";
+        man = new PowerKit(this);
+        connect(man, SIGNAL(UpdatedDevices()),
+                this, SLOT(handleUpdatedDevices()));
+        connect(man, SIGNAL(DeviceWasRemoved(QString)),
+                this, SLOT(deviceRemove(QString)));
+        connect(man, SIGNAL(DeviceWasAdded(QString)),
+                this, SLOT(handleDeviceAdded(QString)));
+    }
 
-    // setup powerkit
-    man = new PowerKit(this);
+    // setup settings writer
+    writer = new SettingsWriter(this);
+    connect(writer, SIGNAL(flushed(QStringList)),
+            this, SLOT(handleSettingsFlushed(QStringList)));
 
     // check settings
     Common::checkSettings();
@@ -89,7 +128,7 @@ Dialog::Dialog(QWidget *parent)
     layout->setMargin(5);
     layout->setSpacing(0);
 
-    QTabWidget *containerWidget = new QTabWidget(this);
+    containerWidget = new QTabWidget(this);
 
     QWidget *wrapper = new QWidget(this);
     wrapper->setContentsMargins(0, 0, 0, 0);
@@ -99,6 +138,179 @@ Dialog::Dialog(QWidget *parent)
     wrapperLayout->setSpacing(0);
     wrapperLayout->addWidget(containerWidget);
 
+    // extra
+    QWidget *extraContainer = new QWidget(this);
+    QHBoxLayout *extraContainerLayout = new QHBoxLayout(extraContainer);
+
+    aboutButton = new QPushButton(this);
+    aboutButton->setIcon(QIcon::fromTheme(DEFAULT_ABOUT_ICON));
+    aboutButton->setIconSize(QSize(24, 24));
+    aboutButton->setToolTip(tr("About"));
+    if (aboutButton->icon().isNull()) {
+        aboutButton->setText(tr("About"));
+    }
+
+    lockscreenButton = new QPushButton(this);
+    lockscreenButton->setIcon(QIcon::fromTheme(DEFAULT_LOCK_ICON));
+    lockscreenButton->setIconSize(QSize(24, 24));
+    lockscreenButton->setToolTip(tr("Lock the screen now."));
+    if (lockscreenButton->icon().isNull()) {
+        lockscreenButton->setText(tr("Lock screen"));
+    }
+
+    sleepButton = new QPushButton(this);
+    sleepButton->setIcon(QIcon::fromTheme(DEFAULT_SUSPEND_ICON));
+    sleepButton->setIconSize(QSize(24, 24));
+    sleepButton->setToolTip(tr("Suspend computer now."));
+    if (sleepButton->icon().isNull()) {
+        sleepButton->setText(tr("Suspend"));
+    }
+
+    hibernateButton = new QPushButton(this);
+    hibernateButton->setIcon(QIcon::fromTheme(DEFAULT_HIBERNATE_ICON));
+    hibernateButton->setIconSize(QSize(24, 24));
+    hibernateButton->setToolTip(tr("Hibernate computer now."));
+    if (hibernateButton->icon().isNull()) {
+        hibernateButton->setText(tr("Hibernate"));
+    }
+
+    poweroffButton = new QPushButton(this);
+    poweroffButton->setIcon(QIcon::fromTheme(DEFAULT_SHUTDOWN_ICON));
+    poweroffButton->setIconSize(QSize(24, 24));
+    poweroffButton->setToolTip(tr("Shutdown computer now."));
+    if (poweroffButton->icon().isNull()) {
+        poweroffButton->setText(tr("Shutdown"));
+    }
+
+    backlightSlider = new QSlider(this);
+    backlightSlider->setMinimumWidth(100);
+    backlightSlider->setSingleStep(1);
+    backlightSlider->setOrientation(Qt::Horizontal);
+    backlightSlider->setToolTip(tr("Adjust the current brightness."));
+
+    QLabel *backlightLabel = new QLabel(this);
+    backlightLabel->setPixmap(QIcon::fromTheme(DEFAULT_BACKLIGHT_ICON)
+                              .pixmap(24, 24));
+
+    extraContainerLayout->addWidget(backlightLabel);
+    extraContainerLayout->addWidget(backlightSlider);
+    extraContainerLayout->addStretch();
+    extraContainerLayout->addWidget(aboutButton);
+    extraContainerLayout->addWidget(lockscreenButton);
+    extraContainerLayout->addWidget(sleepButton);
+    extraContainerLayout->addWidget(hibernateButton);
+    extraContainerLayout->addWidget(poweroffButton);
+
+    // status
+    QWidget *statusContainer = new QWidget(this);
+    QVBoxLayout *statusContainerLayout = new QVBoxLayout(statusContainer);
+
+    QGroupBox *batteryStatusBox = new QGroupBox(this);
+    batteryStatusBox->setSizePolicy(QSizePolicy::Expanding,
+                                    QSizePolicy::Fixed);
+    QHBoxLayout *batteryStatusLayout = new QHBoxLayout(batteryStatusBox);
+
+    batteryIcon = new QLabel(this);
+    batteryLabel = new QLabel(this);
+    batteryIcon->setPixmap(QIcon::fromTheme(DEFAULT_BATTERY_ICON)
+                           .pixmap(QSize(48, 48)));
+
+    batteryLeftLCD = new QLCDNumber(this);
+    batteryLeftLCD->setSizePolicy(QSizePolicy::Expanding,
+                                  QSizePolicy::Expanding);
+    batteryLeftLCD->setFrameStyle(QFrame::NoFrame);
+    batteryLeftLCD->setSegmentStyle(QLCDNumber::Flat);
+    batteryLeftLCD->display("00:00");
+
+    deviceModel = new DeviceModel(this);
+    deviceTree = new QTreeView(this);
+    deviceTree->setStyleSheet("QTreeView,QTreeView::item,"
+                              "QTreeView::item:selected"
+                              "{background:transparent;border:0;}");
+    deviceTree->setHeaderHidden(true);
+    deviceTree->setRootIsDecorated(false);
+    deviceTree->setSelectionMode(QAbstractItemView::NoSelection);
+    deviceTree->setUniformRowHeights(true);
+    deviceTree->setModel(deviceModel);
+    deviceTree->setItemDelegateForColumn(DeviceModel::DevicePercentColumn,
+                                         new DeviceDelegate(this));
+    deviceTree->setColumnWidth(DeviceModel::DeviceNameColumn, 150);
+
+    batteryStatusLayout->addWidget(batteryIcon);
+    batteryStatusLayout->addWidget(batteryLabel);
+    batteryStatusLayout->addStretch();
+    batteryStatusLayout->addWidget(batteryLeftLCD);
+
+    statusContainerLayout->addWidget(batteryStatusBox);
+    statusContainerLayout->addWidget(deviceTree);
+    statusContainerLayout->addStretch();
+
+    layout->addWidget(wrapper);
+    layout->addWidget(extraContainer);
+
+    // settings (built on first show)
+    settingsContainerArea = new QScrollArea(this);
+    settingsContainerArea->setSizePolicy(QSizePolicy::Expanding,
+                                         QSizePolicy::Expanding);
+    settingsContainerArea->setStyleSheet("QScrollArea {border:0;}");
+    settingsContainerArea->setWidgetResizable(true);
+
+    // inhibitors
+    inhibitorTree = new QTreeWidget(this);
+    inhibitorTree->setHeaderHidden(true);
+    inhibitorTree->setStyleSheet("QTreeWidget {border:0;}");
+
+    // add tabs
+    containerWidget->addTab(statusContainer,
+                            QIcon::fromTheme(DEFAULT_INFO_ICON),
+                            tr("Status"));
+    containerWidget->addTab(settingsContainerArea,
+                            QIcon::fromTheme(DEFAULT_BATTERY_ICON),
+                            tr("Settings"));
+    containerWidget->addTab(inhibitorTree,
+                            QIcon::fromTheme(DEFAULT_VIDEO_ICON),
+                            tr("Inhibitors"));
+
+    // power actions are enabled when we get the session state
+    sleepButton->setEnabled(false);
+    hibernateButton->setEnabled(false);
+    poweroffButton->setEnabled(false);
+    backlightSlider->setEnabled(false);
+
+    if (Common::validPowerSettings(CONF_DIALOG_GEOMETRY)) {
+        restoreGeometry(Common::loadPowerSettings(CONF_DIALOG_GEOMETRY).toByteArray());
+    }
+
+    // connect widgets
+    connect(containerWidget, SIGNAL(currentChanged(int)),
+            this, SLOT(handleTabChanged(int)));
+    connect(lockscreenButton, SIGNAL(released()),
+            this, SLOT(handleLockscreenButton()));
+    connect(sleepButton, SIGNAL(released()),
+            this, SLOT(handleSleepButton()));
+    connect(hibernateButton, SIGNAL(released()),
+            this, SLOT(handleHibernateButton()));
+    connect(poweroffButton, SIGNAL(released()),
+            this, SLOT(handlePoweroffButton()));
+    connect(aboutButton, SIGNAL(released()),
+            this, SLOT(showAboutDialog()));
+
+    // probe capabilities and backlight without blocking the first paint
+    updateState();
+    QTimer::singleShot(0, this, SLOT(loadBacklight()));
+}
+
+Dialog::~Dialog()
+{
+    writer->setValue(CONF_DIALOG, saveGeometry());
+    writer->flush();
+}
+
+// build the settings tab (on first show)
+void Dialog::setupSettings()
+{
+    if (settingsWidget) { return; }
+
     // battery
     QGroupBox *batteryContainer = new QGroupBox(this);
     batteryContainer->setTitle(tr("On Battery"));
@@ -480,119 +692,8 @@ Dialog::Dialog(QWidget *parent)
     notifyContainerLayout->addWidget(notifyOnBattery);
     notifyContainerLayout->addWidget(notifyOnAC);
 
-    // extra
-    QWidget *extraContainer = new QWidget(this);
-    QHBoxLayout *extraContainerLayout = new QHBoxLayout(extraContainer);
-
-    aboutButton = new QPushButton(this);
-    aboutButton->setIcon(QIcon::fromTheme(DEFAULT_ABOUT_ICON));
-    aboutButton->setIconSize(QSize(24, 24));
-    aboutButton->setToolTip(tr("About"));
-    if (aboutButton->icon().isNull()) {
-        aboutButton->setText(tr("About"));
-    }
-
-    lockscreenButton = new QPushButton(this);
-    lockscreenButton->setIcon(QIcon::fromTheme(DEFAULT_LOCK_ICON));
-    lockscreenButton->setIconSize(QSize(24, 24));
-    lockscreenButton->setToolTip(tr("Lock the screen now."));
-    if (lockscreenButton->icon().isNull()) {
-        lockscreenButton->setText(tr("Lock screen"));
-    }
-
-    sleepButton = new QPushButton(this);
-    sleepButton->setIcon(QIcon::fromTheme(DEFAULT_SUSPEND_ICON));
-    sleepButton->setIconSize(QSize(24, 24));
-    sleepButton->setToolTip(tr("Suspend computer now."));
-    if (sleepButton->icon().isNull()) {
-        sleepButton->setText(tr("Suspend"));
-    }
-
-    hibernateButton = new QPushButton(this);
-    hibernateButton->setIcon(QIcon::fromTheme(DEFAULT_HIBERNATE_ICON));
-    hibernateButton->setIconSize(QSize(24, 24));
-    hibernateButton->setToolTip(tr("Hibernate computer now."));
-    if (hibernateButton->icon().isNull()) {
-        hibernateButton->setText(tr("Hibernate"));
-    }
-
-    poweroffButton = new QPushButton(this);
-    poweroffButton->setIcon(QIcon::fromTheme(DEFAULT_SHUTDOWN_ICON));
-    poweroffButton->setIconSize(QSize(24, 24));
-    poweroffButton->setToolTip(tr("Shutdown computer now."));
-    if (poweroffButton->icon().isNull()) {
-        poweroffButton->setText(tr("Shutdown"));
-    }
-
-    backlightSlider = new QSlider(this);
-    backlightSlider->setMinimumWidth(100);
-    backlightSlider->setSingleStep(1);
-    backlightSlider->setOrientation(Qt::Horizontal);
-    backlightSlider->setToolTip(tr("Adjust the current brightness."));
-    backlightWatcher = new QFileSystemWatcher(this);
-
-    QLabel *backlightLabel = new QLabel(this);
-    backlightLabel->setPixmap(QIcon::fromTheme(DEFAULT_BACKLIGHT_ICON)
-                              .pixmap(24, 24));
-
-    extraContainerLayout->addWidget(backlightLabel);
-    extraContainerLayout->addWidget(backlightSlider);
-    extraContainerLayout->addStretch();
-    extraContainerLayout->addWidget(aboutButton);
-    extraContainerLayout->addWidget(lockscreenButton);
-    extraContainerLayout->addWidget(sleepButton);
-    extraContainerLayout->addWidget(hibernateButton);
-    extraContainerLayout->addWidget(poweroffButton);
-
-    // status
-    QWidget *statusContainer = new QWidget(this);
-    QVBoxLayout *statusContainerLayout = new QVBoxLayout(statusContainer);
-
-    QGroupBox *batteryStatusBox = new QGroupBox(this);
-    batteryStatusBox->setSizePolicy(QSizePolicy::Expanding,
-                                    QSizePolicy::Fixed);
-    QHBoxLayout *batteryStatusLayout = new QHBoxLayout(batteryStatusBox);
-
-    batteryIcon = new QLabel(this);
-    batteryLabel = new QLabel(this);
-    batteryIcon->setPixmap(QIcon::fromTheme(DEFAULT_BATTERY_ICON)
-                           .pixmap(QSize(48, 48)));
-
-    batteryLeftLCD = new QLCDNumber(this);
-    batteryLeftLCD->setSizePolicy(QSizePolicy::Expanding,
-                                  QSizePolicy::Expanding);
-    batteryLeftLCD->setFrameStyle(QFrame::NoFrame);
-    batteryLeftLCD->setSegmentStyle(QLCDNumber::Flat);
-    batteryLeftLCD->display("00:00");
-
-    deviceTree = new QTreeWidget(this);
-    deviceTree->setStyleSheet("QTreeWidget,QTreeWidget::item,"
-                              "QTreeWidget::item:selected"
-                              "{background:transparent;border:0;}");
-    deviceTree->setHeaderHidden(true);
-    deviceTree->setHeaderLabels(QStringList() << "1" << "2");
-    deviceTree->setColumnWidth(0, 150);
-
-    batteryStatusLayout->addWidget(batteryIcon);
-    batteryStatusLayout->addWidget(batteryLabel);
-    batteryStatusLayout->addStretch();
-    batteryStatusLayout->addWidget(batteryLeftLCD);
-
-    statusContainerLayout->addWidget(batteryStatusBox);
-    statusContainerLayout->addWidget(deviceTree);
-    statusContainerLayout->addStretch();
-
-    layout->addWidget(wrapper);
-    layout->addWidget(extraContainer);
-
-    QWidget *settingsWidget = new QWidget(this);
+    settingsWidget = new QWidget(this);
     QVBoxLayout *settingsLayout = new QVBoxLayout(settingsWidget);
-    QScrollArea *settingsContainerArea = new QScrollArea(this);
-    settingsContainerArea->setSizePolicy(QSizePolicy::Expanding,
-                                         QSizePolicy::Expanding);
-    settingsContainerArea->setStyleSheet("QScrollArea {border:0;}");
-    settingsContainerArea->setWidgetResizable(true);
-    settingsContainerArea->setWidget(settingsWidget);
 
     // add widgets to settings
     settingsLayout->addWidget(batteryContainer);
@@ -603,34 +704,13 @@ Dialog::Dialog(QWidget *parent)
     settingsLayout->addWidget(advContainer);
     settingsLayout->addStretch();
 
-    // inhibitors
-    inhibitorTree = new QTreeWidget(this);
-    inhibitorTree->setHeaderHidden(true);
-    inhibitorTree->setStyleSheet("QTreeWidget {border:0;}");
-
-    // add tabs
-    containerWidget->addTab(statusContainer,
-                            QIcon::fromTheme(DEFAULT_INFO_ICON),
-                            tr("Status"));
-    containerWidget->addTab(settingsContainerArea,
-                            QIcon::fromTheme(DEFAULT_BATTERY_ICON),
-                            tr("Settings"));
-    containerWidget->addTab(inhibitorTree,
-                            QIcon::fromTheme(DEFAULT_VIDEO_ICON),
-                            tr("Inhibitors"));
+    settingsContainerArea->setWidget(settingsWidget);
+    settingsWidget->show();
 
     populate(); // populate boxes
     loadSettings(); // load settings
 
     // connect widgets
-    connect(lockscreenButton, SIGNAL(released()),
-            this, SLOT(handleLockscreenButton()));
-    connect(sleepButton, SIGNAL(released()),
-            this, SLOT(handleSleepButton()));
-    connect(hibernateButton, SIGNAL(released()),
-            this, SLOT(handleHibernateButton()));
-    connect(poweroffButton, SIGNAL(released()),
-            this, SLOT(handlePoweroffButton()));
     connect(lidActionBattery, SIGNAL(currentIndexChanged(int)),
             this, SLOT(handleLidActionBattery(int)));
     connect(lidActionAC, SIGNAL(currentIndexChanged(int)),
@@ -657,16 +737,6 @@ Dialog::Dialog(QWidget *parent)
             this, SLOT(handleAutoSleepBatteryAction(int)));
     connect(autoSleepACAction, SIGNAL(currentIndexChanged(int)),
             this, SLOT(handleAutoSleepACAction(int)));
-    connect(backlightSlider, SIGNAL(valueChanged(int)),
-            this, SLOT(handleBacklightSlider(int)));
-    connect(backlightWatcher, SIGNAL(fileChanged(QString)),
-            this, SLOT(updateBacklight(QString)));
-    connect(man, SIGNAL(UpdatedDevices()),
-            this, SLOT(checkDevices()));
-    connect(man, SIGNAL(DeviceWasRemoved(QString)),
-            this, SLOT(deviceRemove(QString)));
-    connect(man, SIGNAL(DeviceWasAdded(QString)),
-            this, SLOT(handleDeviceAdded(QString)));
     connect(backlightBatteryCheck, SIGNAL(toggled(bool)),
             this, SLOT(handleBacklightBatteryCheck(bool)));
     connect(backlightACCheck, SIGNAL(toggled(bool)),
@@ -679,8 +749,6 @@ Dialog::Dialog(QWidget *parent)
             this, SLOT(handleBacklightBatteryCheckLower(bool)));
     connect(backlightACHigherCheck, SIGNAL(toggled(bool)),
             this, SLOT(handleBacklightACCheckHigher(bool)));
-    connect(aboutButton, SIGNAL(released()),
-            this, SLOT(showAboutDialog()));
     connect(warnOnLowBattery, SIGNAL(toggled(bool)),
             this, SLOT(handleWarnOnLowBattery(bool)));
     connect(warnOnVeryLowBattery, SIGNAL(toggled(bool)),
@@ -699,12 +767,6 @@ Dialog::Dialog(QWidget *parent)
             this, SLOT(handleKernelBypass(bool)));
 }
 
-Dialog::~Dialog()
-{
-    Common::savePowerSettings(CONF_DIALOG,
-                              saveGeometry());
-}
-
 // populate widgets with default values
 void Dialog::populate()
 {
@@ -772,10 +834,6 @@ void Dialog::populate()
 // load settings and set defaults
 void Dialog::loadSettings()
 {
-    if (Common::validPowerSettings(CONF_DIALOG_GEOMETRY)) {
-        restoreGeometry(Common::loadPowerSettings(CONF_DIALOG_GEOMETRY).toByteArray());
-    }
-
     int defaultAutoSleepBattery = AUTO_SLEEP_BATTERY;
     if (Common::validPowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT)) {
         defaultAutoSleepBattery = Common::loadPowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT).toInt();
@@ -896,51 +954,17 @@ void Dialog::loadSettings()
     }
     bypassKernel->setChecked(defaultKernelBypass);
 
-    // power actions
-    bool canSuspend = man->CanSuspend();
-    bool canHibernate = man->CanHibernate() && Common::kernelCanResume(bypassKernel->isChecked());
-    bool canShutdown = man->CanPowerOff();
-    qDebug() << "can suspend?" << canSuspend << "can hibernate?" << canHibernate << "can shutdown?" << canShutdown;
-    QString notSupported = tr("%1 is not supported. Check permissions and/or settings.");
-    sleepButton->setEnabled(canSuspend);
-    hibernateButton->setEnabled(canHibernate &&
-                                Common::kernelCanResume(bypassKernel->isChecked()));
-    poweroffButton->setEnabled(canShutdown);
-    if (!canSuspend) {
-        sleepButton->setToolTip(notSupported.arg(tr("Suspend")));
-    }
-    if (!canHibernate) {
-        hibernateButton->setToolTip(notSupported.arg(tr("Hibernate")));
-    }
-    if (!canShutdown) {
-        poweroffButton->setToolTip(notSupported.arg(tr("Shutdown")));
-    }
-
-    checkPerms();
+    if (hasState) { checkPerms(); }
 
     // backlight
-    backlightDevice = Common::backlightDevice();
-    hasBacklight = Common::canAdjustBacklight(backlightDevice);
+    if (!backlightProbed) { loadBacklight(); }
     if (hasBacklight) {
-        backlightSlider->setMinimum(1);
-        backlightSlider->setMaximum(Common::backlightMax(backlightDevice));
-        backlightSlider->setValue(Common::backlightValue(backlightDevice));
-
-        backlightSlider->setEnabled(true);
-        backlightSliderAC->setEnabled(true);
-        backlightSliderBattery->setEnabled(true);
-
-        backlightWatcher->addPath(QString("%1/brightness").arg(backlightDevice));
         backlightSliderBattery->setMinimum(backlightSlider->minimum());
         backlightSliderBattery->setMaximum(backlightSlider->maximum());
         backlightSliderBattery->setValue(backlightSliderBattery->maximum());
         backlightSliderAC->setMinimum(backlightSlider->minimum());
         backlightSliderAC->setMaximum(backlightSlider->maximum());
         backlightSliderAC->setValue(backlightSliderAC->maximum());
-    } else {
-        backlightSlider->setDisabled(true);
-        backlightSliderAC->setDisabled(true);
-        backlightSliderBattery->setDisabled(true);
     }
     backlightBatteryCheck->setChecked(Common::loadPowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE)
                                       .toBool());
@@ -971,71 +995,66 @@ void Dialog::loadSettings()
     backlightMouseWheel->setChecked(defaultBacklightMouseWheel);
 
     enableBacklight(hasBacklight);
-    enableLid(man->LidIsPresent());
-
-    // check devices
-    checkDevices();
-
-    // check inhibitors
-    getInhibitors();
+    enableLid(state.value(UPOWER_LID_IS_PRESENT).toBool());
+    lockSettings();
 }
 
 void Dialog::saveSettings()
 {
-    Common::savePowerSettings(CONF_LID_BATTERY_ACTION,
-                              lidActionBattery->currentIndex());
-    Common::savePowerSettings(CONF_LID_AC_ACTION,
-                              lidActionAC->currentIndex());
-    Common::savePowerSettings(CONF_CRITICAL_BATTERY_ACTION,
-                              criticalActionBattery->currentIndex());
-    Common::savePowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT,
-                              criticalBattery->value());
-    Common::savePowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT,
-                              autoSleepBattery->value());
-    Common::savePowerSettings(CONF_SUSPEND_AC_TIMEOUT,
-                              autoSleepAC->value());
-    Common::savePowerSettings(CONF_FREEDESKTOP_SS,
-                              desktopSS->isChecked());
-    Common::savePowerSettings(CONF_FREEDESKTOP_PM,
-                              desktopPM->isChecked());
-    Common::savePowerSettings(CONF_TRAY_NOTIFY,
-                              showNotifications->isChecked());
-    Common::savePowerSettings(CONF_TRAY_SHOW,
-                              showSystemTray->isChecked());
-    Common::savePowerSettings(CONF_LID_DISABLE_IF_EXTERNAL,
-                              disableLidAction->isChecked());
-    Common::savePowerSettings(CONF_SUSPEND_BATTERY_ACTION,
-                              autoSleepBatteryAction->currentIndex());
-    Common::savePowerSettings(CONF_SUSPEND_AC_ACTION,
-                              autoSleepACAction->currentIndex());
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE,
-                              backlightBatteryCheck->isChecked());
-    Common::savePowerSettings(CONF_BACKLIGHT_AC_ENABLE,
-                              backlightACCheck->isChecked());
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY,
-                              backlightSliderBattery->value());
-    Common::savePowerSettings(CONF_BACKLIGHT_AC,
-                              backlightSliderAC->value());
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER,
-                              backlightBatteryLowerCheck->isChecked());
-    Common::savePowerSettings(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER,
-                              backlightACHigherCheck->isChecked());
-    Common::savePowerSettings(CONF_DIALOG,
-                              saveGeometry());
-    Common::savePowerSettings(CONF_WARN_ON_LOW_BATTERY,
-                              warnOnLowBattery->isChecked());
-    Common::savePowerSettings(CONF_WARN_ON_VERYLOW_BATTERY,
-                              warnOnVeryLowBattery->isChecked());
-    Common::savePowerSettings(CONF_NOTIFY_ON_BATTERY,
-                              notifyOnBattery->isChecked());
-    Common::savePowerSettings(CONF_NOTIFY_ON_AC,
-                              notifyOnAC->isChecked());
-    Common::savePowerSettings(CONF_BACKLIGHT_MOUSE_WHEEL,
-                              backlightMouseWheel->isChecked());
-    Common::savePowerSettings(CONF_SUSPEND_LOCK_SCREEN,
-                              suspendLockScreen->isChecked());
-    Common::savePowerSettings(CONF_RESUME_LOCK_SCREEN,
-                              resumeLockScreen->isChecked());
+    writer->setValue(CONF_LID_BATTERY_ACTION,
+                     lidActionBattery->currentIndex());
+    writer->setValue(CONF_LID_AC_ACTION,
+                     lidActionAC->currentIndex());
+    writer->setValue(CONF_CRITICAL_BATTERY_ACTION,
+                     criticalActionBattery->currentIndex());
+    writer->setValue(CONF_CRITICAL_BATTERY_TIMEOUT,
+                     criticalBattery->value());
+    writer->setValue(CONF_SUSPEND_BATTERY_TIMEOUT,
+                     autoSleepBattery->value());
+    writer->setValue(CONF_SUSPEND_AC_TIMEOUT,
+                     autoSleepAC->value());
+    writer->setValue(CONF_FREEDESKTOP_SS,
+                     desktopSS->isChecked());
+    writer->setValue(CONF_FREEDESKTOP_PM,
+                     desktopPM->isChecked());
+    writer->setValue(CONF_TRAY_NOTIFY,
+                     showNotifications->isChecked());
+    writer->setValue(CONF_TRAY_SHOW,
+                     showSystemTray->isChecked());
+    writer->setValue(CONF_LID_DISABLE_IF_EXTERNAL,
+                     disableLidAction->isChecked());
+    writer->setValue(CONF_SUSPEND_BATTERY_ACTION,
+                     autoSleepBatteryAction->currentIndex());
+    writer->setValue(CONF_SUSPEND_AC_ACTION,
+                     autoSleepACAction->currentIndex());
+    writer->setValue(CONF_BACKLIGHT_BATTERY_ENABLE,
+                     backlightBatteryCheck->isChecked());
+    writer->setValue(CONF_BACKLIGHT_AC_ENABLE,
+                     backlightACCheck->isChecked());
+    writer->setValue(CONF_BACKLIGHT_BATTERY,
+                     backlightSliderBattery->value());
+    writer->setValue(CONF_BACKLIGHT_AC,
+                     backlightSliderAC->value());
+    writer->setValue(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER,
+                     backlightBatteryLowerCheck->isChecked());
+    writer->setValue(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER,
+                     backlightACHigherCheck->isChecked());
+    writer->setValue(CONF_DIALOG,
+                     saveGeometry());
+    writer->setValue(CONF_WARN_ON_LOW_BATTERY,
+                     warnOnLowBattery->isChecked());
+    writer->setValue(CONF_WARN_ON_VERYLOW_BATTERY,
+                     warnOnVeryLowBattery->isChecked());
+    writer->setValue(CONF_NOTIFY_ON_BATTERY,
+                     notifyOnBattery->isChecked());
+    writer->setValue(CONF_NOTIFY_ON_AC,
+                     notifyOnAC->isChecked());
+    writer->setValue(CONF_BACKLIGHT_MOUSE_WHEEL,
+                     backlightMouseWheel->isChecked());
+    writer->setValue(CONF_SUSPEND_LOCK_SCREEN,
+                     suspendLockScreen->isChecked());
+    writer->setValue(CONF_RESUME_LOCK_SCREEN,
+                     resumeLockScreen->isChecked());
 }
 
 // set default action in combobox
@@ -1070,39 +1089,39 @@ void Dialog::setDefaultAction(QComboBox *box, QString value)
 void Dialog::handleLidActionBattery(int index)
 {
     checkPerms();
-    Common::savePowerSettings(CONF_LID_BATTERY_ACTION, index);
+    writer->setValue(CONF_LID_BATTERY_ACTION, index);
 }
 
 void Dialog::handleLidActionAC(int index)
 {
     checkPerms();
-    Common::savePowerSettings(CONF_LID_AC_ACTION, index);
+    writer->setValue(CONF_LID_AC_ACTION, index);
 }
 
 void Dialog::handleCriticalAction(int index)
 {
     checkPerms();
-    Common::savePowerSettings(CONF_CRITICAL_BATTERY_ACTION, index);
+    writer->setValue(CONF_CRITICAL_BATTERY_ACTION, index);
 }
 
 void Dialog::handleCriticalBattery(int value)
 {
-    Common::savePowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT, value);
+    writer->setValue(CONF_CRITICAL_BATTERY_TIMEOUT, value);
 }
 
 void Dialog::handleAutoSleepBattery(int value)
 {
-    Common::savePowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT, value);
+    writer->setValue(CONF_SUSPEND_BATTERY_TIMEOUT, value);
  }
 
 void Dialog::handleAutoSleepAC(int value)
 {
-    Common::savePowerSettings(CONF_SUSPEND_AC_TIMEOUT, value);
+    writer->setValue(CONF_SUSPEND_AC_TIMEOUT, value);
 }
 
 void Dialog::handleDesktopSS(bool triggered)
 {
-    Common::savePowerSettings(CONF_FREEDESKTOP_SS, triggered);
+    writer->setValue(CONF_FREEDESKTOP_SS, triggered);
     QMessageBox::information(this, tr("Restart required"),
                              tr("You must restart the powerkit daemon to apply this setting"));
     // TODO: add restart now?
@@ -1110,7 +1129,7 @@ void Dialog::handleDesktopSS(bool triggered)
 
 void Dialog::handleDesktopPM(bool triggered)
 {
-    Common::savePowerSettings(CONF_FREEDESKTOP_PM, triggered);
+    writer->setValue(CONF_FREEDESKTOP_PM, triggered);
     QMessageBox::information(this, tr("Restart required"),
                              tr("You must restart the powerkit daemon to apply this setting"));
     // TODO: add restart now?
@@ -1118,34 +1137,34 @@ void Dialog::handleDesktopPM(bool triggered)
 
 void Dialog::handleShowNotifications(bool triggered)
 {
-    Common::savePowerSettings(CONF_TRAY_NOTIFY, triggered);
+    writer->setValue(CONF_TRAY_NOTIFY, triggered);
 }
 
 void Dialog::handleShowSystemTray(bool triggered)
 {
-    Common::savePowerSettings(CONF_TRAY_SHOW, triggered);
+    writer->setValue(CONF_TRAY_SHOW, triggered);
 }
 
 void Dialog::handleDisableLidAction(bool triggered)
 {
-    Common::savePowerSettings(CONF_LID_DISABLE_IF_EXTERNAL, triggered);
+    writer->setValue(CONF_LID_DISABLE_IF_EXTERNAL, triggered);
 }
 
 void Dialog::handleAutoSleepBatteryAction(int index)
 {
     checkPerms();
-    Common::savePowerSettings(CONF_SUSPEND_BATTERY_ACTION, index);
+    writer->setValue(CONF_SUSPEND_BATTERY_ACTION, index);
 }
 
 void Dialog::handleAutoSleepACAction(int index)
 {
     checkPerms();
-    Common::savePowerSettings(CONF_SUSPEND_AC_ACTION, index);
+    writer->setValue(CONF_SUSPEND_AC_ACTION, index);
 }
 
 void Dialog::handleLockscreenButton()
 {
-    man->LockScreen();
+    powerAction("LockScreen");
 }
 
 void Dialog::handleSleepButton()
@@ -1155,7 +1174,7 @@ void Dialog::handleSleepButton()
                               tr("Are you sure you want to suspend?"),
                               QMessageBox::Yes,
                               QMessageBox::No) == QMessageBox::No) { return; }
-    if (man->CanSuspend()) { man->Suspend(); }
+    if (state.value(PK_CAN_SUSPEND).toBool()) { powerAction(PK_SUSPEND); }
     else {
         QMessageBox::information(this,
                                  tr("Power Action"),
@@ -1172,8 +1191,8 @@ void Dialog::handleHibernateButton()
                               tr("Are you sure you want to hibernate?"),
                               QMessageBox::Yes,
                               QMessageBox::No) == QMessageBox::No) { return; }
-    if (man->CanHibernate() &&
-        Common::kernelCanResume(bypassKernel->isChecked())) { man->Hibernate(); }
+    if (state.value(PK_CAN_HIBERNATE).toBool() &&
+        Common::kernelCanResume(kernelBypass())) { powerAction(PK_HIBERNATE); }
     else {
         QMessageBox::information(this,
                                  tr("Power Action"),
@@ -1190,7 +1209,7 @@ void Dialog::handlePoweroffButton()
                               tr("Are you sure you want to shutdown?"),
                               QMessageBox::Yes,
                               QMessageBox::No) == QMessageBox::No) { return; }
-    if (man->CanPowerOff()) { man->PowerOff(); }
+    if (state.value(PK_CAN_POWEROFF).toBool()) { powerAction(PK_POWEROFF); }
     else {
         QMessageBox::information(this,
                                  tr("Power Action"),
@@ -1202,7 +1221,7 @@ void Dialog::handlePoweroffButton()
 
 void Dialog::checkPerms()
 {
-    if (!Common::kernelCanResume(bypassKernel->isChecked()) || !hibernateButton->isEnabled()) {
+    if (!Common::kernelCanResume(kernelBypass()) || !hibernateButton->isEnabled()) {
         bool warnCantHibernate = false;
         if (criticalActionBattery->currentIndex() == criticalHibernate) {
             warnCantHibernate = true;
@@ -1263,15 +1282,17 @@ void Dialog::checkPerms()
 
 void Dialog::handleBacklightSlider(int value)
 {
-    if (Common::backlightValue(backlightDevice) != value) {
-        Common::adjustBacklight(backlightDevice, value);
-    }
+    if (!backlightTransition) { return; }
+    backlightTransition->setValue(value);
 }
 
 void Dialog::updateBacklight(QString file)
 {
     Q_UNUSED(file);
     if (!hasBacklight) { return; }
+    // our own change in progress
+    if (backlightSlider->isSliderDown() ||
+        (backlightTransition && backlightTransition->isActive())) { return; }
     int value = Common::backlightValue(backlightDevice);
     if (value != backlightSlider->value()) {
         backlightSlider->setValue(value);
@@ -1280,12 +1301,21 @@ void Dialog::updateBacklight(QString file)
 
 void Dialog::checkDevices()
 {
-    double left = man->BatteryLeft();
+    double left = state.value(PK_BATTERY_LEFT).toDouble();
     if (left<0) { left = 0; }
     if (left>100) { left = 100; }
+    bool onBattery = state.value(UPOWER_ON_BATTERY).toBool();
+    bool hasBattery = state.value(PK_HAS_BATTERY).toBool();
 
-    if (man->HasBattery()) {
-        batteryLeftLCD->display(QDateTime::fromTime_t(man->OnBattery()?man->TimeToEmpty():man->TimeToFull())
+    if (hasBattery) {
+        qlonglong time = 0;
+        if (state.value(PK_ESTIMATE_CONFIDENCE).toDouble()>=ESTIMATOR_MIN_CONFIDENCE) {
+            time = state.value(onBattery?PK_ESTIMATED_TIME_TO_EMPTY:PK_ESTIMATED_TIME_TO_FULL).toLongLong();
+        }
+        if (time<1) {
+            time = state.value(onBattery?PK_TIME_TO_EMPTY:PK_TIME_TO_FULL).toLongLong();
+        }
+        batteryLeftLCD->display(QDateTime::fromTime_t(time)
                                 .toUTC().toString("hh:mm"));
         batteryLabel->setText(QString("<h1 style=\"font-weight:normal;\">%1%</h1>").arg(left));
     } else {
@@ -1293,115 +1323,49 @@ void Dialog::checkDevices()
         batteryLabel->setText(QString("<h1 style=\"font-weight:normal;\">%1</h1>").arg(tr("AC")));
     }
 
-    QMapIterator<QString, Device*> i(man->getDevices());
-    while (i.hasNext()) {
-        i.next();
-        //qDebug() << i.value()->name << i.value()->model << i.value()->type  << i.value()->isPresent << i.value()->objectName() << i.value()->percentage;
-        QString uid = i.value()->path;
-        if (!i.value()->isPresent) {
-            if (deviceExists(uid)) { deviceRemove(uid); }
-            continue;
-        }
-        if (!deviceExists(uid)) {
-            QTreeWidgetItem *item = new QTreeWidgetItem(deviceTree);
-            item->setText(0, i.value()->model.isEmpty()?i.value()->name:i.value()->model);
-            item->setData(0, DEVICE_UUID, uid);
-            item->setFlags(Qt::ItemIsEnabled);
-            QIcon itemIcon;
-            switch(i.value()->type) {
-            case Device::DeviceKeyboard:
-                itemIcon = QIcon::fromTheme(DEFAULT_KEYBOARD_ICON);
-                break;
-            case Device::DeviceMouse:
-                itemIcon = QIcon::fromTheme(DEFAULT_MOUSE_ICON);
-                break;
-            default:
-                itemIcon = QIcon::fromTheme(DEFAULT_BATTERY_ICON);
-            }
-            item->setIcon(0, itemIcon);
-            devicesProg[uid] = new QProgressBar(this);
-            devicesProg[uid]->setMinimum(0);
-            devicesProg[uid]->setMaximum(100);
-            devicesProg[uid]->setValue((int)i.value()->percentage);
-            deviceTree->setItemWidget(item, 1, devicesProg[uid]);
-        } else {
-            devicesProg[i.value()->path]->setValue((int)i.value()->percentage);
-        }
-    }
+    QList<QVariantMap> devices;
+    QVariantList list = variantToList(state.value(PK_DEVICES));
+    for (int i=0;i<list.size();++i) { devices << variantToMap(list.at(i)); }
+    deviceModel->setDevices(devices);
 
-    QIcon icon = QIcon::fromTheme(DEFAULT_AC_ICON);
-    if (left <1 || !man->HasBattery()) {
-        batteryIcon->setPixmap(icon.pixmap(QSize(48, 48)));
+    if (left <1 || !hasBattery || (left > 99 && !onBattery)) {
+        batteryIcon->setPixmap(BatteryIcons::acIcon().pixmap(QSize(48, 48)));
         return;
     }
-    if (left <= 10) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_CRIT:DEFAULT_BATTERY_ICON_CRIT_AC);
-    } else if (left <= 25) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_LOW:DEFAULT_BATTERY_ICON_LOW_AC);
-    } else if (left <= 75) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_GOOD:DEFAULT_BATTERY_ICON_GOOD_AC);
-    } else if (left <= 90) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_FULL:DEFAULT_BATTERY_ICON_FULL_AC);
-    } else {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_FULL:DEFAULT_BATTERY_ICON_CHARGED);
-        if (left > 99 && !man->OnBattery()) {
-            icon = QIcon::fromTheme(DEFAULT_AC_ICON);
-        }
-    }
-    batteryIcon->setPixmap(icon.pixmap(QSize(48, 48)));
-}
-
-bool Dialog::deviceExists(QString uid)
-{
-    for (int i=0;i<deviceTree->topLevelItemCount();++i) {
-        QTreeWidgetItem *item = deviceTree->topLevelItem(i);
-        if (!item) { continue; }
-        if (item->data(0, DEVICE_UUID) == uid) { return true; }
-    }
-    return false;
+    batteryIcon->setPixmap(BatteryIcons::pixmap(left, !onBattery, 48));
 }
 
 void Dialog::deviceRemove(QString uid)
 {
-    for (int i=0;i<deviceTree->topLevelItemCount();++i) {
-        QTreeWidgetItem *item = deviceTree->topLevelItem(i);
-        if (!item) { continue; }
-        if (item->data(0, DEVICE_UUID) == uid) {
-            delete deviceTree->takeTopLevelItem(i);
-        }
-    }
-    if (devicesProg.contains(uid)) {
-        devicesProg[uid]->deleteLater();
-        devicesProg.remove(uid);
-    }
+    deviceModel->removeDevice(uid);
 }
 
 void Dialog::handleDeviceAdded(QString uid)
 {
     Q_UNUSED(uid)
-    checkDevices();
+    handleUpdatedDevices();
 }
 
 void Dialog::handleBacklightBatteryCheck(bool triggered)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE, triggered);
+    writer->setValue(CONF_BACKLIGHT_BATTERY_ENABLE, triggered);
     handleBacklightBatterySlider(backlightSliderBattery->value());
 }
 
 void Dialog::handleBacklightACCheck(bool triggered)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_AC_ENABLE, triggered);
+    writer->setValue(CONF_BACKLIGHT_AC_ENABLE, triggered);
     handleBacklightACSlider(backlightSliderAC->value());
 }
 
 void Dialog::handleBacklightBatterySlider(int value)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY, value);
+    writer->setValue(CONF_BACKLIGHT_BATTERY, value);
 }
 
 void Dialog::handleBacklightACSlider(int value)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_AC, value);
+    writer->setValue(CONF_BACKLIGHT_AC, value);
 }
 
 void Dialog::hibernateWarn()
@@ -1420,37 +1384,28 @@ void Dialog::sleepWarn()
 
 void Dialog::handleBacklightBatteryCheckLower(bool triggered)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER, triggered);
+    writer->setValue(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER, triggered);
 }
 
 void Dialog::handleBacklightACCheckHigher(bool triggered)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER, triggered);
+    writer->setValue(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER, triggered);
 }
 
 void Dialog::handleUpdatedInhibitors()
 {
+    updateStatus();
     getInhibitors();
 }
 
 void Dialog::getInhibitors()
 {
-    if (!dbus->isValid()) { return; }
     inhibitorTree->clear();
-    QDBusMessage replySS =  dbus->call("ScreenSaverInhibitors");
-    QDBusMessage replyPM =  dbus->call("PowerManagementInhibitors");
-    QStringList ssList = replySS.arguments().last().toStringList();
-    QStringList pmList = replyPM.arguments().last().toStringList();
-    for (int i=0;i<ssList.size();++i) {
-        QString inhibitor = ssList.at(i);
-        if (inhibitor.isEmpty()) { continue; }
-        QTreeWidgetItem *item = new QTreeWidgetItem(inhibitorTree);
-        item->setText(0, inhibitor);
-        item->setFlags(Qt::ItemIsEnabled);
-        item->setIcon(0, QIcon::fromTheme(DEFAULT_TRAY_ICON));
-    }
-    for (int i=0;i<pmList.size();++i) {
-        QString inhibitor = pmList.at(i);
+    QStringList inhibitors;
+    inhibitors << state.value(PK_SS_INHIBITORS).toStringList();
+    inhibitors << state.value(PK_PM_INHIBITORS).toStringList();
+    for (int i=0;i<inhibitors.size();++i) {
+        QString inhibitor = inhibitors.at(i);
         if (inhibitor.isEmpty()) { continue; }
         QTreeWidgetItem *item = new QTreeWidgetItem(inhibitorTree);
         item->setText(0, inhibitor);
@@ -1462,6 +1417,7 @@ void Dialog::getInhibitors()
 void Dialog::enableBacklight(bool enabled)
 {
     backlightSlider->setEnabled(enabled);
+    if (!settingsWidget) { return; }
     backlightSliderBattery->setEnabled(enabled);
     backlightSliderAC->setEnabled(enabled);
     backlightBatteryCheck->setEnabled(enabled);
@@ -1508,26 +1464,68 @@ void Dialog::showAboutDialog()
 
 void Dialog::handleWarnOnLowBattery(bool triggered)
 {
-    Common::savePowerSettings(CONF_WARN_ON_LOW_BATTERY, triggered);
+    writer->setValue(CONF_WARN_ON_LOW_BATTERY, triggered);
 }
 
 void Dialog::handleWarnOnVeryLowBattery(bool triggered)
 {
-    Common::savePowerSettings(CONF_WARN_ON_VERYLOW_BATTERY, triggered);
+    writer->setValue(CONF_WARN_ON_VERYLOW_BATTERY, triggered);
 }
 
 void Dialog::handleNotifyBattery(bool triggered)
 {
-    Common::savePowerSettings(CONF_NOTIFY_ON_BATTERY, triggered);
+    writer->setValue(CONF_NOTIFY_ON_BATTERY, triggered);
 }
 
 void Dialog::handleNotifyAC(bool triggered)
 {
-    Common::savePowerSettings(CONF_NOTIFY_ON_AC, triggered);
+    writer->setValue(CONF_NOTIFY_ON_AC, triggered);
+}
+
+// disable widgets for settings locked in system drop-ins
+void Dialog::lockSettings()
+{
+    QMap<QString, QWidget*> widgets;
+    widgets[CONF_LID_BATTERY_ACTION] = lidActionBattery;
+    widgets[CONF_LID_AC_ACTION] = lidActionAC;
+    widgets[CONF_CRITICAL_BATTERY_ACTION] = criticalActionBattery;
+    widgets[CONF_CRITICAL_BATTERY_TIMEOUT] = criticalBattery;
+    widgets[CONF_SUSPEND_BATTERY_TIMEOUT] = autoSleepBattery;
+    widgets[CONF_SUSPEND_AC_TIMEOUT] = autoSleepAC;
+    widgets[CONF_SUSPEND_BATTERY_ACTION] = autoSleepBatteryAction;
+    widgets[CONF_SUSPEND_AC_ACTION] = autoSleepACAction;
+    widgets[CONF_FREEDESKTOP_SS] = desktopSS;
+    widgets[CONF_FREEDESKTOP_PM] = desktopPM;
+    widgets[CONF_TRAY_NOTIFY] = showNotifications;
+    widgets[CONF_TRAY_SHOW] = showSystemTray;
+    widgets[CONF_LID_DISABLE_IF_EXTERNAL] = disableLidAction;
+    widgets[CONF_BACKLIGHT_BATTERY_ENABLE] = backlightBatteryCheck;
+    widgets[CONF_BACKLIGHT_AC_ENABLE] = backlightACCheck;
+    widgets[CONF_BACKLIGHT_BATTERY] = backlightSliderBattery;
+    widgets[CONF_BACKLIGHT_AC] = backlightSliderAC;
+    widgets[CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER] = backlightBatteryLowerCheck;
+    widgets[CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER] = backlightACHigherCheck;
+    widgets[CONF_BACKLIGHT_MOUSE_WHEEL] = backlightMouseWheel;
+    widgets[CONF_WARN_ON_LOW_BATTERY] = warnOnLowBattery;
+    widgets[CONF_WARN_ON_VERYLOW_BATTERY] = warnOnVeryLowBattery;
+    widgets[CONF_NOTIFY_ON_BATTERY] = notifyOnBattery;
+    widgets[CONF_NOTIFY_ON_AC] = notifyOnAC;
+    widgets[CONF_SUSPEND_LOCK_SCREEN] = suspendLockScreen;
+    widgets[CONF_RESUME_LOCK_SCREEN] = resumeLockScreen;
+    widgets[CONF_KERNEL_BYPASS] = bypassKernel;
+
+    QMapIterator<QString, QWidget*> i(widgets);
+    while (i.hasNext()) {
+        i.next();
+        if (!Common::lockedPowerSettings(i.key())) { continue; }
+        i.value()->setEnabled(false);
+        i.value()->setToolTip(tr("Locked by the system administrator."));
+    }
 }
 
 void Dialog::enableLid(bool enabled)
 {
+    if (!settingsWidget) { return; }
     lidActionAC->setEnabled(enabled);
     lidActionBattery->setEnabled(enabled);
     lidActionACLabel->setEnabled(enabled);
@@ -1537,20 +1535,176 @@ void Dialog::enableLid(bool enabled)
 
 void Dialog::handleBacklightMouseWheel(bool triggered)
 {
-    Common::savePowerSettings(CONF_BACKLIGHT_MOUSE_WHEEL, triggered);
+    writer->setValue(CONF_BACKLIGHT_MOUSE_WHEEL, triggered);
 }
 
 void Dialog::handleSuspendLockScreen(bool triggered)
 {
-    Common::savePowerSettings(CONF_SUSPEND_LOCK_SCREEN, triggered);
+    writer->setValue(CONF_SUSPEND_LOCK_SCREEN, triggered);
 }
 
 void Dialog::handleResumeLockScreen(bool triggered)
 {
-    Common::savePowerSettings(CONF_RESUME_LOCK_SCREEN, triggered);
+    writer->setValue(CONF_RESUME_LOCK_SCREEN, triggered);
 }
 
 void Dialog::handleKernelBypass(bool triggered)
 {
-    Common::savePowerSettings(CONF_KERNEL_BYPASS, triggered);
+    writer->setValue(CONF_KERNEL_BYPASS, triggered);
+}
+
+// tell the running session what changed
+void Dialog::handleSettingsFlushed(const QStringList &keys)
+{
+    if (!dbus->isValid()) { return; }
+    dbus->asyncCall("UpdateConfigKeys", keys);
+}
+
+// get full state from session (or local powerkit)
+void Dialog::updateState()
+{
+    if (man) {
+        state = man->State();
+        applyState();
+        return;
+    }
+    QDBusPendingCall call = dbus->asyncCall("State");
+    QDBusPendingCallWatcher *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, SIGNAL(finished(QDBusPendingCallWatcher*)),
+            this, SLOT(handleStateReply(QDBusPendingCallWatcher*)));
+}
+
+void Dialog::handleStateReply(QDBusPendingCallWatcher *call)
+{
+    QDBusPendingReply<QVariantMap> reply = *call;
+    if (reply.isError()) {
+        qWarning() << "failed to get state from session" << reply.error().message();
+    } else { state = reply.value(); }
+    call->deleteLater();
+    applyState();
+}
+
+// enable widgets that depend on the session state
+void Dialog::applyState()
+{
+    hasState = true;
+
+    bool canSuspend = state.value(PK_CAN_SUSPEND).toBool();
+    bool canHibernate = state.value(PK_CAN_HIBERNATE).toBool() &&
+                        Common::kernelCanResume(kernelBypass());
+    bool canShutdown = state.value(PK_CAN_POWEROFF).toBool();
+    qDebug() << "can suspend?" << canSuspend << "can hibernate?" << canHibernate << "can shutdown?" << canShutdown;
+    QString notSupported = tr("%1 is not supported. Check permissions and/or settings.");
+    sleepButton->setEnabled(canSuspend);
+    hibernateButton->setEnabled(canHibernate);
+    poweroffButton->setEnabled(canShutdown);
+    if (!canSuspend) {
+        sleepButton->setToolTip(notSupported.arg(tr("Suspend")));
+    }
+    if (!canHibernate) {
+        hibernateButton->setToolTip(notSupported.arg(tr("Hibernate")));
+    }
+    if (!canShutdown) {
+        poweroffButton->setToolTip(notSupported.arg(tr("Shutdown")));
+    }
+
+    if (settingsWidget) {
+        checkPerms();
+        enableLid(state.value(UPOWER_LID_IS_PRESENT).toBool());
+        lockSettings();
+    }
+
+    checkDevices();
+    getInhibitors();
+}
+
+// probe backlight device (after the dialog is shown)
+void Dialog::loadBacklight()
+{
+    if (backlightProbed) { return; }
+    backlightProbed = true;
+
+    backlightDevice = Common::backlightDevice();
+    hasBacklight = Common::canAdjustBacklight(backlightDevice);
+    if (hasBacklight) {
+        backlightSlider->setMinimum(1);
+        backlightSlider->setMaximum(Common::backlightMax(backlightDevice));
+        backlightSlider->setValue(Common::backlightValue(backlightDevice));
+        // the kernel notifies actual_brightness on changes
+        backlightWatcher = new SysfsAttribute(QString("%1/actual_brightness")
+                                              .arg(backlightDevice), this);
+        backlightWatcher->watch();
+        connect(backlightWatcher, SIGNAL(changed(QString)),
+                this, SLOT(updateBacklight(QString)));
+        backlightTransition = new BacklightTransition(this);
+        backlightTransition->setDevice(backlightDevice);
+    }
+    enableBacklight(hasBacklight);
+
+    // connect after setting the initial value
+    connect(backlightSlider, SIGNAL(valueChanged(int)),
+            this, SLOT(handleBacklightSlider(int)));
+}
+
+bool Dialog::kernelBypass()
+{
+    if (bypassKernel) { return bypassKernel->isChecked(); }
+    return Common::loadPowerSettings(CONF_KERNEL_BYPASS).toBool();
+}
+
+void Dialog::handleTabChanged(int index)
+{
+    if (containerWidget->widget(index) == settingsContainerArea) {
+        setupSettings();
+    }
+}
+
+// get battery/devices/inhibitors from session (or local powerkit)
+void Dialog::updateStatus()
+{
+    QVariantMap status;
+    if (man) { status = man->Status(); }
+    else {
+        QDBusReply<QVariantMap> reply = dbus->call("Status");
+        if (!reply.isValid()) { return; }
+        status = reply.value();
+    }
+    QMapIterator<QString, QVariant> i(status);
+    while (i.hasNext()) {
+        i.next();
+        state[i.key()] = i.value();
+    }
+}
+
+void Dialog::handleUpdatedDevices()
+{
+    updateStatus();
+    checkDevices();
+}
+
+// run power action in session (or local powerkit)
+void Dialog::powerAction(const QString &action)
+{
+    if (man) {
+        QMetaObject::invokeMethod(man, action.toLatin1().constData());
+        return;
+    }
+    dbus->asyncCall(action);
+}
+
+// nested containers from D-Bus arrive as QDBusArgument
+QVariantMap Dialog::variantToMap(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QDBusArgument>()) {
+        return qdbus_cast<QVariantMap>(value);
+    }
+    return value.toMap();
+}
+
+QVariantList Dialog::variantToList(const QVariant &value)
+{
+    if (value.userType() == qMetaTypeId<QDBusArgument>()) {
+        return qdbus_cast<QVariantList>(value);
+    }
+    return value.toList();
 }
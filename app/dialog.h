@@ -20,6 +20,11 @@
 #include <QTabWidget>
 #include <QDBusConnection>
 #include <QDBusInterface>
+#include <QDBusReply>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+#include <QDBusArgument>
+#include <QVariantMap>
 #include <QMessageBox>
 #include <QPushButton>
 #include <QApplication>
@@ -30,15 +35,22 @@
 #include <QGroupBox>
 #include <QTreeWidget>
 #include <QTreeWidgetItem>
+#include <QTreeView>
 #include <QProgressBar>
 #include <QMap>
 #include <QLCDNumber>
 #include <QDateTime>
 #include <QScrollArea>
+#include <QTimer>
 
 #include "def.h"
 #include "common.h"
 #include "powerkit.h"
+#include "settingswriter.h"
+#include "devicemodel.h"
+#include "backlighttransition.h"
+#include "sysfsattribute.h"
+#include "batteryicons.h"
 
 // fix X11 inc
 #undef CursorShape
@@ -52,8 +64,6 @@
 #undef FontChange
 #undef Expose
 
-#define DEVICE_UUID Qt::UserRole+1
-#define DEVICE_TYPE Qt::UserRole+2
 #define MAX_WIDTH 150
 
 class Dialog : public QDialog
@@ -86,12 +96,13 @@ private:
     QString backlightDevice;
     bool hasBacklight;
     QSlider *backlightSlider;
-    QFileSystemWatcher *backlightWatcher;
+    SysfsAttribute *backlightWatcher;
+    BacklightTransition *backlightTransition;
     PowerKit *man;
     QLabel *batteryIcon;
     QLabel *batteryLabel;
-    QTreeWidget *deviceTree;
-    QMap<QString,QProgressBar*> devicesProg;
+    QTreeView *deviceTree;
+    DeviceModel *deviceModel;
     QLCDNumber *batteryLeftLCD;
     QSlider *backlightSliderBattery;
     QSlider *backlightSliderAC;
@@ -113,8 +124,16 @@ private:
     QCheckBox *suspendLockScreen;
     QCheckBox *resumeLockScreen;
     QCheckBox *bypassKernel;
+    SettingsWriter *writer;
+    QVariantMap state;
+    QTabWidget *containerWidget;
+    QScrollArea *settingsContainerArea;
+    QWidget *settingsWidget;
+    bool hasState;
+    bool backlightProbed;
 
 private slots:
+    void setupSettings();
     void populate();
     void loadSettings();
     void saveSettings();
@@ -142,7 +161,6 @@ private slots:
     void handleBacklightSlider(int value);
     void updateBacklight(QString file);
     void checkDevices();
-    bool deviceExists(QString uid);
     void deviceRemove(QString uid);
     void handleDeviceAdded(QString uid);
     void handleBacklightBatteryCheck(bool triggered);
@@ -162,10 +180,23 @@ private slots:
     void handleNotifyBattery(bool triggered);
     void handleNotifyAC(bool triggered);
     void enableLid(bool enabled);
+    void lockSettings();
     void handleBacklightMouseWheel(bool triggered);
     void handleSuspendLockScreen(bool triggered);
     void handleResumeLockScreen(bool triggered);
     void handleKernelBypass(bool triggered);
+    void handleSettingsFlushed(const QStringList &keys);
+    void updateState();
+    void handleStateReply(QDBusPendingCallWatcher *call);
+    void applyState();
+    void loadBacklight();
+    bool kernelBypass();
+    void handleTabChanged(int index);
+    void updateStatus();
+    void handleUpdatedDevices();
+    void powerAction(const QString &action);
+    QVariantMap variantToMap(const QVariant &value);
+    QVariantList variantToList(const QVariant &value);
 };
 
 #endif // DIALOG_H
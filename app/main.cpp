@@ -7,13 +7,57 @@
 */
 
 #include <QApplication>
+#include <QTextStream>
+#include <QDateTime>
 #include "systray.h"
 #include "dialog.h"
 
 #include "powerkit.h"
+#include "batteryarchive.h"
+
+#include <stdio.h>
+
+// powerkit --export-history [csv|json] [samples|hourly|daily]
+//                           [--from yyyy-MM-dd] [--to yyyy-MM-dd]
+static int exportHistory(int argc, char *argv[])
+{
+    QCoreApplication a(argc, argv);
+    BatteryArchive::ExportFormat format = BatteryArchive::ExportCSV;
+    BatteryArchive::Resolution resolution = BatteryArchive::ResolutionSamples;
+    quint32 from = 0;
+    quint32 to = 0xffffffff;
+    QStringList args = a.arguments();
+    for (int i=2;i<args.size();++i) {
+        QString arg = args.at(i);
+        if (arg == "json") { format = BatteryArchive::ExportJSON; }
+        else if (arg == "csv") { format = BatteryArchive::ExportCSV; }
+        else if (arg == "samples") { resolution = BatteryArchive::ResolutionSamples; }
+        else if (arg == "hourly") { resolution = BatteryArchive::ResolutionHourly; }
+        else if (arg == "daily") { resolution = BatteryArchive::ResolutionDaily; }
+        else if ((arg == "--from" || arg == "--to") && i+1<args.size()) {
+            QDateTime date = QDateTime::fromString(args.at(++i), Qt::ISODate);
+            if (!date.isValid()) {
+                qWarning() << "invalid date" << args.at(i);
+                return 1;
+            }
+            if (arg == "--from") { from = date.toTime_t(); }
+            else { to = date.toTime_t(); }
+        } else {
+            qWarning() << "unknown argument" << arg;
+            return 1;
+        }
+    }
+    QTextStream out(stdout);
+    return BatteryArchive::exportHistory(out, format, resolution, from, to)?0:1;
+}
 
 int main(int argc, char *argv[])
 {
+    // console export, no display needed
+    if (argc>1 && qstrcmp(argv[1], "--export-history") == 0) {
+        return exportHistory(argc, argv);
+    }
+
     QApplication a(argc, argv);
     QCoreApplication::setApplicationName("freedesktop");
     QCoreApplication::setOrganizationDomain("org");
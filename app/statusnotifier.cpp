@@ -0,0 +1,297 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "statusnotifier.h"
+
+#include <QDBusConnectionInterface>
+#include <QDBusInterface>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QCoreApplication>
+#include <QImage>
+#include <QtEndian>
+#include <QDebug>
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SNIPixmap &pixmap)
+{
+    argument.beginStructure();
+    argument << pixmap.width << pixmap.height << pixmap.data;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SNIPixmap &pixmap)
+{
+    argument.beginStructure();
+    argument >> pixmap.width >> pixmap.height >> pixmap.data;
+    argument.endStructure();
+    return argument;
+}
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SNIToolTip &tooltip)
+{
+    argument.beginStructure();
+    argument << tooltip.iconName << tooltip.iconPixmap << tooltip.title << tooltip.description;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, SNIToolTip &tooltip)
+{
+    argument.beginStructure();
+    argument >> tooltip.iconName >> tooltip.iconPixmap >> tooltip.title >> tooltip.description;
+    argument.endStructure();
+    return argument;
+}
+
+StatusNotifierItem::StatusNotifierItem(QObject *parent)
+    : QObject(parent)
+    , registered(false)
+    , currentStatus(SNI_STATUS_ACTIVE)
+    , pixmapValid(false)
+{
+    qDBusRegisterMetaType<SNIPixmap>();
+    qDBusRegisterMetaType<SNIPixmapList>();
+    qDBusRegisterMetaType<SNIToolTip>();
+
+    static int instance = 0;
+    service = QString(SNI_SERVICE).arg(QCoreApplication::applicationPid()).arg(++instance);
+
+    // the watcher may be up before any host (panel) is
+    QDBusConnection::sessionBus().connect(SNI_WATCHER_SERVICE,
+                                          SNI_WATCHER_PATH,
+                                          SNI_WATCHER_INTERFACE,
+                                          "StatusNotifierHostRegistered",
+                                          this,
+                                          SIGNAL(hostRegistered()));
+}
+
+StatusNotifierItem::~StatusNotifierItem()
+{
+    unregisterItem();
+}
+
+bool StatusNotifierItem::isRegistered()
+{
+    return registered;
+}
+
+// register item on the session bus and with the watcher
+bool StatusNotifierItem::registerItem()
+{
+    QDBusConnection session = QDBusConnection::sessionBus();
+    if (!session.isConnected()) { return false; }
+    if (!session.interface()->isServiceRegistered(SNI_WATCHER_SERVICE)) {
+        qDebug() << "no status notifier watcher";
+        return false;
+    }
+    if (!registered) {
+        if (!session.registerService(service)) {
+            qWarning() << "failed to register" << service;
+            return false;
+        }
+        if (!session.registerObject(SNI_PATH,
+                                    this,
+                                    QDBusConnection::ExportScriptableSlots|
+                                    QDBusConnection::ExportScriptableSignals|
+                                    QDBusConnection::ExportAllProperties)) {
+            qWarning() << "failed to register" << SNI_PATH;
+            session.unregisterService(service);
+            return false;
+        }
+        registered = true;
+    }
+
+    QDBusInterface watcher(SNI_WATCHER_SERVICE,
+                           SNI_WATCHER_PATH,
+                           SNI_WATCHER_INTERFACE,
+                           session);
+    if (!watcher.isValid()) {
+        unregisterItem();
+        return false;
+    }
+    if (!watcher.property("IsStatusNotifierHostRegistered").toBool()) {
+        qDebug() << "no status notifier host";
+        unregisterItem();
+        return false;
+    }
+    QDBusMessage reply = watcher.call("RegisterStatusNotifierItem", service);
+    if (reply.type() == QDBusMessage::ErrorMessage) {
+        qWarning() << "failed to register status notifier item" << reply.errorMessage();
+        unregisterItem();
+        return false;
+    }
+    qDebug() << "registered status notifier item" << service;
+    return true;
+}
+
+// nothing left on the bus for a host to find
+void StatusNotifierItem::unregisterItem()
+{
+    if (!registered) { return; }
+    QDBusConnection session = QDBusConnection::sessionBus();
+    session.unregisterObject(SNI_PATH);
+    session.unregisterService(service);
+    registered = false;
+}
+
+QString StatusNotifierItem::category() const
+{
+    return QString("Hardware");
+}
+
+QString StatusNotifierItem::id() const
+{
+    return QString("powerkit");
+}
+
+QString StatusNotifierItem::title() const
+{
+    return QString("PowerKit");
+}
+
+QString StatusNotifierItem::status() const
+{
+    return currentStatus;
+}
+
+int StatusNotifierItem::windowId() const
+{
+    return 0;
+}
+
+QString StatusNotifierItem::iconName() const
+{
+    return currentIconName;
+}
+
+// only converted when the host asks for it
+SNIPixmapList StatusNotifierItem::iconPixmap()
+{
+    if (!pixmapValid) {
+        currentPixmap = iconToPixmap(currentIcon);
+        pixmapValid = true;
+    }
+    return currentPixmap;
+}
+
+QString StatusNotifierItem::overlayIconName() const
+{
+    return QString();
+}
+
+SNIPixmapList StatusNotifierItem::overlayIconPixmap() const
+{
+    return SNIPixmapList();
+}
+
+QString StatusNotifierItem::attentionIconName() const
+{
+    return currentIconName;
+}
+
+SNIPixmapList StatusNotifierItem::attentionIconPixmap() const
+{
+    return SNIPixmapList();
+}
+
+SNIToolTip StatusNotifierItem::toolTip() const
+{
+    SNIToolTip tooltip;
+    tooltip.iconName = currentIconName;
+    tooltip.title = title();
+    tooltip.description = currentToolTip;
+    return tooltip;
+}
+
+bool StatusNotifierItem::itemIsMenu() const
+{
+    return false;
+}
+
+void StatusNotifierItem::setStatus(const QString &status)
+{
+    if (status == currentStatus) { return; }
+    currentStatus = status;
+    emit NewStatus(status);
+}
+
+// hosts prefer IconName (a theme icon, a cheap update), the rendered
+// IconPixmap is a fallback, only announced by itself if there is no name
+void StatusNotifierItem::setIcon(const QString &name, const QIcon &icon)
+{
+    bool changed = name != currentIconName ||
+                   (name.isEmpty() && icon.cacheKey() != currentIcon.cacheKey());
+    currentIconName = name;
+    if (icon.cacheKey() != currentIcon.cacheKey()) {
+        currentIcon = icon;
+        pixmapValid = false;
+    }
+    if (changed) { emit NewIcon(); }
+}
+
+void StatusNotifierItem::setToolTip(const QString &tooltip)
+{
+    if (tooltip == currentToolTip) { return; }
+    currentToolTip = tooltip;
+    emit NewToolTip();
+}
+
+void StatusNotifierItem::Activate(int x, int y)
+{
+    Q_UNUSED(x)
+    Q_UNUSED(y)
+    emit activated();
+}
+
+void StatusNotifierItem::SecondaryActivate(int x, int y)
+{
+    Q_UNUSED(x)
+    Q_UNUSED(y)
+    emit activated();
+}
+
+void StatusNotifierItem::ContextMenu(int x, int y)
+{
+    Q_UNUSED(x)
+    Q_UNUSED(y)
+    emit activated();
+}
+
+void StatusNotifierItem::Scroll(int delta, const QString &orientation)
+{
+    if (orientation.toLower() != "vertical") { return; }
+    emit scrolled(delta);
+}
+
+SNIPixmapList StatusNotifierItem::iconToPixmap(const QIcon &icon)
+{
+    SNIPixmapList result;
+    if (icon.isNull()) { return result; }
+    QList<QSize> sizes = icon.availableSizes();
+    if (sizes.isEmpty()) { sizes << QSize(22, 22) << QSize(32, 32) << QSize(48, 48); }
+    for (int i=0;i<sizes.size();++i) {
+        QImage image = icon.pixmap(sizes.at(i)).toImage()
+                       .convertToFormat(QImage::Format_ARGB32);
+        if (image.isNull()) { continue; }
+        SNIPixmap pixmap;
+        pixmap.width = image.width();
+        pixmap.height = image.height();
+        pixmap.data.resize(image.width()*image.height()*4);
+        uchar *data = (uchar*)pixmap.data.data();
+        for (int y=0;y<image.height();++y) {
+            const QRgb *line = (const QRgb*)image.constScanLine(y);
+            for (int x=0;x<image.width();++x) {
+                qToBigEndian<quint32>(line[x], data);
+                data += 4;
+            }
+        }
+        result << pixmap;
+    }
+    return result;
+}
@@ -0,0 +1,130 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef STATUSNOTIFIER_H
+#define STATUSNOTIFIER_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QByteArray>
+#include <QIcon>
+#include <QMetaType>
+#include <QDBusArgument>
+#include <QDBusConnection>
+
+#define SNI_SERVICE "org.kde.StatusNotifierItem-%1-%2"
+#define SNI_PATH "/StatusNotifierItem"
+#define SNI_INTERFACE "org.kde.StatusNotifierItem"
+#define SNI_WATCHER_SERVICE "org.kde.StatusNotifierWatcher"
+#define SNI_WATCHER_PATH "/StatusNotifierWatcher"
+#define SNI_WATCHER_INTERFACE "org.kde.StatusNotifierWatcher"
+#define SNI_STATUS_ACTIVE "Active"
+#define SNI_STATUS_PASSIVE "Passive"
+#define SNI_STATUS_ATTENTION "NeedsAttention"
+
+// (iiay) ARGB32 in network byte order
+struct SNIPixmap
+{
+    int width;
+    int height;
+    QByteArray data;
+};
+typedef QList<SNIPixmap> SNIPixmapList;
+
+// (sa(iiay)ss)
+struct SNIToolTip
+{
+    QString iconName;
+    SNIPixmapList iconPixmap;
+    QString title;
+    QString description;
+};
+
+Q_DECLARE_METATYPE(SNIPixmap)
+Q_DECLARE_METATYPE(SNIPixmapList)
+Q_DECLARE_METATYPE(SNIToolTip)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const SNIPixmap &pixmap);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SNIPixmap &pixmap);
+QDBusArgument &operator<<(QDBusArgument &argument, const SNIToolTip &tooltip);
+const QDBusArgument &operator>>(const QDBusArgument &argument, SNIToolTip &tooltip);
+
+// org.kde.StatusNotifierItem, the host pulls properties on New* signals
+class StatusNotifierItem : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", SNI_INTERFACE)
+    Q_PROPERTY(QString Category READ category)
+    Q_PROPERTY(QString Id READ id)
+    Q_PROPERTY(QString Title READ title)
+    Q_PROPERTY(QString Status READ status)
+    Q_PROPERTY(int WindowId READ windowId)
+    Q_PROPERTY(QString IconName READ iconName)
+    Q_PROPERTY(SNIPixmapList IconPixmap READ iconPixmap)
+    Q_PROPERTY(QString OverlayIconName READ overlayIconName)
+    Q_PROPERTY(SNIPixmapList OverlayIconPixmap READ overlayIconPixmap)
+    Q_PROPERTY(QString AttentionIconName READ attentionIconName)
+    Q_PROPERTY(SNIPixmapList AttentionIconPixmap READ attentionIconPixmap)
+    Q_PROPERTY(SNIToolTip ToolTip READ toolTip)
+    Q_PROPERTY(bool ItemIsMenu READ itemIsMenu)
+
+public:
+    explicit StatusNotifierItem(QObject *parent = NULL);
+    ~StatusNotifierItem();
+    bool isRegistered();
+
+    QString category() const;
+    QString id() const;
+    QString title() const;
+    QString status() const;
+    int windowId() const;
+    QString iconName() const;
+    SNIPixmapList iconPixmap();
+    QString overlayIconName() const;
+    SNIPixmapList overlayIconPixmap() const;
+    QString attentionIconName() const;
+    SNIPixmapList attentionIconPixmap() const;
+    SNIToolTip toolTip() const;
+    bool itemIsMenu() const;
+
+private:
+    QString service;
+    bool registered;
+    QString currentStatus;
+    QString currentIconName;
+    QIcon currentIcon;
+    SNIPixmapList currentPixmap;
+    bool pixmapValid;
+    QString currentToolTip;
+    void unregisterItem();
+    static SNIPixmapList iconToPixmap(const QIcon &icon);
+
+signals:
+    Q_SCRIPTABLE void NewTitle();
+    Q_SCRIPTABLE void NewIcon();
+    Q_SCRIPTABLE void NewAttentionIcon();
+    Q_SCRIPTABLE void NewOverlayIcon();
+    Q_SCRIPTABLE void NewToolTip();
+    Q_SCRIPTABLE void NewStatus(const QString &status);
+    void activated();
+    void scrolled(int delta);
+    void hostRegistered();
+
+public slots:
+    bool registerItem();
+    void setStatus(const QString &status);
+    void setIcon(const QString &name, const QIcon &icon);
+    void setToolTip(const QString &tooltip);
+    Q_SCRIPTABLE void Activate(int x, int y);
+    Q_SCRIPTABLE void SecondaryActivate(int x, int y);
+    Q_SCRIPTABLE void ContextMenu(int x, int y);
+    Q_SCRIPTABLE void Scroll(int delta, const QString &orientation);
+};
+
+#endif // STATUSNOTIFIER_H
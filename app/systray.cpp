@@ -44,6 +44,8 @@ SysTray::SysTray(QObject *parent)
     , lidXrandr(false)
     , lidWasClosed(false)
     , hasBacklight(false)
+    , backlight(0)
+    , transition(0)
     , backlightOnBattery(false)
     , backlightOnAC(false)
     , backlightBatteryValue(0)
@@ -57,6 +59,17 @@ SysTray::SysTray(QObject *parent)
     , notifyOnAC(true)
     , backlightMouseWheel(true)
     , ignoreKernelResume(false)
+    , confSize(0)
+    , refreshTimer(0)
+    , refreshDirty(RefreshNone)
+    , trayIconState(-2)
+    , trayIconGeneration(-1)
+    , screens(0)
+    , hotplug(0)
+    , layout(0)
+    , refreshRate(0)
+    , refreshLowOnBattery(false)
+    , critical(0)
 {
     // setup tray
     tray = new TrayIcon(this);
@@ -69,6 +82,15 @@ SysTray::SysTray(QObject *parent)
             this,
             SLOT(handleTrayWheel(TrayIcon::WheelAction)));
 
+    // setup tray refresh
+    refreshTimer = new QTimer(this);
+    refreshTimer->setSingleShot(true);
+    refreshTimer->setInterval(TRAY_REFRESH_DELAY);
+    connect(refreshTimer,
+            SIGNAL(timeout()),
+            this,
+            SLOT(refresh()));
+
     // setup manager
     man = new PowerKit(this);
     connect(man,
@@ -111,6 +133,10 @@ SysTray::SysTray(QObject *parent)
             SIGNAL(Update()),
             this,
             SLOT(loadSettings()));
+    connect(man,
+            SIGNAL(UpdatedConfig(QStringList)),
+            this,
+            SLOT(handleUpdatedConfig(QStringList)));
 
     // setup org.freedesktop.PowerManagement
     pm = new PowerManagement(this);
@@ -175,10 +201,34 @@ SysTray::SysTray(QObject *parent)
 
     // setup theme
     Theme::setIconTheme();
+    BatteryIcons::render();
     if (tray->icon().isNull()) {
-        tray->setIcon(QIcon::fromTheme(DEFAULT_BATTERY_ICON));
+        tray->setIcon(QIcon::fromTheme(DEFAULT_BATTERY_ICON), DEFAULT_BATTERY_ICON);
     }
 
+    // backlight registry is updated from uevents
+    backlight = new Backlight(this);
+    transition = new BacklightTransition(this);
+    connect(backlight,
+            SIGNAL(devicesChanged()),
+            this,
+            SLOT(checkBacklight()));
+    connect(backlight,
+            SIGNAL(brightnessChanged(QString)),
+            transition,
+            SLOT(sync()));
+
+    // critical battery deadline, action runs once until we resume
+    critical = new CriticalBattery(this);
+    connect(critical,
+            SIGNAL(triggered(double)),
+            this,
+            SLOT(handleCriticalAction(double)));
+    connect(man,
+            SIGNAL(PrepareForResume()),
+            critical,
+            SLOT(resume()));
+
     // load settings and register service
     loadSettings();
     registerService();
@@ -188,6 +238,22 @@ SysTray::SysTray(QObject *parent)
         xscreensaver->start(XSCREENSAVER_RUN);
     }
 
+    // setup screens (output cache is kept current from RandR events)
+    screens = new Screens(this);
+    hotplug = new HotPlug(screens, this);
+    layout = new RandRLayout(screens, this);
+    refreshRate = new RefreshRate(screens, this);
+    refreshRate->setLowest(refreshLowOnBattery && man->OnBattery());
+    connect(hotplug,
+            SIGNAL(found(QMap<QString,bool>)),
+            this,
+            SLOT(setInternalMonitor()));
+    connect(hotplug,
+            SIGNAL(status(QString,bool)),
+            this,
+            SLOT(handleMonitorStatus(QString,bool)));
+    hotplug->requestScan();
+
     // device check
     QTimer::singleShot(10000,
                        this,
@@ -207,6 +273,7 @@ SysTray::SysTray(QObject *parent)
     watcher = new QFileSystemWatcher(this);
     watcher->addPath(Common::confDir());
     watcher->addPath(Common::confFile());
+    if (QFile::exists(CONF_SYSTEM_DIR)) { watcher->addPath(CONF_SYSTEM_DIR); }
     connect(watcher,
             SIGNAL(fileChanged(QString)),
             this,
@@ -238,68 +305,88 @@ void SysTray::checkDevices()
     if (!showTray &&
         tray->isVisible()) { tray->hide(); }
 
-    // get battery left and add tooltip
+    scheduleRefresh(RefreshAll);
+
+    // Register service if not already registered
+    if (!hasService) { registerService(); }
+}
+
+// mark parts of the tray as dirty, refresh at most once per interval
+void SysTray::scheduleRefresh(int parts)
+{
+    refreshDirty |= parts;
+    if (!refreshTimer->isActive()) { refreshTimer->start(); }
+}
+
+// update dirty parts of the tray
+void SysTray::refresh()
+{
+    int parts = refreshDirty;
+    refreshDirty = RefreshNone;
+    if (parts == RefreshNone) { return; }
+
     double batteryLeft = man->BatteryLeft();
+    bool onBattery = man->OnBattery();
+    bool hasBattery = man->HasBattery();
     qDebug() << "battery at" << batteryLeft;
-    if (batteryLeft > 0 && man->HasBattery()) {
-        tray->setToolTip(QString("%1 %2%").arg(tr("Battery at")).arg(batteryLeft));
-        if (man->TimeToEmpty()>0 && man->OnBattery()) {
-            tray->setToolTip(tray->toolTip()
-                             .append(QString(", %1 %2")
-                             .arg(QDateTime::fromTime_t((uint)man->TimeToEmpty())
-                                                        .toUTC().toString("hh:mm")))
-                             .arg(tr("left")));
+
+    if (parts & RefreshTooltip) {
+        QString tooltip = batteryTooltip(batteryLeft, onBattery, hasBattery);
+        if (tooltip != trayTooltip) {
+            trayTooltip = tooltip;
+            tray->setToolTip(tooltip);
         }
-        if (batteryLeft > 99) { tray->setToolTip(tr("Charged")); }
-        if (!man->OnBattery() &&
-            man->BatteryLeft() <= 99) {
-            if (man->TimeToFull()>0) {
-                tray->setToolTip(tray->toolTip()
-                                 .append(QString(", %1 %2")
-                                 .arg(QDateTime::fromTime_t((uint)man->TimeToFull())
-                                                            .toUTC().toString("hh:mm")))
-                                 .arg(tr("left")));
+    }
+    if (parts & RefreshIcon) { drawBattery(batteryLeft, onBattery, hasBattery); }
+    if (parts & RefreshThresholds) {
+        handleLow(batteryLeft, onBattery);
+        handleVeryLow(batteryLeft, onBattery);
+        handleCritical(batteryLeft, onBattery);
+    }
+}
+
+// battery and inhibitors tooltip
+QString SysTray::batteryTooltip(double left, bool onBattery, bool hasBattery)
+{
+    QString tooltip;
+    if (left > 0 && hasBattery) {
+        if (left > 99) { tooltip = tr("Charged"); }
+        else {
+            tooltip = QString("%1 %2%").arg(tr("Battery at")).arg(left);
+            qlonglong time = 0;
+            if (man->EstimateConfidence()>=ESTIMATOR_MIN_CONFIDENCE) {
+                time = onBattery?man->EstimatedTimeToEmpty():man->EstimatedTimeToFull();
+            }
+            if (time<1) { time = onBattery?man->TimeToEmpty():man->TimeToFull(); }
+            if (time>0) {
+                tooltip.append(QString(", %1 %2")
+                               .arg(QDateTime::fromTime_t((uint)time)
+                                    .toUTC().toString("hh:mm"))
+                               .arg(tr("left")));
+            }
+            if (!onBattery) {
+                tooltip.append(QString(" (%1)").arg(tr("Charging")));
             }
-            tray->setToolTip(tray->toolTip().append(QString(" (%1)").arg(tr("Charging"))));
         }
-    } else { tray->setToolTip(tr("On AC")); }
+    } else { tooltip = tr("On AC"); }
 
-    // inhibitors tooltip
     if (ssInhibitors.size()>0) {
-        QString tooltip = "\n\n";
-        tooltip.append(QString("%1:\n").arg(tr("Screen Saver Inhibitors")));
+        tooltip.append(QString("\n\n%1:\n").arg(tr("Screen Saver Inhibitors")));
         QMapIterator<quint32, QString> i(ssInhibitors);
         while (i.hasNext()) {
             i.next();
             tooltip.append(QString(" * %1\n").arg(i.value()));
         }
-        tray->setToolTip(tray->toolTip().append(tooltip));
     }
     if (pmInhibitors.size()>0) {
-        QString tooltip = "\n\n";
-        tooltip.append(QString("%1:\n").arg(tr("Power Manager Inhibitors")));
+        tooltip.append(QString("\n\n%1:\n").arg(tr("Power Manager Inhibitors")));
         QMapIterator<quint32, QString> i(pmInhibitors);
         while (i.hasNext()) {
             i.next();
             tooltip.append(QString(" * %1\n").arg(i.value()));
         }
-        tray->setToolTip(tray->toolTip().append(tooltip));
     }
-
-    // draw battery systray
-    drawBattery(batteryLeft);
-
-    // low battery?
-    handleLow(batteryLeft);
-
-    // very low battery?
-    handleVeryLow(batteryLeft);
-
-    // critical battery?
-    handleCritical(batteryLeft);
-
-    // Register service if not already registered
-    if (!hasService) { registerService(); }
+    return tooltip;
 }
 
 // what to do when user close lid
@@ -361,17 +448,20 @@ void SysTray::handleOnBattery()
                     tr("Switched to battery power."));
     }
 
+    // refresh rate
+    if (refreshLowOnBattery) { refreshRate->setLowest(true); }
+
     // brightness
     if (hasBacklight &&
         backlightOnBattery &&
         backlightBatteryValue>0) {
         qDebug() << "set brightness on battery";
         if (backlightBatteryDisableIfLower &&
-            backlightBatteryValue>Common::backlightValue(backlightDevice)) {
+            backlightBatteryValue>transition->value()) {
             qDebug() << "brightness is lower than battery value, ignore";
             return;
         }
-        Common::adjustBacklight(backlightDevice, backlightBatteryValue);
+        transition->setValue(backlightBatteryValue);
     }
 }
 
@@ -386,17 +476,20 @@ void SysTray::handleOnAC()
     wasLowBattery = false;
     wasVeryLowBattery = false;
 
+    // refresh rate (only restored if we changed it)
+    refreshRate->setLowest(false);
+
     // brightness
     if (hasBacklight &&
         backlightOnAC &&
         backlightACValue>0) {
         qDebug() << "set brightness on ac";
         if (backlightACDisableIfHigher &&
-            backlightACValue<Common::backlightValue(backlightDevice)) {
+            backlightACValue<transition->value()) {
             qDebug() << "brightness is higher than ac value, ignore";
             return;
         }
-        Common::adjustBacklight(backlightDevice, backlightACValue);
+        transition->setValue(backlightACValue);
     }
 }
 
@@ -421,6 +514,7 @@ void SysTray::loadSettings()
     if (Common::validPowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT)) {
         critBatteryValue = Common::loadPowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT).toInt();
     }
+    critical->setThreshold(critBatteryValue);
     if (Common::validPowerSettings(CONF_LID_BATTERY_ACTION)) {
         lidActionBattery = Common::loadPowerSettings(CONF_LID_BATTERY_ACTION).toInt();
     }
@@ -492,6 +586,19 @@ void SysTray::loadSettings()
     if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC)) {
         man->setSuspendWakeAlarmOnAC(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC).toInt());
     }
+    if (Common::validPowerSettings(CONF_SUSPEND_HIBERNATE_FLOOR)) {
+        man->setSuspendHibernateFloor(Common::loadPowerSettings(CONF_SUSPEND_HIBERNATE_FLOOR).toInt());
+    }
+    if (Common::validPowerSettings(CONF_BATTERY_REPLACE_THRESHOLD)) {
+        man->setBatteryReplaceThreshold(Common::loadPowerSettings(CONF_BATTERY_REPLACE_THRESHOLD).toInt());
+    }
+
+    if (Common::validPowerSettings(CONF_REFRESH_LOW_BATTERY)) {
+        refreshLowOnBattery = Common::loadPowerSettings(CONF_REFRESH_LOW_BATTERY).toBool();
+    }
+    if (refreshRate) {
+        refreshRate->setLowest(refreshLowOnBattery && man->OnBattery());
+    }
 
     if (Common::validPowerSettings(CONF_KERNEL_BYPASS)) {
         ignoreKernelResume = Common::loadPowerSettings(CONF_KERNEL_BYPASS).toBool();
@@ -514,11 +621,15 @@ void SysTray::loadSettings()
     }
 
     // backlight
-    backlightDevice = Common::backlightDevice();
-    hasBacklight = Common::canAdjustBacklight(backlightDevice);
+    checkBacklight();
     if (Common::validPowerSettings(CONF_BACKLIGHT_MOUSE_WHEEL)) {
         backlightMouseWheel = Common::loadPowerSettings(CONF_BACKLIGHT_MOUSE_WHEEL).toBool();
     }
+
+    // remember what we loaded, see handleConfChanged()
+    QFileInfo conf(Common::confFile());
+    confModified = conf.lastModified();
+    confSize = conf.size();
 }
 
 // register session services
@@ -591,11 +702,11 @@ void SysTray::handleHasInhibitChanged(bool has_inhibit)
     if (has_inhibit) { resetTimer(); }
 }
 
-void SysTray::handleLow(double left)
+void SysTray::handleLow(double left, bool onBattery)
 {
     if (!warnOnLowBattery) { return; }
     double batteryLow = (double)(lowBatteryValue+critBatteryValue);
-    if (left<=batteryLow && man->OnBattery()) {
+    if (left<=batteryLow && onBattery) {
         if (!wasLowBattery) {
             showMessage(QString("%1 (%2%)").arg(tr("Low Battery!")).arg(left),
                         tr("The battery is low,"
@@ -607,11 +718,11 @@ void SysTray::handleLow(double left)
     }
 }
 
-void SysTray::handleVeryLow(double left)
+void SysTray::handleVeryLow(double left, bool onBattery)
 {
     if (!warnOnVeryLowBattery) { return; }
     double batteryVeryLow = (double)(critBatteryValue+1);
-    if (left<=batteryVeryLow && man->OnBattery()) {
+    if (left<=batteryVeryLow && onBattery) {
         if (!wasVeryLowBattery) {
             showMessage(QString("%1 (%2%)").arg(tr("Very Low Battery!")).arg(left),
                         tr("The battery is almost empty,"
@@ -623,12 +734,15 @@ void SysTray::handleVeryLow(double left)
     }
 }
 
-// handle critical battery
-void SysTray::handleCritical(double left)
+// feed critical battery controller
+void SysTray::handleCritical(double left, bool onBattery)
+{
+    critical->update(left, onBattery);
+}
+
+// handle critical battery (deadline reached)
+void SysTray::handleCriticalAction(double left)
 {
-    if (left<=0 ||
-        left>(double)critBatteryValue ||
-        !man->OnBattery()) { return; }
     qDebug() << "critical battery!" << criticalAction << left;
     switch(criticalAction) {
     case criticalHibernate:
@@ -641,8 +755,8 @@ void SysTray::handleCritical(double left)
     }
 }
 
-// draw battery tray icon
-void SysTray::drawBattery(double left)
+// draw battery tray icon (only if changed)
+void SysTray::drawBattery(double left, bool onBattery, bool hasBattery)
 {
     if (!showTray &&
         tray->isVisible()) {
@@ -653,27 +767,20 @@ void SysTray::drawBattery(double left)
         !tray->isVisible() &&
         showTray) { tray->show(); }
 
-    QIcon icon = QIcon::fromTheme(DEFAULT_AC_ICON);
-    if (left <= 0 || !man->HasBattery()) {
-        tray->setIcon(icon);
-        return;
+    int state = -1; // ac
+    if (left > 0 && hasBattery && !(left >= 100 && !onBattery)) {
+        state = BatteryIcons::index(left, !onBattery);
     }
-
-    if (left <= 10) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_CRIT:DEFAULT_BATTERY_ICON_CRIT_AC);
-    } else if (left <= 25) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_LOW:DEFAULT_BATTERY_ICON_LOW_AC);
-    } else if (left <= 75) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_GOOD:DEFAULT_BATTERY_ICON_GOOD_AC);
-    } else if (left <= 90) {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_FULL:DEFAULT_BATTERY_ICON_FULL_AC);
-    } else {
-        icon = QIcon::fromTheme(man->OnBattery()?DEFAULT_BATTERY_ICON_FULL:DEFAULT_BATTERY_ICON_CHARGED);
-        if (left >= 100 && !man->OnBattery()) {
-            icon = QIcon::fromTheme(DEFAULT_AC_ICON);
-        }
+    if (state == trayIconState &&
+        trayIconGeneration == BatteryIcons::generation() &&
+        !tray->icon().isNull()) { return; }
+    trayIconState = state;
+    if (state<0) { tray->setIcon(BatteryIcons::acIcon(), DEFAULT_AC_ICON); }
+    else {
+        tray->setIcon(BatteryIcons::icon(state),
+                      BatteryIcons::iconName(left, !onBattery));
     }
-    tray->setIcon(icon);
+    trayIconGeneration = BatteryIcons::generation(); // after a re-render
 }
 
 // timeout, check if idle
@@ -755,14 +862,43 @@ void SysTray::resetTimer()
 // set "internal" monitor
 void SysTray::setInternalMonitor()
 {
-    internalMonitor = Screens::internal();
+    if (screens && screens->isValid()) { internalMonitor = screens->cachedInternal(); }
+    else { internalMonitor = Screens::internal(); }
     qDebug() << "internal monitor set to" << internalMonitor;
 }
 
+// monitor connected/disconnected
+void SysTray::handleMonitorStatus(const QString &output, bool connected)
+{
+    qDebug() << "monitor status" << output << connected;
+    if (lidXrandr) { layout->apply(lidWasClosed); }
+    if (connected || output == internalMonitor) { return; }
+    // last external monitor removed while lid is closed, apply lid action
+    if (lidWasClosed &&
+        disableLidOnExternalMonitors &&
+        !externalMonitorIsConnected()) { handleClosedLid(); }
+}
+
+// (re)check backlight device
+void SysTray::checkBacklight()
+{
+    backlightDevice = Common::backlightDevice();
+    hasBacklight = Common::canAdjustBacklight(backlightDevice);
+    qDebug() << "backlight device" << backlightDevice << hasBacklight;
+    if (hasBacklight) { transition->setDevice(backlightDevice); }
+}
+
+// cached outputs (falls back to a query if X connection failed)
+QMap<QString, bool> SysTray::monitors()
+{
+    if (screens && screens->isValid()) { return screens->cachedOutputs(); }
+    return Screens::outputs();
+}
+
 // is "internal" monitor connected?
 bool SysTray::internalMonitorIsConnected()
 {
-    QMapIterator<QString, bool> i(Screens::outputs());
+    QMapIterator<QString, bool> i(monitors());
     while (i.hasNext()) {
         i.next();
         if (i.key() == internalMonitor) {
@@ -776,7 +912,7 @@ bool SysTray::internalMonitorIsConnected()
 // is "external" monitor(s) connected?
 bool SysTray::externalMonitorIsConnected()
 {
-    QMapIterator<QString, bool> i(Screens::outputs());
+    QMapIterator<QString, bool> i(monitors());
     while (i.hasNext()) {
         i.next();
         if (i.key()!=internalMonitor &&
@@ -796,7 +932,7 @@ void SysTray::handleNewInhibitScreenSaver(const QString &application,
     qDebug() << "new screensaver inhibit" << application << reason << cookie;
     Q_UNUSED(reason)
     ssInhibitors[cookie] = application;
-    checkDevices();
+    scheduleRefresh(RefreshTooltip);
 }
 
 void SysTray::handleNewInhibitPowerManagement(const QString &application,
@@ -806,7 +942,7 @@ void SysTray::handleNewInhibitPowerManagement(const QString &application,
     qDebug() << "new powermanagement inhibit" << application << reason << cookie;
     Q_UNUSED(reason)
     pmInhibitors[cookie] = application;
-    checkDevices();
+    scheduleRefresh(RefreshTooltip);
 }
 
 void SysTray::handleDelInhibitScreenSaver(quint32 cookie)
@@ -814,7 +950,7 @@ void SysTray::handleDelInhibitScreenSaver(quint32 cookie)
     if (ssInhibitors.contains(cookie)) {
         qDebug() << "removed screensaver inhibitor" << ssInhibitors[cookie];
         ssInhibitors.remove(cookie);
-        checkDevices();
+        scheduleRefresh(RefreshTooltip);
     }
 }
 
@@ -823,7 +959,7 @@ void SysTray::handleDelInhibitPowerManagement(quint32 cookie)
     if (pmInhibitors.contains(cookie)) {
         qDebug() << "removed powermanagement inhibitor" << pmInhibitors[cookie];
         pmInhibitors.remove(cookie);
-        checkDevices();
+        scheduleRefresh(RefreshTooltip);
     }
 }
 
@@ -849,7 +985,28 @@ void SysTray::showMessage(const QString &title,
 // reload settings if conf changed
 void SysTray::handleConfChanged(const QString &file)
 {
-    Q_UNUSED(file)
+    // the file is replaced on save, so watch the new one
+    QString config = Common::confFile();
+    if (!watcher->files().contains(config)) { watcher->addPath(config); }
+
+    // ignore if already loaded (from handleUpdatedConfig)
+    QFileInfo conf(config);
+    if (file != CONF_SYSTEM_DIR &&
+        conf.lastModified() == confModified &&
+        conf.size() == confSize) { return; }
+    // only touch the icon theme if it changed
+    QVariant theme = Common::loadPowerSettings(CONF_ICON_THEME);
+    Common::invalidatePowerSettings();
+    if (Common::loadPowerSettings(CONF_ICON_THEME) != theme) { Theme::setIconTheme(); }
+    loadSettings();
+}
+
+// reload settings when notified by the config dialog
+void SysTray::handleUpdatedConfig(const QStringList &keys)
+{
+    qDebug() << "settings changed" << keys;
+    Common::invalidatePowerSettings();
+    if (keys.contains(CONF_ICON_THEME)) { Theme::setIconTheme(); }
     loadSettings();
 }
 
@@ -935,16 +1092,13 @@ void SysTray::handlePrepareForResume()
     ss->SimulateUserActivity();
 }
 
-// turn off/on monitor using xrandr
+// turn off/on monitor using randr (applies saved layout)
 // optional "hidden" feature (should be handled by a display manager)
 void SysTray::switchInternalMonitor(bool toggle)
 {
     if (!lidXrandr) { return; }
-    qDebug() << "using xrandr to turn on/off internal monitor" << toggle;
-    QProcess xrandr;
-    xrandr.start(QString(toggle?TURN_ON_MONITOR:TURN_OFF_MONITOR).arg(internalMonitor));
-    xrandr.waitForFinished();
-    xrandr.close();
+    qDebug() << "using randr to turn on/off internal monitor" << toggle;
+    layout->apply(!toggle);
 }
 
 // adjust backlight on wheel event (on systray)
@@ -953,12 +1107,10 @@ void SysTray::handleTrayWheel(TrayIcon::WheelAction action)
     if (!hasBacklight || !backlightMouseWheel) { return; }
     switch (action) {
     case TrayIcon::WheelUp:
-        Common::adjustBacklight(backlightDevice,
-                                Common::backlightValue(backlightDevice)+BACKLIGHT_MOVE_VALUE);
+        transition->adjust(BACKLIGHT_MOVE_VALUE);
         break;
     case TrayIcon::WheelDown:
-        Common::adjustBacklight(backlightDevice,
-                                Common::backlightValue(backlightDevice)-BACKLIGHT_MOVE_VALUE);
+        transition->adjust(-BACKLIGHT_MOVE_VALUE);
         break;
     default:;
     }
@@ -986,19 +1138,146 @@ void SysTray::showConfigDialog()
                         .arg(qApp->applicationFilePath()));
 }
 
-// catch wheel events
-bool TrayIcon::event(QEvent *e)
+TrayIcon::TrayIcon(QObject *parent)
+    : QObject(parent)
+    , wheel_delta(0)
+    , xembed(0)
+    , sni(0)
+    , sniWatcher(0)
+    , statusNotifier(false)
+    , visible(false)
+{
+    xembed = new QSystemTrayIcon(this);
+    xembed->installEventFilter(this);
+    connect(xembed,
+            SIGNAL(activated(QSystemTrayIcon::ActivationReason)),
+            this,
+            SIGNAL(activated(QSystemTrayIcon::ActivationReason)));
+
+    sni = new StatusNotifierItem(this);
+    connect(sni,
+            SIGNAL(activated()),
+            this,
+            SLOT(handleStatusNotifierActivated()));
+    connect(sni,
+            SIGNAL(scrolled(int)),
+            this,
+            SLOT(handleWheel(int)));
+    connect(sni,
+            SIGNAL(hostRegistered()),
+            this,
+            SLOT(setupStatusNotifier()));
+
+    // (re)register when the watcher (panel) comes and goes
+    sniWatcher = new QDBusServiceWatcher(SNI_WATCHER_SERVICE,
+                                         QDBusConnection::sessionBus(),
+                                         QDBusServiceWatcher::WatchForOwnerChange,
+                                         this);
+    connect(sniWatcher,
+            SIGNAL(serviceOwnerChanged(QString,QString,QString)),
+            this,
+            SLOT(setupStatusNotifier()));
+    setupStatusNotifier();
+}
+
+// use status notifier item if we have a host, else xembed
+void TrayIcon::setupStatusNotifier()
+{
+    bool wasStatusNotifier = statusNotifier;
+    statusNotifier = sni->registerItem();
+    if (statusNotifier == wasStatusNotifier) { return; }
+    qDebug() << "tray backend" << (statusNotifier?"StatusNotifierItem":"XEmbed");
+    if (statusNotifier) {
+        xembed->hide();
+        sni->setIcon(currentIconName, currentIcon);
+        sni->setToolTip(currentToolTip);
+        sni->setStatus(visible?SNI_STATUS_ACTIVE:SNI_STATUS_PASSIVE);
+    } else {
+        xembed->setIcon(currentIcon);
+        xembed->setToolTip(currentToolTip);
+        if (visible) { xembed->show(); }
+    }
+}
+
+bool TrayIcon::isStatusNotifier()
+{
+    return statusNotifier;
+}
+
+bool TrayIcon::isSystemTrayAvailable()
+{
+    return statusNotifier || QSystemTrayIcon::isSystemTrayAvailable();
+}
+
+bool TrayIcon::isVisible()
+{
+    if (statusNotifier) { return visible; }
+    return xembed->isVisible();
+}
+
+QIcon TrayIcon::icon()
+{
+    return currentIcon;
+}
+
+// the name is used by the status notifier host, the icon by xembed
+void TrayIcon::setIcon(const QIcon &icon, const QString &name)
+{
+    currentIcon = icon;
+    currentIconName = name;
+    if (statusNotifier) { sni->setIcon(name, icon); }
+    else { xembed->setIcon(icon); }
+}
+
+void TrayIcon::setToolTip(const QString &tip)
+{
+    currentToolTip = tip;
+    if (statusNotifier) { sni->setToolTip(tip); }
+    else { xembed->setToolTip(tip); }
+}
+
+// balloon messages only exist for xembed
+void TrayIcon::showMessage(const QString &title, const QString &msg)
+{
+    if (statusNotifier) { return; }
+    xembed->showMessage(title, msg);
+}
+
+void TrayIcon::show()
 {
-    if (e->type() == QEvent::Wheel) {
+    visible = true;
+    if (statusNotifier) { sni->setStatus(SNI_STATUS_ACTIVE); }
+    else { xembed->show(); }
+}
+
+void TrayIcon::hide()
+{
+    visible = false;
+    if (statusNotifier) { sni->setStatus(SNI_STATUS_PASSIVE); }
+    else { xembed->hide(); }
+}
+
+void TrayIcon::handleStatusNotifierActivated()
+{
+    emit activated(QSystemTrayIcon::Trigger);
+}
+
+void TrayIcon::handleWheel(int delta)
+{
+    wheel_delta += delta;
+    if (abs(wheel_delta)>=120) {
+        emit wheel(wheel_delta>0?TrayIcon::WheelUp:TrayIcon::WheelDown);
+        wheel_delta = 0;
+    }
+}
+
+// catch wheel events on the xembed icon
+bool TrayIcon::eventFilter(QObject *watched, QEvent *e)
+{
+    if (watched == xembed && e->type() == QEvent::Wheel) {
         QWheelEvent *w = (QWheelEvent*)e;
-        if (w->orientation() == Qt::Vertical) {
-            wheel_delta += w->delta();
-            if (abs(wheel_delta)>=120) {
-                emit wheel(wheel_delta>0?TrayIcon::WheelUp:TrayIcon::WheelDown);
-                wheel_delta = 0;
-            }
-        }
+        if (w->orientation() == Qt::Vertical) { handleWheel(w->delta()); }
         return true;
     }
-    return QSystemTrayIcon::event(e);
+    return QObject::eventFilter(watched, e);
 }
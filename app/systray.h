@@ -25,12 +25,23 @@
 #include <QFileSystemWatcher>
 #include <QEvent>
 #include <QWheelEvent>
+#include <QFileInfo>
+#include <QDateTime>
+#include <QDBusServiceWatcher>
 
 #include "common.h"
 #include "powermanagement.h"
 #include "screensaver.h"
 #include "screens.h"
+#include "hotplug.h"
+#include "randrlayout.h"
+#include "refreshrate.h"
+#include "criticalbattery.h"
+#include "backlight.h"
+#include "backlighttransition.h"
 #include "powerkit.h"
+#include "batteryicons.h"
+#include "statusnotifier.h"
 
 #include <X11/extensions/scrnsaver.h>
 #undef CursorShape
@@ -47,8 +58,11 @@
 #undef Unsorted
 
 #define XSCREENSAVER_RUN "xscreensaver -no-splash"
+#define TRAY_REFRESH_DELAY 250
 
-class TrayIcon : public QSystemTrayIcon
+// StatusNotifierItem if available, XEmbed (QSystemTrayIcon) as fallback.
+// the backends are owned, not inherited, so no call can bypass the switch
+class TrayIcon : public QObject
 {
     Q_OBJECT
 public:
@@ -56,15 +70,35 @@ public:
         WheelUp,
         WheelDown
     };
-    TrayIcon(QObject *parent = 0)
-        : QSystemTrayIcon(parent), wheel_delta(0) {}
-    TrayIcon(const QIcon &icon, QObject *parent = 0)
-        : QSystemTrayIcon(icon, parent), wheel_delta(0) {}
-    bool event(QEvent *event);
+    explicit TrayIcon(QObject *parent = 0);
+    bool eventFilter(QObject *watched, QEvent *event);
+    bool isStatusNotifier();
+    bool isSystemTrayAvailable();
+    bool isVisible();
+    QIcon icon();
+    void setIcon(const QIcon &icon, const QString &name = QString());
+    void setToolTip(const QString &tip);
+    void showMessage(const QString &title, const QString &msg);
 signals:
+    void activated(QSystemTrayIcon::ActivationReason reason);
     void wheel(TrayIcon::WheelAction action);
+public slots:
+    void show();
+    void hide();
+private slots:
+    void setupStatusNotifier();
+    void handleStatusNotifierActivated();
+    void handleWheel(int delta);
 private:
     int wheel_delta;
+    QSystemTrayIcon *xembed;
+    StatusNotifierItem *sni;
+    QDBusServiceWatcher *sniWatcher;
+    bool statusNotifier;
+    bool visible;
+    QIcon currentIcon;
+    QString currentIconName;
+    QString currentToolTip;
 };
 
 class SysTray : public QObject
@@ -72,6 +106,14 @@ class SysTray : public QObject
     Q_OBJECT
 
 public:
+    enum RefreshPart {
+        RefreshNone = 0x0,
+        RefreshTooltip = 0x1,
+        RefreshIcon = 0x2,
+        RefreshThresholds = 0x4,
+        RefreshAll = RefreshTooltip|RefreshIcon|RefreshThresholds
+    };
+
     explicit SysTray(QObject *parent = NULL);
     ~SysTray();
 
@@ -104,11 +146,19 @@ private:
     QMap<quint32,QString> ssInhibitors;
     QMap<quint32,QString> pmInhibitors;
     QString internalMonitor;
+    Screens *screens;
+    HotPlug *hotplug;
+    RandRLayout *layout;
+    RefreshRate *refreshRate;
+    bool refreshLowOnBattery;
+    CriticalBattery *critical;
     QFileSystemWatcher *watcher;
     bool lidXrandr;
     bool lidWasClosed;
     QString backlightDevice;
     bool hasBacklight;
+    Backlight *backlight;
+    BacklightTransition *transition;
     bool backlightOnBattery;
     bool backlightOnAC;
     int backlightBatteryValue;
@@ -122,6 +172,13 @@ private:
     bool notifyOnAC;
     bool backlightMouseWheel;
     bool ignoreKernelResume;
+    QDateTime confModified;
+    qint64 confSize;
+    QTimer *refreshTimer;
+    int refreshDirty;
+    QString trayTooltip;
+    int trayIconState;
+    int trayIconGeneration;
 
 private slots:
     void trayActivated(QSystemTrayIcon::ActivationReason reason);
@@ -133,14 +190,21 @@ private slots:
     void loadSettings();
     void registerService();
     void handleHasInhibitChanged(bool has_inhibit);
-    void handleLow(double left);
-    void handleVeryLow(double left);
-    void handleCritical(double left);
-    void drawBattery(double left);
+    void handleLow(double left, bool onBattery);
+    void handleVeryLow(double left, bool onBattery);
+    void handleCritical(double left, bool onBattery);
+    void handleCriticalAction(double left);
+    void drawBattery(double left, bool onBattery, bool hasBattery);
+    void scheduleRefresh(int parts);
+    void refresh();
+    QString batteryTooltip(double left, bool onBattery, bool hasBattery);
     void timeout();
     int xIdle();
     void resetTimer();
     void setInternalMonitor();
+    void handleMonitorStatus(const QString &output, bool connected);
+    void checkBacklight();
+    QMap<QString,bool> monitors();
     bool internalMonitorIsConnected();
     bool externalMonitorIsConnected();
     void handleNewInhibitScreenSaver(const QString &application,
@@ -156,6 +220,7 @@ private slots:
                      const QString &msg,
                      bool critical = false);
     void handleConfChanged(const QString &file);
+    void handleUpdatedConfig(const QStringList &keys);
     void disableHibernate();
     void disableSuspend();
     void handlePrepareForSuspend();
@@ -16,6 +16,7 @@
 
 #include "def.h"
 #include "common.h"
+#include "batteryicons.h"
 
 void Theme::setIconTheme()
 {
@@ -60,4 +61,5 @@ void Theme::setIconTheme()
         }
     }
 #endif
+    BatteryIcons::invalidate(); // re-render with new theme
 }
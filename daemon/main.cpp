@@ -7,20 +7,30 @@
 */
 
 #include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QStringList>
 #include <QtDBus>
 
 #include "manager.h"
 
-#define DSERVICE "org.freedesktop.powerkitd"
-#define DPATH "/powerkitd"
-#define DFULL_PATH "/org/freedesktop/powerkitd"
-
 int main(int argc, char *argv[])
 {
+    QElapsedTimer startup;
+    startup.start();
+
     QCoreApplication a(argc, argv);
     QCoreApplication::setOrganizationDomain("org");
     QCoreApplication::setApplicationName("freedesktop.powerkitd");
 
+    // --idle <seconds> (0 = stay resident), --state <file>
+    int idle = DAEMON_IDLE_TIMEOUT;
+    QString stateFile = DAEMON_STATE_FILE;
+    QStringList args = QCoreApplication::arguments();
+    for (int i=1;i<args.size()-1;++i) {
+        if (args.at(i) == "--idle") { idle = args.at(i+1).toInt(); }
+        else if (args.at(i) == "--state") { stateFile = args.at(i+1); }
+    }
+
     if (!QDBusConnection::systemBus().isConnected()) {
         qWarning("Cannot connect to the D-Bus system bus.");
         return 1;
@@ -31,7 +41,8 @@ int main(int argc, char *argv[])
         return 1;
     }
 
-    Manager man;
+    Manager man(stateFile);
+    man.setIdleTimeout(idle);
     if (!QDBusConnection::systemBus().registerObject(DPATH,
                                                      &man,
                                                      QDBusConnection::ExportAllContents)) {
@@ -45,5 +56,10 @@ int main(int argc, char *argv[])
         return 1;
     }
 
+    qint64 elapsed = startup.elapsed();
+    if (elapsed>DAEMON_STARTUP_BUDGET) {
+        qWarning() << "startup took" << elapsed << "ms, budget is" << DAEMON_STARTUP_BUDGET << "ms";
+    } else { qDebug() << "started in" << elapsed << "ms"; }
+
     return a.exec();
 }
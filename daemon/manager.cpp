@@ -7,30 +7,260 @@
 */
 
 #include "manager.h"
-#include "rtc.h"
 #include "common.h"
+#include "sysfsattribute.h"
 
+#include <QMapIterator>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QDBusReply>
 #include <QDebug>
 
-Manager::Manager(QObject *parent) : QObject(parent)
+class BacklightJob : public WorkJob
 {
+public:
+    BacklightJob(const QString &device, int value, WorkBatch *batch)
+        : WorkJob(device, batch)
+        , _device(device)
+        , _value(value) {}
+protected:
+    bool work()
+    {
+        return SysfsAttribute::shared(QString("%1/brightness").arg(_device))->write(_value);
+    }
+private:
+    QString _device;
+    int _value;
+};
+
+Manager::Manager(const QString &stateFile, QObject *parent) : QObject(parent)
+  , backlight(0)
+  , queue(0)
+  , scheduler(0)
+  , state(stateFile)
+  , idleTimer(0)
+  , stateTimer(0)
+  , idleTimeout(0)
+{
+    // keeps the backlight registry current
+    backlight = new Backlight(this);
+    // slow requests (RTC) don't block others, one queue per device
+    queue = new WorkQueue(this);
+    connect(queue, SIGNAL(idle()),
+            this, SLOT(resetIdle()));
+    // wake times from all clients
+    scheduler = new WakeScheduler(queue, this);
+
+    // we are started by the bus when needed
+    idleTimer = new QTimer(this);
+    idleTimer->setSingleShot(true);
+    connect(idleTimer, SIGNAL(timeout()),
+            this, SLOT(handleIdle()));
+    setIdleTimeout(DAEMON_IDLE_TIMEOUT);
+
+    // collapse writes
+    stateTimer = new QTimer(this);
+    stateTimer->setSingleShot(true);
+    stateTimer->setInterval(DAEMON_STATE_DELAY);
+    connect(stateTimer, SIGNAL(timeout()),
+            this, SLOT(saveState()));
+
+    loadState();
+}
+
+Manager::~Manager()
+{
+    saveState();
+}
+
+void Manager::setIdleTimeout(int seconds)
+{
+    idleTimeout = seconds;
+    idleTimer->stop();
+    if (idleTimeout<1) { return; }
+    idleTimer->setInterval(idleTimeout*1000);
+    idleTimer->start();
+}
+
+// re-arm wake entries from the last run
+void Manager::loadState()
+{
+    state.load();
+    scheduler->restore(state.wakeEntries());
+    connect(scheduler, SIGNAL(changed()),
+            this, SLOT(handleWakeEntriesChanged()));
+    // the kernel resets backlights on boot. we are activated lazily,
+    // later activations must not undo what the user set since
+    double uptime = DaemonState::uptime();
+    if (state.isNewBoot() && uptime>=0 && uptime<DAEMON_RESTORE_UPTIME) { restoreBacklight(); }
+    handleWakeEntriesChanged();
+}
+
+// on the pool, startup is not held up by the writes
+void Manager::restoreBacklight()
+{
+    QMapIterator<QString, int> i(state.backlight());
+    while (i.hasNext()) {
+        i.next();
+        int light = i.value();
+        if (!validBacklight(i.key(), &light)) { continue; }
+        qDebug() << "restore DISPLAY backlight" << i.key() << light;
+        queue->enqueue(new BacklightJob(i.key(), light, NULL));
+    }
+}
+
+void Manager::saveState()
+{
+    stateTimer->stop();
+    state.save();
+}
+
+void Manager::resetIdle()
+{
+    if (idleTimeout<1) { return; }
+    idleTimer->start();
+}
+
+void Manager::handleWakeEntriesChanged()
+{
+    state.setWakeEntries(scheduler->save());
+    if (state.isDirty()) { stateTimer->start(); }
+    resetIdle();
+}
+
+// nothing to do, save state and let the bus start us again
+void Manager::handleIdle()
+{
+    if (!queue->isIdle()) { return; } // restarted on queue idle
+    if (scheduler->needsResident()) { return; } // restarted on changes
+    qDebug() << "idle, exit";
+    saveState();
+    QDBusConnection::systemBus().unregisterService(DSERVICE);
+    QCoreApplication::quit();
+}
+
+// reply when the jobs are done (on the pool)
+WorkBatch *Manager::delayReply(int count)
+{
+    if (!calledFromDBus()) {
+        return new WorkBatch(QDBusConnection::systemBus(), QDBusMessage(), count);
+    }
+    setDelayedReply(true);
+    return new WorkBatch(connection(), message(), count);
+}
+
+// root for internal calls
+uint Manager::callerUid()
+{
+    if (!calledFromDBus()) { return 0; }
+    QDBusReply<uint> uid = connection().interface()->serviceUid(message().service());
+    if (!uid.isValid()) { return (uint)-1; }
+    return uid.value();
 }
 
+// checked in the main thread (registry is cached)
+bool Manager::validBacklight(const QString &device, int *value)
+{
+    if (!Backlight::contains(device)) { return false; }
+    if (!Common::canAdjustBacklight(device)) { return false; }
+    int max = Common::backlightMax(device);
+    if (*value>max) { *value = max; }
+    else if (*value<0) { *value = 0; }
+    return true;
+}
+
+QString Manager::wakeAlarm()
+{
+    resetIdle();
+    QDateTime alarm = scheduler->next();
+    if (!alarm.isValid()) { return QString(); }
+    return alarm.toString(WAKE_DATE_FORMAT);
+}
+
+// replaces the caller's previous alarm
 bool Manager::setWakeAlarm(const QString &alarm)
 {
     qDebug() << "Try to set RTC wake alarm" << alarm;
-    QDateTime date = QDateTime::fromString(alarm, "yyyy-MM-dd HH:mm:ss");
+    resetIdle();
+    QDateTime date = QDateTime::fromString(alarm, WAKE_DATE_FORMAT);
     if (date.isNull() || !date.isValid()) { return false; }
-    return RTC::setAlarm(date);
+    // reply when the RTC is programmed, callers suspend right after
+    scheduler->replace(date, callerUid(), delayReply(1));
+    return true;
+}
+
+// interval in seconds (0 = once, else at least WAKE_MIN_INTERVAL),
+// actions other than none are root only. returns entry id (0 on failure)
+uint Manager::addWakeAlarm(const QString &alarm, int interval, const QString &action)
+{
+    qDebug() << "Try to add RTC wake alarm" << alarm << interval << action;
+    resetIdle();
+    QDateTime date = QDateTime::fromString(alarm, WAKE_DATE_FORMAT);
+    if (date.isNull() || !date.isValid()) { return 0; }
+    return scheduler->add(date,
+                          interval,
+                          action.isEmpty()?QString(WAKE_ACTION_NONE):action,
+                          callerUid());
+}
+
+bool Manager::cancelWakeAlarm(uint id)
+{
+    qDebug() << "Try to cancel RTC wake alarm" << id;
+    resetIdle();
+    return scheduler->cancel(id, callerUid());
+}
+
+QVariantList Manager::wakeAlarms()
+{
+    resetIdle();
+    QVariantList result;
+    QList<WakeEntry> entries = scheduler->entries();
+    for (int i=0;i<entries.size();++i) {
+        QVariantMap entry;
+        entry["id"] = entries.at(i).id;
+        entry["uid"] = entries.at(i).uid;
+        entry["date"] = entries.at(i).date.toString(WAKE_DATE_FORMAT);
+        entry["interval"] = entries.at(i).interval;
+        entry["action"] = entries.at(i).action;
+        result << entry;
+    }
+    return result;
 }
 
 bool Manager::setDisplayBacklight(const QString &device, int value)
 {
     qDebug() << "Try to set DISPLAY backlight" << device << value;
-    if (!Common::canAdjustBacklight(device)) { return false; }
+    resetIdle();
     int light = value;
-    if (light>Common::backlightMax(device)) { light = Common::backlightMax(device); }
-    else if (light<0) { light = 0; }
-    return Common::adjustBacklight(device, light);
+    if (!validBacklight(device, &light)) { return false; }
+    queue->enqueue(new BacklightJob(device, light, delayReply(1)));
+    state.setBacklight(device, light);
+    stateTimer->start();
+    return true;
 }
 
+// set several devices, one reply
+bool Manager::setDisplayBacklights(const QVariantMap &devices)
+{
+    qDebug() << "Try to set DISPLAY backlights" << devices;
+    resetIdle();
+    if (devices.isEmpty()) { return false; }
+    QMap<QString, int> values;
+    QMapIterator<QString, QVariant> i(devices);
+    while (i.hasNext()) {
+        i.next();
+        int light = i.value().toInt();
+        if (!validBacklight(i.key(), &light)) { return false; }
+        values[i.key()] = light;
+    }
+    WorkBatch *batch = delayReply(values.size());
+    QMapIterator<QString, int> v(values);
+    while (v.hasNext()) {
+        v.next();
+        queue->enqueue(new BacklightJob(v.key(), v.value(), batch));
+        state.setBacklight(v.key(), v.value());
+    }
+    stateTimer->start();
+    return true;
+}
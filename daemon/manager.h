@@ -11,17 +11,62 @@
 
 #include <QObject>
 #include <QString>
+#include <QVariantMap>
+#include <QDBusContext>
+#include <QTimer>
 
-class Manager : public QObject
+#include "backlight.h"
+#include "workqueue.h"
+#include "scheduler.h"
+#include "state.h"
+
+#define DSERVICE "org.freedesktop.powerkitd"
+#define DPATH "/powerkitd"
+#define DFULL_PATH "/org/freedesktop/powerkitd"
+
+#define DAEMON_IDLE_TIMEOUT 120 // seconds, 0 = never exit
+#define DAEMON_STATE_DELAY 1000
+#define DAEMON_STARTUP_BUDGET 50 // ms, state load and registration
+
+class Manager : public QObject, protected QDBusContext
 {
     Q_OBJECT
 
 public:
-    explicit Manager(QObject *parent = NULL);
+    explicit Manager(const QString &stateFile = DAEMON_STATE_FILE,
+                     QObject *parent = NULL);
+    ~Manager();
+    void setIdleTimeout(int seconds);
+
+private:
+    Backlight *backlight;
+    WorkQueue *queue;
+    WakeScheduler *scheduler;
+    DaemonState state;
+    QTimer *idleTimer;
+    QTimer *stateTimer;
+    int idleTimeout;
+
+    WorkBatch *delayReply(int count);
+    bool validBacklight(const QString &device, int *value);
+    uint callerUid();
+    void loadState();
+    void restoreBacklight();
+
+private slots:
+    void resetIdle();
+    void handleIdle();
+    void saveState();
+    void handleWakeEntriesChanged();
 
 public slots:
+    QString wakeAlarm();
     bool setWakeAlarm(const QString &alarm);
+    uint addWakeAlarm(const QString &alarm, int interval, const QString &action);
+    bool cancelWakeAlarm(uint id);
+    QVariantList wakeAlarms();
     bool setDisplayBacklight(const QString &device, int value);
+    bool setDisplayBacklights(const QVariantMap &devices);
 };
 
 #endif // MANAGER_H
@@ -0,0 +1,371 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "scheduler.h"
+#include "rtc.h"
+#include "powerkit.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QProcess>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDebug>
+
+#include <algorithm>
+
+// program (or clear) the RTC alarm
+class AlarmJob : public WorkJob
+{
+public:
+    AlarmJob(const QDateTime &date, WorkBatch *batch = NULL)
+        : WorkJob(RTC_QUEUE, batch)
+        , _date(date) {}
+protected:
+    bool work()
+    {
+        if (!_date.isValid()) { return RTC::clearAlarm(); }
+        return RTC::setAlarm(_date);
+    }
+private:
+    QDateTime _date;
+};
+
+// queued after the alarm, so the next wake time is set before we sleep
+class SuspendJob : public WorkJob
+{
+public:
+    SuspendJob() : WorkJob(RTC_QUEUE) {}
+protected:
+    bool work()
+    {
+        QDBusMessage message = QDBusMessage::createMethodCall(LOGIND_SERVICE,
+                                                              LOGIND_PATH,
+                                                              LOGIND_MANAGER,
+                                                              "Suspend");
+        message << false;
+        QDBusMessage reply = QDBusConnection::systemBus().call(message);
+        if (reply.type() == QDBusMessage::ErrorMessage) {
+            qWarning() << "failed to suspend" << reply.errorMessage();
+            return false;
+        }
+        return true;
+    }
+};
+
+// run the hooks in name order, one at a time
+class MaintenanceJob : public WorkJob
+{
+public:
+    MaintenanceJob(bool hooks, bool suspend, QObject *scheduler)
+        : WorkJob(MAINTENANCE_QUEUE)
+        , _hooks(hooks)
+        , _suspend(suspend)
+        , _scheduler(scheduler) {}
+protected:
+    bool work()
+    {
+        bool result = true;
+        if (_hooks) {
+            QDir dir(MAINTENANCE_HOOKS);
+            foreach (QFileInfo hook, dir.entryInfoList(QDir::Files|QDir::Executable, QDir::Name)) {
+                qDebug() << "run maintenance hook" << hook.absoluteFilePath();
+                QProcess proc;
+                proc.start(hook.absoluteFilePath());
+                if (!proc.waitForStarted()) {
+                    result = false;
+                    continue;
+                }
+                if (!proc.waitForFinished(MAINTENANCE_HOOK_TIMEOUT)) {
+                    qWarning() << "maintenance hook timed out" << hook.absoluteFilePath();
+                    proc.kill();
+                    proc.waitForFinished();
+                    result = false;
+                }
+            }
+        }
+        QMetaObject::invokeMethod(_scheduler,
+                                  "handleMaintenanceDone",
+                                  Qt::QueuedConnection,
+                                  Q_ARG(bool, _suspend));
+        return result;
+    }
+private:
+    bool _hooks;
+    bool _suspend;
+    QObject *_scheduler;
+};
+
+// first run after now, in one step (dates may be far in the past)
+static QDateTime nextRun(const QDateTime &date, int interval, const QDateTime &now)
+{
+    if (date>now) { return date; }
+    qint64 steps = date.secsTo(now)/interval+1;
+    return date.addSecs(steps*interval);
+}
+
+// heap order, earliest on top
+static bool laterEntry(const WakeEntry &a, const WakeEntry &b)
+{
+    return a.date > b.date;
+}
+
+WakeScheduler::WakeScheduler(WorkQueue *queue, QObject *parent)
+    : QObject(parent)
+    , _queue(queue)
+    , lastId(0)
+    , programmedValid(false)
+    , sleeping(false)
+    , timer(0)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()),
+            this, SLOT(check()));
+    QDBusConnection::systemBus().connect(LOGIND_SERVICE,
+                                         LOGIND_PATH,
+                                         LOGIND_MANAGER,
+                                         "PrepareForSleep",
+                                         this,
+                                         SLOT(handlePrepareForSleep(bool)));
+}
+
+bool WakeScheduler::validAction(const QString &action)
+{
+    return action == WAKE_ACTION_NONE ||
+           action == WAKE_ACTION_SUSPEND ||
+           action == WAKE_ACTION_MAINTENANCE;
+}
+
+// actions run as root (hooks, suspend without polkit), so only root may add them
+bool WakeScheduler::validEntry(int interval, const QString &action, uint uid)
+{
+    if (interval<0 || (interval>0 && interval<WAKE_MIN_INTERVAL)) { return false; }
+    if (!validAction(action)) { return false; }
+    return action == WAKE_ACTION_NONE || uid == 0;
+}
+
+// batch is done when the RTC is programmed (unused on failure)
+uint WakeScheduler::add(const QDateTime &date,
+                        int interval,
+                        const QString &action,
+                        uint uid,
+                        WorkBatch *batch)
+{
+    if (!date.isValid() || !validEntry(interval, action, uid)) { return 0; }
+    if (date <= QDateTime::currentDateTime() && interval == 0) { return 0; }
+    WakeEntry entry;
+    entry.id = ++lastId;
+    entry.uid = uid;
+    entry.date = date;
+    entry.interval = interval;
+    entry.action = action;
+    if (interval>0) { entry.date = nextRun(date, interval, QDateTime::currentDateTime()); }
+    push(entry);
+    qDebug() << "wake entry added" << entry.id << entry.date << interval << action;
+    program(batch);
+    schedule();
+    emit changed();
+    return entry.id;
+}
+
+// single plain alarm per user (setWakeAlarm), batch fails if not added
+uint WakeScheduler::replace(const QDateTime &date,
+                            uint uid,
+                            WorkBatch *batch)
+{
+    for (int i=0;i<heap.size();++i) {
+        if (heap.at(i).uid != uid ||
+            heap.at(i).interval != 0 ||
+            heap.at(i).action != WAKE_ACTION_NONE) { continue; }
+        heap.remove(i);
+        rebuild();
+        break;
+    }
+    uint id = add(date, 0, WAKE_ACTION_NONE, uid, batch);
+    if (!id) { // removed only
+        if (batch) { batch->failed.fetchAndAddOrdered(1); }
+        program(batch);
+        schedule();
+        emit changed();
+    }
+    return id;
+}
+
+// owner or root
+bool WakeScheduler::cancel(uint id, uint uid)
+{
+    for (int i=0;i<heap.size();++i) {
+        if (heap.at(i).id != id) { continue; }
+        if (uid != 0 && heap.at(i).uid != uid) { return false; }
+        heap.remove(i);
+        rebuild();
+        qDebug() << "wake entry canceled" << id;
+        program();
+        schedule();
+        emit changed();
+        return true;
+    }
+    return false;
+}
+
+// sorted by date
+QList<WakeEntry> WakeScheduler::entries()
+{
+    QVector<WakeEntry> sorted = heap;
+    std::sort_heap(sorted.begin(), sorted.end(), laterEntry);
+    // sort_heap leaves the latest first
+    QList<WakeEntry> result;
+    for (int i=sorted.size()-1;i>=0;--i) { result.append(sorted.at(i)); }
+    return result;
+}
+
+QDateTime WakeScheduler::next()
+{
+    if (heap.isEmpty()) { return QDateTime(); }
+    return heap.first().date;
+}
+
+// actions need us when the entry is due
+bool WakeScheduler::needsResident()
+{
+    for (int i=0;i<heap.size();++i) {
+        if (heap.at(i).interval>0 || heap.at(i).action != WAKE_ACTION_NONE) { return true; }
+    }
+    return false;
+}
+
+// id;uid;date;interval;action
+QStringList WakeScheduler::save()
+{
+    QStringList result;
+    QList<WakeEntry> list = entries();
+    for (int i=0;i<list.size();++i) {
+        result << QString("%1;%2;%3;%4;%5")
+                  .arg(list.at(i).id)
+                  .arg(list.at(i).uid)
+                  .arg(list.at(i).date.toString(WAKE_DATE_FORMAT))
+                  .arg(list.at(i).interval)
+                  .arg(list.at(i).action);
+    }
+    return result;
+}
+
+// past single entries are dropped, recurring moved forward
+void WakeScheduler::restore(const QStringList &entries)
+{
+    heap.clear();
+    QDateTime now = QDateTime::currentDateTime();
+    for (int i=0;i<entries.size();++i) {
+        QStringList fields = entries.at(i).split(";");
+        if (fields.size() != 5) { continue; }
+        WakeEntry entry;
+        entry.id = fields.at(0).toUInt();
+        entry.uid = fields.at(1).toUInt();
+        entry.date = QDateTime::fromString(fields.at(2), WAKE_DATE_FORMAT);
+        entry.interval = fields.at(3).toInt();
+        entry.action = fields.at(4);
+        if (!entry.id || !entry.date.isValid() ||
+            !validEntry(entry.interval, entry.action, entry.uid)) { continue; }
+        if (entry.id>lastId) { lastId = entry.id; }
+        if (entry.interval>0) { entry.date = nextRun(entry.date, entry.interval, now); }
+        else if (entry.date <= now) { continue; }
+        push(entry);
+    }
+    qDebug() << "restored wake entries" << heap.size();
+    program();
+    schedule();
+}
+
+void WakeScheduler::push(const WakeEntry &entry)
+{
+    heap.append(entry);
+    std::push_heap(heap.begin(), heap.end(), laterEntry);
+}
+
+void WakeScheduler::rebuild()
+{
+    std::make_heap(heap.begin(), heap.end(), laterEntry);
+}
+
+// only touch the RTC when the earliest entry changed,
+// or when a caller waits for it
+void WakeScheduler::program(WorkBatch *batch)
+{
+    QDateTime date = next();
+    if (programmedValid && date == programmed && !batch) { return; }
+    programmed = date;
+    programmedValid = true;
+    qDebug() << "program RTC wake alarm" << date;
+    _queue->enqueue(new AlarmJob(date, batch));
+}
+
+// monotonic timers don't count suspend, check the wall clock often
+void WakeScheduler::schedule()
+{
+    timer->stop();
+    if (heap.isEmpty()) { return; }
+    qint64 msecs = (qint64)QDateTime::currentDateTime().secsTo(next())*1000;
+    if (msecs<0) { msecs = 0; }
+    if (msecs>WAKE_CHECK_INTERVAL) { msecs = WAKE_CHECK_INTERVAL; }
+    timer->start((int)msecs);
+}
+
+// only suspend again if the system was woken for this
+void WakeScheduler::runAction(const WakeEntry &entry)
+{
+    qDebug() << "wake entry due" << entry.id << entry.action;
+    if (entry.action == WAKE_ACTION_NONE) { return; }
+    bool woken = sleeping ||
+                 (resumed.isValid() &&
+                  resumed.secsTo(QDateTime::currentDateTime()) <= WAKE_RESUME_WINDOW);
+    bool hooks = entry.action == WAKE_ACTION_MAINTENANCE;
+    if (!hooks && !woken) { return; }
+    _queue->enqueue(new MaintenanceJob(hooks, woken, this));
+}
+
+// handle due entries
+void WakeScheduler::check()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    bool modified = false;
+    while (!heap.isEmpty() && heap.first().date <= now) {
+        std::pop_heap(heap.begin(), heap.end(), laterEntry);
+        WakeEntry entry = heap.last();
+        heap.remove(heap.size()-1);
+        modified = true;
+        runAction(entry);
+        if (entry.interval>0) {
+            entry.date = nextRun(entry.date, entry.interval, now);
+            push(entry);
+        }
+    }
+    if (modified) {
+        program();
+        emit changed();
+    }
+    schedule();
+}
+
+// the timer may fire before we are told about the resume
+void WakeScheduler::handlePrepareForSleep(bool sleep)
+{
+    sleeping = sleep;
+    if (sleep) { return; }
+    resumed = QDateTime::currentDateTime();
+    check();
+}
+
+void WakeScheduler::handleMaintenanceDone(bool suspend)
+{
+    if (!suspend) { return; }
+    resumed = QDateTime();
+    program();
+    qDebug() << "suspend after wake entry";
+    _queue->enqueue(new SuspendJob());
+}
@@ -0,0 +1,98 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QObject>
+#include <QString>
+#include <QStringList>
+#include <QDateTime>
+#include <QVector>
+#include <QTimer>
+
+#include "workqueue.h"
+
+#define RTC_QUEUE "rtc"
+#define MAINTENANCE_QUEUE "maintenance"
+
+#define WAKE_ACTION_NONE "none"
+#define WAKE_ACTION_SUSPEND "suspend" // suspend again
+#define WAKE_ACTION_MAINTENANCE "maintenance" // run hooks, suspend again
+
+#define WAKE_DATE_FORMAT "yyyy-MM-dd HH:mm:ss"
+#define WAKE_CHECK_INTERVAL 60000 // timers stop during suspend
+#define WAKE_RESUME_WINDOW 300 // seconds, only suspend again if we woke the system
+#define WAKE_MIN_INTERVAL 60 // seconds between runs of a recurring entry
+#define MAINTENANCE_HOOKS "/etc/powerkitd/maintenance.d"
+#define MAINTENANCE_HOOK_TIMEOUT 600000
+
+struct WakeEntry
+{
+    uint id;
+    uint uid; // owner
+    QDateTime date;
+    int interval; // seconds, 0 = once
+    QString action;
+};
+
+// wake times from all clients in a min-heap, the RTC is
+// always programmed with the earliest one
+class WakeScheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WakeScheduler(WorkQueue *queue, QObject *parent = NULL);
+    static bool validAction(const QString &action);
+    static bool validEntry(int interval, const QString &action, uint uid);
+
+    uint add(const QDateTime &date,
+             int interval,
+             const QString &action,
+             uint uid,
+             WorkBatch *batch = NULL);
+    uint replace(const QDateTime &date,
+                 uint uid,
+                 WorkBatch *batch = NULL);
+    bool cancel(uint id, uint uid);
+    QList<WakeEntry> entries();
+    QDateTime next();
+    bool needsResident();
+
+    QStringList save();
+    void restore(const QStringList &entries);
+
+private:
+    WorkQueue *_queue;
+    QVector<WakeEntry> heap;
+    uint lastId;
+    QDateTime programmed;
+    bool programmedValid;
+    bool sleeping;
+    QDateTime resumed;
+    QTimer *timer;
+
+    void push(const WakeEntry &entry);
+    void rebuild();
+    void program(WorkBatch *batch = NULL);
+    void schedule();
+    void runAction(const WakeEntry &entry);
+
+signals:
+    void changed();
+
+public slots:
+    void check();
+
+private slots:
+    void handlePrepareForSleep(bool sleep);
+    void handleMaintenanceDone(bool suspend);
+};
+
+#endif // SCHEDULER_H
@@ -0,0 +1,144 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "state.h"
+#include "sysfsattribute.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QDir>
+#include <QSettings>
+#include <QStringList>
+#include <QMapIterator>
+#include <QDebug>
+
+#include <stdio.h>
+#include <unistd.h>
+
+#define STATE_WAKE "wake"
+#define STATE_BACKLIGHT "backlight"
+#define STATE_BOOT "boot"
+
+DaemonState::DaemonState(const QString &file)
+    : _file(file)
+    , _dirty(false)
+    , _newBoot(true)
+{
+    _boot = SysfsAttribute::readString(DAEMON_BOOT_ID);
+}
+
+// s since boot, -1 if unknown
+double DaemonState::uptime()
+{
+    QString value = SysfsAttribute::readString(DAEMON_UPTIME).section(" ", 0, 0);
+    bool ok = false;
+    double result = value.toDouble(&ok);
+    return ok?result:-1;
+}
+
+QString DaemonState::fileName()
+{
+    return _file;
+}
+
+bool DaemonState::load()
+{
+    if (!QFile::exists(_file)) { return true; }
+    QSettings settings(_file, QSettings::IniFormat);
+    if (settings.status() != QSettings::NoError) {
+        qWarning() << "failed to read state" << _file;
+        return false;
+    }
+    _wake = settings.value(STATE_WAKE).toStringList();
+    _backlight.clear();
+    settings.beginGroup(STATE_BACKLIGHT);
+    foreach (QString key, settings.childKeys()) {
+        // device paths are stored with '/' replaced
+        QString device = QString(key).replace("|", "/");
+        _backlight[device] = settings.value(key).toInt();
+    }
+    settings.endGroup();
+    _newBoot = _boot.isEmpty() || settings.value(STATE_BOOT).toString() != _boot;
+    _dirty = _newBoot; // record this boot
+    return true;
+}
+
+// written to a temp file and renamed into place
+bool DaemonState::save()
+{
+    if (!_dirty) { return true; }
+    QDir().mkpath(QFileInfo(_file).absolutePath());
+    QString temp = QString("%1.tmp").arg(_file);
+    QFile::remove(temp);
+    {
+        QSettings settings(temp, QSettings::IniFormat);
+        if (!_boot.isEmpty()) { settings.setValue(STATE_BOOT, _boot); }
+        if (!_wake.isEmpty()) { settings.setValue(STATE_WAKE, _wake); }
+        settings.beginGroup(STATE_BACKLIGHT);
+        QMapIterator<QString, int> i(_backlight);
+        while (i.hasNext()) {
+            i.next();
+            settings.setValue(QString(i.key()).replace("/", "|"), i.value());
+        }
+        settings.endGroup();
+        settings.sync();
+        if (settings.status() != QSettings::NoError) {
+            qWarning() << "failed to write state" << temp;
+            QFile::remove(temp);
+            return false;
+        }
+    }
+    QFile tempFile(temp);
+    if (tempFile.open(QIODevice::ReadOnly)) {
+        fsync(tempFile.handle());
+        tempFile.close();
+    }
+    if (rename(QFile::encodeName(temp).constData(),
+               QFile::encodeName(_file).constData()) != 0) {
+        qWarning() << "failed to replace state" << _file;
+        QFile::remove(temp);
+        return false;
+    }
+    _dirty = false;
+    return true;
+}
+
+bool DaemonState::isDirty()
+{
+    return _dirty;
+}
+
+// first load since the machine booted
+bool DaemonState::isNewBoot()
+{
+    return _newBoot;
+}
+
+void DaemonState::setWakeEntries(const QStringList &entries)
+{
+    if (entries == _wake) { return; }
+    _wake = entries;
+    _dirty = true;
+}
+
+QStringList DaemonState::wakeEntries()
+{
+    return _wake;
+}
+
+void DaemonState::setBacklight(const QString &device, int value)
+{
+    if (_backlight.contains(device) && _backlight.value(device) == value) { return; }
+    _backlight[device] = value;
+    _dirty = true;
+}
+
+QMap<QString, int> DaemonState::backlight()
+{
+    return _backlight;
+}
@@ -0,0 +1,46 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef STATE_H
+#define STATE_H
+
+#include <QString>
+#include <QStringList>
+#include <QMap>
+
+#define DAEMON_STATE_FILE "/var/lib/powerkitd/state"
+#define DAEMON_BOOT_ID "/proc/sys/kernel/random/boot_id"
+#define DAEMON_UPTIME "/proc/uptime"
+#define DAEMON_RESTORE_UPTIME 300 // s after boot, later activations don't restore
+
+// state that must survive an idle exit
+class DaemonState
+{
+public:
+    explicit DaemonState(const QString &file = DAEMON_STATE_FILE);
+    static double uptime();
+    QString fileName();
+    bool load();
+    bool save();
+    bool isDirty();
+    bool isNewBoot();
+    void setWakeEntries(const QStringList &entries);
+    QStringList wakeEntries();
+    void setBacklight(const QString &device, int value);
+    QMap<QString, int> backlight();
+
+private:
+    QString _file;
+    bool _dirty;
+    QString _boot;
+    bool _newBoot;
+    QStringList _wake;
+    QMap<QString, int> _backlight;
+};
+
+#endif // STATE_H
@@ -0,0 +1,93 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "workqueue.h"
+
+#include <QDebug>
+
+WorkJob::WorkJob(const QString &key, WorkBatch *batch)
+    : _key(key)
+    , _batch(batch)
+    , _queue(0)
+{
+    setAutoDelete(false); // owned by the queue
+}
+
+WorkJob::~WorkJob()
+{
+}
+
+QString WorkJob::key()
+{
+    return _key;
+}
+
+// runs on the pool
+void WorkJob::run()
+{
+    bool result = work();
+    if (_batch) {
+        if (!result) { _batch->failed.fetchAndAddOrdered(1); }
+        if (_batch->remaining.fetchAndAddOrdered(-1) == 1) {
+            bool ok = _batch->failed.fetchAndAddOrdered(0) == 0;
+            if (_batch->message.type() == QDBusMessage::MethodCallMessage) {
+                _batch->connection.send(_batch->message.createReply(ok));
+            }
+            delete _batch;
+        }
+    }
+    QMetaObject::invokeMethod(_queue,
+                              "handleFinished",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, _key));
+}
+
+WorkQueue::WorkQueue(QObject *parent)
+    : QObject(parent)
+{
+    pool.setMaxThreadCount(WORK_THREADS);
+}
+
+WorkQueue::~WorkQueue()
+{
+    pool.waitForDone();
+    QMapIterator<QString, QQueue<WorkJob*> > i(queues);
+    while (i.hasNext()) {
+        i.next();
+        qDeleteAll(i.value());
+    }
+}
+
+void WorkQueue::enqueue(WorkJob *job)
+{
+    job->_queue = this;
+    queues[job->key()].enqueue(job);
+    if (running.contains(job->key())) { return; }
+    running.insert(job->key());
+    pool.start(queues[job->key()].head());
+}
+
+bool WorkQueue::isIdle()
+{
+    return running.isEmpty();
+}
+
+// start next job for key (in the main thread)
+void WorkQueue::handleFinished(const QString &key)
+{
+    if (!queues.contains(key)) { return; }
+    QQueue<WorkJob*> &queue = queues[key];
+    if (!queue.isEmpty()) { delete queue.dequeue(); }
+    if (queue.isEmpty()) {
+        queues.remove(key);
+        running.remove(key);
+        if (running.isEmpty()) { emit idle(); }
+        return;
+    }
+    pool.start(queue.head());
+}
@@ -0,0 +1,84 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef WORKQUEUE_H
+#define WORKQUEUE_H
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QQueue>
+#include <QSet>
+#include <QRunnable>
+#include <QThreadPool>
+#include <QAtomicInt>
+#include <QDBusConnection>
+#include <QDBusMessage>
+
+#define WORK_THREADS 2
+
+class WorkQueue;
+
+// replies once all jobs in the batch are done
+struct WorkBatch
+{
+    WorkBatch(const QDBusConnection &bus,
+              const QDBusMessage &request,
+              int count)
+        : connection(bus)
+        , message(request)
+        , remaining(count)
+        , failed(0) {}
+    QDBusConnection connection;
+    QDBusMessage message;
+    QAtomicInt remaining;
+    QAtomicInt failed;
+};
+
+// job for the worker pool, jobs with the same key run in order
+class WorkJob : public QRunnable
+{
+public:
+    WorkJob(const QString &key, WorkBatch *batch = NULL);
+    virtual ~WorkJob();
+    QString key();
+    void run();
+
+protected:
+    virtual bool work() = 0;
+
+private:
+    QString _key;
+    WorkBatch *_batch;
+    WorkQueue *_queue;
+    friend class WorkQueue;
+};
+
+class WorkQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit WorkQueue(QObject *parent = NULL);
+    ~WorkQueue();
+    void enqueue(WorkJob *job);
+    bool isIdle();
+
+private:
+    QThreadPool pool;
+    QMap<QString, QQueue<WorkJob*> > queues;
+    QSet<QString> running;
+
+signals:
+    void idle();
+
+private slots:
+    void handleFinished(const QString &key);
+};
+
+#endif // WORKQUEUE_H
@@ -0,0 +1,187 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "backlight.h"
+#include "sysfsattribute.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QStringList>
+#include <QDebug>
+#include <algorithm>
+
+#ifndef __FreeBSD__
+#include <sys/socket.h>
+#include <linux/netlink.h>
+#include <unistd.h>
+#include <string.h>
+#endif
+
+#define UEVENT_BUFFER_SIZE 4096
+
+static QList<BacklightDevice> registry;
+static bool registryValid = false;
+
+static int typeRank(const QString &type)
+{
+    if (type == "firmware") { return 0; }
+    if (type == "platform") { return 1; }
+    if (type == "raw") { return 2; }
+    return 3;
+}
+
+static bool rankLessThan(const BacklightDevice &a, const BacklightDevice &b)
+{
+    if (a.rank != b.rank) { return a.rank<b.rank; }
+    return a.name<b.name;
+}
+
+// enumerate once, until invalidated
+static const QList<BacklightDevice> &registryCurrent()
+{
+    if (registryValid) { return registry; }
+    registry.clear();
+    registryValid = true;
+#ifndef __FreeBSD__
+    QDir dir(SysfsAttribute::path(BACKLIGHT_PATH));
+    QStringList entries = dir.entryList(QDir::Dirs|QDir::NoDotAndDotDot, QDir::Name);
+    foreach (QString entry, entries) {
+        BacklightDevice device;
+        device.name = entry;
+        device.path = QString("%1/%2").arg(BACKLIGHT_PATH).arg(entry);
+        device.type = SysfsAttribute::readString(QString("%1/type").arg(device.path));
+        device.rank = typeRank(device.type);
+        device.max = SysfsAttribute::readInt(QString("%1/max_brightness").arg(device.path));
+        device.writable = QFileInfo(SysfsAttribute::path(QString("%1/brightness")
+                                                         .arg(device.path))).isWritable();
+        if (device.max<1) { continue; }
+        registry << device;
+    }
+    std::sort(registry.begin(), registry.end(), rankLessThan);
+    foreach (BacklightDevice device, registry) {
+        qDebug() << "backlight" << device.name << device.type << device.max << device.writable;
+    }
+#endif
+    return registry;
+}
+
+Backlight::Backlight(QObject *parent)
+    : QObject(parent)
+    , fd(-1)
+    , notifier(0)
+{
+#ifndef __FreeBSD__
+    fd = socket(AF_NETLINK, SOCK_DGRAM|SOCK_CLOEXEC|SOCK_NONBLOCK, NETLINK_KOBJECT_UEVENT);
+    if (fd<0) {
+        qWarning() << "failed to open uevent socket";
+        return;
+    }
+    struct sockaddr_nl addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.nl_family = AF_NETLINK;
+    addr.nl_groups = 1; // kernel events
+    if (bind(fd, (struct sockaddr*)&addr, sizeof(addr))<0) {
+        qWarning() << "failed to bind uevent socket";
+        close(fd);
+        fd = -1;
+        return;
+    }
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(handleUevent()));
+#endif
+}
+
+Backlight::~Backlight()
+{
+#ifndef __FreeBSD__
+    if (fd>=0) { close(fd); }
+#endif
+}
+
+QList<BacklightDevice> Backlight::devices()
+{
+    return registryCurrent();
+}
+
+// named device (name or path), else the best ranked
+BacklightDevice Backlight::device(const QString &name)
+{
+    const QList<BacklightDevice> &list = registryCurrent();
+    if (list.isEmpty()) { return BacklightDevice(); }
+    if (!name.isEmpty()) {
+        for (int i=0;i<list.size();++i) {
+            if (list.at(i).name == name || list.at(i).path == name) { return list.at(i); }
+        }
+    }
+    return list.at(0);
+}
+
+bool Backlight::contains(const QString &path)
+{
+    const QList<BacklightDevice> &list = registryCurrent();
+    for (int i=0;i<list.size();++i) {
+        if (list.at(i).path == path) { return true; }
+    }
+    return false;
+}
+
+int Backlight::max(const QString &path)
+{
+    const QList<BacklightDevice> &list = registryCurrent();
+    for (int i=0;i<list.size();++i) {
+        if (list.at(i).path == path) { return list.at(i).max; }
+    }
+    return 0;
+}
+
+bool Backlight::writable(const QString &path)
+{
+    const QList<BacklightDevice> &list = registryCurrent();
+    for (int i=0;i<list.size();++i) {
+        if (list.at(i).path == path) { return list.at(i).writable; }
+    }
+    return false;
+}
+
+void Backlight::invalidate()
+{
+    registryValid = false;
+}
+
+// "action@devpath\0KEY=VALUE\0..."
+void Backlight::handleUevent()
+{
+#ifndef __FreeBSD__
+    char buffer[UEVENT_BUFFER_SIZE];
+    ssize_t length;
+    while ((length = recv(fd, buffer, sizeof(buffer)-1, 0))>0) {
+        buffer[length] = '\0';
+        QString action;
+        QString devpath;
+        bool isBacklight = false;
+        ssize_t pos = 0;
+        while (pos<length) {
+            QString line = QString::fromLatin1(buffer+pos);
+            pos += strlen(buffer+pos)+1;
+            if (line.startsWith("ACTION=")) { action = line.mid(7); }
+            else if (line.startsWith("DEVPATH=")) { devpath = line.mid(8); }
+            else if (line == "SUBSYSTEM=backlight") { isBacklight = true; }
+        }
+        if (!isBacklight) { continue; }
+        QString path = QString("%1/%2").arg(BACKLIGHT_PATH).arg(devpath.section('/', -1));
+        qDebug() << "backlight uevent" << action << path;
+        if (action == "change") {
+            emit brightnessChanged(path);
+            continue;
+        }
+        invalidate();
+        emit devicesChanged();
+    }
+#endif
+}
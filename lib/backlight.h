@@ -0,0 +1,62 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BACKLIGHT_H
+#define BACKLIGHT_H
+
+#include <QObject>
+#include <QString>
+#include <QList>
+#include <QSocketNotifier>
+
+#define BACKLIGHT_PATH "/sys/class/backlight"
+
+struct BacklightDevice
+{
+    BacklightDevice()
+        : rank(0)
+        , max(0)
+        , writable(false) {}
+    QString path;
+    QString name;
+    QString type;
+    int rank;
+    int max;
+    bool writable;
+};
+
+// backlight registry, devices are enumerated once and ranked
+// by kernel type (firmware, platform, raw). An instance listens
+// for kernel uevents and keeps the registry current.
+class Backlight : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Backlight(QObject *parent = NULL);
+    ~Backlight();
+    static QList<BacklightDevice> devices();
+    static BacklightDevice device(const QString &name = QString());
+    static bool contains(const QString &path);
+    static int max(const QString &path);
+    static bool writable(const QString &path);
+    static void invalidate();
+
+private:
+    int fd;
+    QSocketNotifier *notifier;
+
+signals:
+    void devicesChanged();
+    void brightnessChanged(const QString &path);
+
+private slots:
+    void handleUevent();
+};
+
+#endif // BACKLIGHT_H
@@ -0,0 +1,204 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "backlighttransition.h"
+#include "common.h"
+
+#include <QDebug>
+#include <math.h>
+
+// luminance for evenly spaced lightness (CIE 1976 L*)
+static double curve[BACKLIGHT_LUT_SIZE];
+static bool curveValid = false;
+
+static void buildCurve()
+{
+    if (curveValid) { return; }
+    for (int i=0;i<BACKLIGHT_LUT_SIZE;++i) {
+        double lightness = 100.0*i/(BACKLIGHT_LUT_SIZE-1);
+        if (lightness>8.0) { curve[i] = pow((lightness+16.0)/116.0, 3.0); }
+        else { curve[i] = lightness/903.3; }
+    }
+    curveValid = true;
+}
+
+BacklightRamp::BacklightRamp(QObject *parent)
+    : QObject(parent)
+    , active(0)
+    , pending(-1)
+    , attribute(0)
+    , max(0)
+    , current(0)
+    , target(0)
+    , startLevel(0)
+    , endLevel(0)
+    , steps(0)
+    , timer(0)
+{
+    timer = new QTimer(this);
+    timer->setInterval(BACKLIGHT_STEP_INTERVAL);
+    connect(timer, SIGNAL(timeout()),
+            this, SLOT(step()));
+}
+
+void BacklightRamp::writeValue(int value)
+{
+    if (!attribute || !attribute->write(value)) { return; }
+    current = value;
+}
+
+void BacklightRamp::openDevice(const QString &device, int maxValue)
+{
+    timer->stop();
+    active.fetchAndStoreOrdered(0);
+    if (attribute) { delete attribute; }
+    attribute = new SysfsAttribute(QString("%1/brightness").arg(device), this);
+    if (!attribute->isWritable()) { qWarning() << "failed to open brightness" << device; }
+    max = maxValue;
+    current = attribute->toInt();
+    target = current;
+    emit finished(current);
+}
+
+// start (or restart) ramp from current value to latest target
+void BacklightRamp::applyPending()
+{
+    int value = pending.fetchAndStoreOrdered(-1);
+    if (value<0 || !attribute || !attribute->isWritable() || max<1) { return; }
+    value = qBound(1, value, max);
+    if (value == target && (timer->isActive() || value == current)) { return; }
+    target = value;
+    startLevel = BacklightTransition::level(current, max);
+    endLevel = BacklightTransition::level(target, max);
+    steps = 0;
+    active.fetchAndStoreOrdered(1);
+    if (!timer->isActive()) { timer->start(); }
+}
+
+void BacklightRamp::sync()
+{
+    if (timer->isActive() || pending.fetchAndAddOrdered(0) != -1) { return; }
+    if (!attribute) { return; }
+    current = attribute->toInt();
+    target = current;
+    emit finished(current);
+}
+
+void BacklightRamp::step()
+{
+    ++steps;
+    int value = target;
+    if (steps<BACKLIGHT_RAMP_STEPS) {
+        value = BacklightTransition::fromLevel(startLevel+(endLevel-startLevel)*steps/BACKLIGHT_RAMP_STEPS,
+                                               max);
+    }
+    if (value != current) { writeValue(value); }
+    if (steps<BACKLIGHT_RAMP_STEPS) { return; }
+    timer->stop();
+    active.fetchAndStoreOrdered(0);
+    emit finished(current);
+}
+
+BacklightTransition::BacklightTransition(QObject *parent)
+    : QObject(parent)
+    , ramp(0)
+    , target(0)
+    , max(0)
+{
+    buildCurve();
+    ramp = new BacklightRamp();
+    ramp->moveToThread(&thread);
+    connect(&thread, SIGNAL(finished()),
+            ramp, SLOT(deleteLater()));
+    connect(ramp, SIGNAL(finished(int)),
+            this, SLOT(handleRampFinished(int)));
+    thread.start();
+}
+
+BacklightTransition::~BacklightTransition()
+{
+    thread.quit();
+    thread.wait();
+}
+
+bool BacklightTransition::isActive()
+{
+    return ramp->active.fetchAndAddOrdered(0) != 0 ||
+           ramp->pending.fetchAndAddOrdered(0) != -1;
+}
+
+// last requested (or known) value
+int BacklightTransition::value()
+{
+    return target;
+}
+
+// raw value to perceptual level (0-1)
+double BacklightTransition::level(int value, int max)
+{
+    if (max<1 || value<=0) { return 0; }
+    if (value>=max) { return 1; }
+    double luminance = (double)value/max;
+    int low = 0;
+    int high = BACKLIGHT_LUT_SIZE-1;
+    while (high-low>1) {
+        int mid = (low+high)/2;
+        if (curve[mid]<=luminance) { low = mid; }
+        else { high = mid; }
+    }
+    double span = curve[high]-curve[low];
+    double frac = span>0?(luminance-curve[low])/span:0;
+    return (low+frac)/(BACKLIGHT_LUT_SIZE-1);
+}
+
+// perceptual level (0-1) to raw value
+int BacklightTransition::fromLevel(double level, int max)
+{
+    if (max<1) { return 0; }
+    double pos = qBound(0.0, level, 1.0)*(BACKLIGHT_LUT_SIZE-1);
+    int index = qMin((int)pos, BACKLIGHT_LUT_SIZE-2);
+    double luminance = curve[index]+(curve[index+1]-curve[index])*(pos-index);
+    return qBound(1, (int)(luminance*max+0.5), max);
+}
+
+void BacklightTransition::setDevice(const QString &device)
+{
+    max = Common::backlightMax(device);
+    target = Common::backlightValue(device);
+    QMetaObject::invokeMethod(ramp,
+                              "openDevice",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, device),
+                              Q_ARG(int, max));
+}
+
+// bursts are collapsed, only the latest target is used
+void BacklightTransition::setValue(int value)
+{
+    if (max<1) { return; }
+    target = qBound(1, value, max);
+    if (ramp->pending.fetchAndStoreOrdered(target) != -1) { return; }
+    QMetaObject::invokeMethod(ramp, "applyPending", Qt::QueuedConnection);
+}
+
+void BacklightTransition::adjust(int delta)
+{
+    setValue(target+delta);
+}
+
+// re-read after external change (ignored while changing)
+void BacklightTransition::sync()
+{
+    QMetaObject::invokeMethod(ramp, "sync", Qt::QueuedConnection);
+}
+
+void BacklightTransition::handleRampFinished(int value)
+{
+    if (!isActive()) { target = value; }
+    emit valueChanged(value);
+}
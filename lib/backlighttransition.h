@@ -0,0 +1,91 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BACKLIGHTTRANSITION_H
+#define BACKLIGHTTRANSITION_H
+
+#include <QObject>
+#include <QString>
+#include <QThread>
+#include <QTimer>
+#include <QAtomicInt>
+
+#include "sysfsattribute.h"
+
+#define BACKLIGHT_STEP_INTERVAL 16 // ms between steps (~60 Hz)
+#define BACKLIGHT_RAMP_STEPS 15 // steps per transition
+#define BACKLIGHT_LUT_SIZE 256 // perceptual curve resolution
+
+// worker, writes brightness through one open attribute
+class BacklightRamp : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BacklightRamp(QObject *parent = NULL);
+    QAtomicInt active;
+    QAtomicInt pending; // latest requested target, -1 if none
+
+private:
+    SysfsAttribute *attribute;
+    int max;
+    int current;
+    int target;
+    double startLevel;
+    double endLevel;
+    int steps;
+    QTimer *timer;
+
+    void writeValue(int value);
+
+signals:
+    void finished(int value);
+
+public slots:
+    void openDevice(const QString &device, int maxValue);
+    void applyPending();
+    void sync();
+
+private slots:
+    void step();
+};
+
+// smooth brightness changes along a perceptual curve,
+// a new target replaces the one in progress
+class BacklightTransition : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit BacklightTransition(QObject *parent = NULL);
+    ~BacklightTransition();
+    bool isActive();
+    int value();
+    static double level(int value, int max);
+    static int fromLevel(double level, int max);
+
+private:
+    QThread thread;
+    BacklightRamp *ramp;
+    int target;
+    int max;
+
+signals:
+    void valueChanged(int value);
+
+public slots:
+    void setDevice(const QString &device);
+    void setValue(int value);
+    void adjust(int delta);
+    void sync();
+
+private slots:
+    void handleRampFinished(int value);
+};
+
+#endif // BACKLIGHTTRANSITION_H
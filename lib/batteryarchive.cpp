@@ -0,0 +1,562 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "batteryarchive.h"
+#include "common.h"
+
+#include <QDateTime>
+#include <QDebug>
+
+#include <string.h>
+#include <sys/file.h>
+
+// LEB128
+static void putVarint(QByteArray *out, quint64 value)
+{
+    while (value >= 0x80) {
+        out->append((char)((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->append((char)value);
+}
+
+static bool getVarint(const QByteArray &data, int *pos, quint64 *value)
+{
+    *value = 0;
+    for (int shift=0;shift<64;shift+=7) {
+        if (*pos >= data.size()) { return false; }
+        quint8 byte = (quint8)data.at((*pos)++);
+        *value |= (quint64)(byte & 0x7f) << shift;
+        if (!(byte & 0x80)) { return true; }
+    }
+    return false;
+}
+
+static quint64 zigzag(qint64 value)
+{
+    return ((quint64)value << 1) ^ (quint64)(value >> 63);
+}
+
+static qint64 unzigzag(quint64 value)
+{
+    return (qint64)(value >> 1) ^ -(qint64)(value & 1);
+}
+
+// feeds archived samples back into the rollups
+class RollupRestore : public BatteryArchiveVisitor
+{
+public:
+    RollupRestore(BatteryArchive *archive) : _archive(archive) {}
+    bool sample(const BatterySample &sample)
+    {
+        _archive->addRollups(sample);
+        return true;
+    }
+private:
+    BatteryArchive *_archive;
+};
+
+// writes csv or json as it reads
+class HistoryExporter : public BatteryArchiveVisitor
+{
+public:
+    HistoryExporter(QTextStream &out,
+                    BatteryArchive::ExportFormat format,
+                    BatteryArchive::Resolution resolution)
+        : _out(out)
+        , _format(format)
+        , _resolution(resolution)
+        , _rows(0) {}
+    void begin()
+    {
+        if (_format == BatteryArchive::ExportJSON) {
+            _out << "[";
+            return;
+        }
+        if (_resolution == BatteryArchive::ResolutionSamples) {
+            _out << "time,energy_wh,power_w,percentage,state\n";
+        } else {
+            _out << "start,count,energy_min_wh,energy_max_wh,energy_mean_wh,"
+                    "power_min_w,power_max_w,power_mean_w,"
+                    "percentage_min,percentage_max,percentage_mean,state\n";
+        }
+    }
+    void end()
+    {
+        if (_format == BatteryArchive::ExportJSON) { _out << (_rows?"\n]\n":"]\n"); }
+        _out.flush();
+    }
+    bool sample(const BatterySample &sample)
+    {
+        QString time = date(sample.time);
+        if (_format == BatteryArchive::ExportJSON) {
+            _out << (_rows?",\n":"\n")
+                 << "{\"time\":\"" << time
+                 << "\",\"energy_wh\":" << sample.energy/1000.0
+                 << ",\"power_w\":" << sample.power/1000.0
+                 << ",\"percentage\":" << sample.percentage/100.0
+                 << ",\"state\":" << sample.state << "}";
+        } else {
+            _out << time << ","
+                 << sample.energy/1000.0 << ","
+                 << sample.power/1000.0 << ","
+                 << sample.percentage/100.0 << ","
+                 << sample.state << "\n";
+        }
+        _rows++;
+        return _out.status() == QTextStream::Ok;
+    }
+    bool rollup(const BatteryRollup &rollup)
+    {
+        QString start = date(rollup.start);
+        if (_format == BatteryArchive::ExportJSON) {
+            _out << (_rows?",\n":"\n")
+                 << "{\"start\":\"" << start
+                 << "\",\"count\":" << rollup.count
+                 << ",\"energy_min_wh\":" << rollup.energyMin/1000.0
+                 << ",\"energy_max_wh\":" << rollup.energyMax/1000.0
+                 << ",\"energy_mean_wh\":" << rollup.energyMean/1000.0
+                 << ",\"power_min_w\":" << rollup.powerMin/1000.0
+                 << ",\"power_max_w\":" << rollup.powerMax/1000.0
+                 << ",\"power_mean_w\":" << rollup.powerMean/1000.0
+                 << ",\"percentage_min\":" << rollup.percentageMin/100.0
+                 << ",\"percentage_max\":" << rollup.percentageMax/100.0
+                 << ",\"percentage_mean\":" << rollup.percentageMean/100.0
+                 << ",\"state\":" << rollup.state << "}";
+        } else {
+            _out << start << ","
+                 << rollup.count << ","
+                 << rollup.energyMin/1000.0 << ","
+                 << rollup.energyMax/1000.0 << ","
+                 << rollup.energyMean/1000.0 << ","
+                 << rollup.powerMin/1000.0 << ","
+                 << rollup.powerMax/1000.0 << ","
+                 << rollup.powerMean/1000.0 << ","
+                 << rollup.percentageMin/100.0 << ","
+                 << rollup.percentageMax/100.0 << ","
+                 << rollup.percentageMean/100.0 << ","
+                 << rollup.state << "\n";
+        }
+        _rows++;
+        return _out.status() == QTextStream::Ok;
+    }
+private:
+    QTextStream &_out;
+    BatteryArchive::ExportFormat _format;
+    BatteryArchive::Resolution _resolution;
+    int _rows;
+    static QString date(quint32 time)
+    {
+        return QDateTime::fromTime_t(time).toUTC().toString(Qt::ISODate);
+    }
+};
+
+BatteryArchive::Accumulator::Accumulator(quint32 length)
+    : period(length)
+    , resume(0)
+    , energySum(0)
+    , powerSum(0)
+    , percentageSum(0)
+{
+    memset(&current, 0, sizeof(current));
+}
+
+// true (and done set) when a period was completed
+bool BatteryArchive::Accumulator::add(const BatterySample &sample, BatteryRollup *done)
+{
+    if (sample.time<resume) { return false; }
+    quint32 start = sample.time-sample.time%period;
+    bool result = false;
+    if (current.count>0 && start != current.start) { result = take(done); }
+    if (current.count == 0) {
+        current.start = start;
+        current.energyMin = current.energyMax = sample.energy;
+        current.powerMin = current.powerMax = sample.power;
+        current.percentageMin = current.percentageMax = sample.percentage;
+        current.state = 0;
+    }
+    current.count++;
+    current.energyMin = qMin(current.energyMin, sample.energy);
+    current.energyMax = qMax(current.energyMax, sample.energy);
+    current.powerMin = qMin(current.powerMin, sample.power);
+    current.powerMax = qMax(current.powerMax, sample.power);
+    current.percentageMin = qMin(current.percentageMin, sample.percentage);
+    current.percentageMax = qMax(current.percentageMax, sample.percentage);
+    current.state |= sample.state;
+    energySum += sample.energy;
+    powerSum += sample.power;
+    percentageSum += sample.percentage;
+    return result;
+}
+
+bool BatteryArchive::Accumulator::take(BatteryRollup *done)
+{
+    if (current.count == 0) { return false; }
+    current.energyMean = (quint32)(energySum/current.count);
+    current.powerMean = (qint32)(powerSum/current.count);
+    current.percentageMean = (quint16)(percentageSum/current.count);
+    if (done) { *done = current; }
+    resume = current.start+period;
+    current.count = 0;
+    energySum = 0;
+    powerSum = 0;
+    percentageSum = 0;
+    return true;
+}
+
+BatteryArchive::BatteryArchive(const QString &dir, bool readOnly)
+    : _readOnly(readOnly)
+    , hours(BATTERY_ARCHIVE_HOUR)
+    , days(BATTERY_ARCHIVE_DAY)
+{
+    if (!openFiles(dir.isEmpty()?Common::cacheDir():dir)) { return; }
+    loadIndex();
+    if (!_readOnly) { restoreRollups(); }
+}
+
+BatteryArchive::~BatteryArchive()
+{
+}
+
+bool BatteryArchive::isValid()
+{
+    return archive.isOpen() && index.isOpen();
+}
+
+bool BatteryArchive::isReadOnly()
+{
+    return _readOnly;
+}
+
+quint32 BatteryArchive::lastTime()
+{
+    if (entries.isEmpty()) { return 0; }
+    return entries.last().last;
+}
+
+int BatteryArchive::blocks()
+{
+    return entries.size();
+}
+
+bool BatteryArchive::openFiles(const QString &dir)
+{
+    archive.setFileName(QString("%1/%2").arg(dir).arg(BATTERY_ARCHIVE_FILE));
+    index.setFileName(QString("%1/%2").arg(dir).arg(BATTERY_ARCHIVE_INDEX));
+    hourly.setFileName(QString("%1/%2").arg(dir).arg(BATTERY_ARCHIVE_HOURLY));
+    daily.setFileName(QString("%1/%2").arg(dir).arg(BATTERY_ARCHIVE_DAILY));
+    QIODevice::OpenMode mode = _readOnly?QIODevice::ReadOnly:QIODevice::ReadWrite;
+    if (!archive.open(mode)) { return false; }
+    // one writer, a second sync() would append the same blocks again
+    if (!_readOnly && flock(archive.handle(), LOCK_EX|LOCK_NB) != 0) {
+        qDebug() << "battery archive is in use, open read only" << archive.fileName();
+        archive.close();
+        _readOnly = true;
+        mode = QIODevice::ReadOnly;
+        if (!archive.open(mode)) { return false; }
+    }
+    if (!index.open(mode)) {
+        archive.close();
+        return false;
+    }
+    hourly.open(mode);
+    daily.open(mode);
+    return true;
+}
+
+// load block index, drop blocks that were not completely written
+bool BatteryArchive::loadIndex()
+{
+    entries.clear();
+    int count = (int)(index.size()/sizeof(IndexEntry));
+    entries.resize(count);
+    index.seek(0);
+    if (count>0 &&
+        index.read((char*)entries.data(), count*sizeof(IndexEntry)) != (qint64)(count*sizeof(IndexEntry))) {
+        entries.clear();
+    }
+    qint64 size = archive.size();
+    qint64 end = 0;
+    while (!entries.isEmpty()) {
+        const IndexEntry &entry = entries.last();
+        BlockHeader header;
+        if (entry.offset+sizeof(BlockHeader) <= (quint64)size &&
+            archive.seek(entry.offset) &&
+            archive.read((char*)&header, sizeof(header)) == (qint64)sizeof(header) &&
+            header.magic == BATTERY_ARCHIVE_MAGIC &&
+            entry.offset+sizeof(BlockHeader)+header.size <= (quint64)size)
+        {
+            end = entry.offset+sizeof(BlockHeader)+header.size;
+            break;
+        }
+        qWarning() << "drop incomplete battery archive block" << entry.offset;
+        entries.remove(entries.size()-1);
+    }
+    if (!_readOnly) {
+        index.resize(entries.size()*sizeof(IndexEntry));
+        archive.resize(end);
+    }
+    return true;
+}
+
+// rollups from the archived samples not yet in a rollup
+void BatteryArchive::restoreRollups()
+{
+    Accumulator *accumulators[2] = { &hours, &days };
+    QFile *files[2] = { &hourly, &daily };
+    for (int i=0;i<2;++i) {
+        if (!files[i]->isOpen()) { continue; }
+        qint64 size = files[i]->size();
+        size -= size%sizeof(BatteryRollup);
+        files[i]->resize(size);
+        if (size<(qint64)sizeof(BatteryRollup)) { continue; }
+        BatteryRollup last;
+        files[i]->seek(size-sizeof(BatteryRollup));
+        if (files[i]->read((char*)&last, sizeof(last)) == (qint64)sizeof(last)) {
+            accumulators[i]->resume = last.start+accumulators[i]->period;
+        }
+    }
+    RollupRestore restore(this);
+    read(qMin(hours.resume, days.resume), 0xffffffff, &restore);
+}
+
+void BatteryArchive::addRollups(const BatterySample &sample)
+{
+    BatteryRollup done;
+    if (hours.add(sample, &done) && hourly.isOpen()) {
+        hourly.seek(hourly.size());
+        hourly.write((const char*)&done, sizeof(done));
+        hourly.flush();
+    }
+    if (days.add(sample, &done) && daily.isOpen()) {
+        daily.seek(daily.size());
+        daily.write((const char*)&done, sizeof(done));
+        daily.flush();
+    }
+}
+
+// append samples newer than the archive as one block
+bool BatteryArchive::sync(BatteryHistory *history)
+{
+    if (_readOnly || !isValid() || !history || !history->isValid()) { return false; }
+    QVector<BatterySample> samples = history->samples();
+    QVector<BatterySample> fresh;
+    quint32 last = lastTime();
+    for (int i=0;i<samples.size();++i) {
+        if (samples.at(i).time>last) { fresh.append(samples.at(i)); }
+    }
+    if (fresh.isEmpty()) { return true; }
+
+    QByteArray payload = encode(fresh);
+    BlockHeader header;
+    memset(&header, 0, sizeof(header));
+    header.magic = BATTERY_ARCHIVE_MAGIC;
+    header.count = fresh.size();
+    header.first = fresh.first().time;
+    header.last = fresh.last().time;
+    header.size = payload.size();
+    header.checksum = qChecksum(payload.constData(), payload.size());
+
+    IndexEntry entry;
+    entry.first = header.first;
+    entry.last = header.last;
+    entry.offset = archive.size();
+    if (!archive.seek(entry.offset) ||
+        archive.write((const char*)&header, sizeof(header)) != (qint64)sizeof(header) ||
+        archive.write(payload) != payload.size() ||
+        !archive.flush()) {
+        qWarning() << "failed to write battery archive";
+        archive.resize(entry.offset);
+        return false;
+    }
+    // the block is only used once indexed
+    index.seek(index.size());
+    if (index.write((const char*)&entry, sizeof(entry)) != (qint64)sizeof(entry) ||
+        !index.flush()) {
+        qWarning() << "failed to write battery archive index";
+        return false;
+    }
+    entries.append(entry);
+    for (int i=0;i<fresh.size();++i) { addRollups(fresh.at(i)); }
+    qDebug() << "archived battery samples" << fresh.size() << payload.size() << "bytes";
+    return true;
+}
+
+// samples in [from, to], blocks found by binary search
+bool BatteryArchive::read(quint32 from, quint32 to, BatteryArchiveVisitor *visitor)
+{
+    if (!isValid() || !visitor) { return false; }
+    int low = 0;
+    int high = entries.size();
+    while (low<high) { // first block ending at or after from
+        int middle = (low+high)/2;
+        if (entries.at(middle).last<from) { low = middle+1; }
+        else { high = middle; }
+    }
+    bool stop = false;
+    for (int i=low;i<entries.size() && !stop;++i) {
+        if (entries.at(i).first>to) { break; }
+        if (!readBlock(entries.at(i), from, to, visitor, &stop)) { return false; }
+    }
+    return true;
+}
+
+bool BatteryArchive::readBlock(const IndexEntry &entry,
+                               quint32 from,
+                               quint32 to,
+                               BatteryArchiveVisitor *visitor,
+                               bool *stop)
+{
+    BlockHeader header;
+    if (!archive.seek(entry.offset) ||
+        archive.read((char*)&header, sizeof(header)) != (qint64)sizeof(header) ||
+        header.magic != BATTERY_ARCHIVE_MAGIC) { return false; }
+    QByteArray payload = archive.read(header.size);
+    if (payload.size() != (int)header.size ||
+        qChecksum(payload.constData(), payload.size()) != header.checksum) {
+        qWarning() << "corrupt battery archive block" << entry.offset;
+        return true; // skip
+    }
+    QVector<BatterySample> samples;
+    if (!decode(payload, header.count, &samples)) { return true; }
+    for (int i=0;i<samples.size();++i) {
+        if (samples.at(i).time<from) { continue; }
+        if (samples.at(i).time>to) {
+            *stop = true;
+            break;
+        }
+        if (!visitor->sample(samples.at(i))) {
+            *stop = true;
+            break;
+        }
+    }
+    return true;
+}
+
+// fixed size records, binary search for the first
+bool BatteryArchive::readRollups(Resolution resolution,
+                                 quint32 from,
+                                 quint32 to,
+                                 BatteryArchiveVisitor *visitor)
+{
+    QFile *file = resolution == ResolutionDaily?&daily:&hourly;
+    if (!file->isOpen() || !visitor) { return false; }
+    qint64 count = file->size()/sizeof(BatteryRollup);
+    qint64 low = 0;
+    qint64 high = count;
+    BatteryRollup rollup;
+    while (low<high) {
+        qint64 middle = (low+high)/2;
+        if (!file->seek(middle*sizeof(BatteryRollup)) ||
+            file->read((char*)&rollup, sizeof(rollup)) != (qint64)sizeof(rollup)) { return false; }
+        if (rollup.start<from) { low = middle+1; }
+        else { high = middle; }
+    }
+    if (!file->seek(low*sizeof(BatteryRollup))) { return false; }
+    for (qint64 i=low;i<count;++i) {
+        if (file->read((char*)&rollup, sizeof(rollup)) != (qint64)sizeof(rollup)) { return false; }
+        if (rollup.start>to) { break; }
+        if (!visitor->rollup(rollup)) { break; }
+    }
+    return true;
+}
+
+// first sample as is, then time as delta-of-delta and
+// values as deltas, zigzag varints (mostly one byte each)
+QByteArray BatteryArchive::encode(const QVector<BatterySample> &samples)
+{
+    QByteArray out;
+    out.reserve(samples.size()*6);
+    qint64 time = 0, delta = 0, energy = 0, power = 0, percentage = 0;
+    for (int i=0;i<samples.size();++i) {
+        const BatterySample &sample = samples.at(i);
+        if (i == 0) {
+            putVarint(&out, sample.time);
+            putVarint(&out, sample.energy);
+            putVarint(&out, zigzag(sample.power));
+            putVarint(&out, sample.percentage);
+        } else {
+            qint64 current = (qint64)sample.time-time;
+            putVarint(&out, zigzag(current-delta));
+            putVarint(&out, zigzag((qint64)sample.energy-energy));
+            putVarint(&out, zigzag((qint64)sample.power-power));
+            putVarint(&out, zigzag((qint64)sample.percentage-percentage));
+            delta = current;
+        }
+        putVarint(&out, sample.state);
+        time = sample.time;
+        energy = sample.energy;
+        power = sample.power;
+        percentage = sample.percentage;
+    }
+    return out;
+}
+
+bool BatteryArchive::decode(const QByteArray &data,
+                            quint32 count,
+                            QVector<BatterySample> *samples)
+{
+    samples->clear();
+    samples->reserve(count);
+    int pos = 0;
+    qint64 time = 0, delta = 0, energy = 0, power = 0, percentage = 0;
+    for (quint32 i=0;i<count;++i) {
+        quint64 values[5];
+        for (int v=0;v<5;++v) {
+            if (!getVarint(data, &pos, &values[v])) { return false; }
+        }
+        if (i == 0) {
+            time = values[0];
+            energy = values[1];
+            power = unzigzag(values[2]);
+            percentage = values[3];
+        } else {
+            delta += unzigzag(values[0]);
+            time += delta;
+            energy += unzigzag(values[1]);
+            power += unzigzag(values[2]);
+            percentage += unzigzag(values[3]);
+        }
+        BatterySample sample;
+        sample.time = (quint32)time;
+        sample.energy = (quint32)energy;
+        sample.power = (qint32)power;
+        sample.percentage = (quint16)percentage;
+        sample.state = (quint16)values[4];
+        samples->append(sample);
+    }
+    return true;
+}
+
+// stream archive (and newer live samples) to out
+bool BatteryArchive::exportHistory(QTextStream &out,
+                                   ExportFormat format,
+                                   Resolution resolution,
+                                   quint32 from,
+                                   quint32 to)
+{
+    BatteryArchive archive(QString(), true);
+    HistoryExporter exporter(out, format, resolution);
+    exporter.begin();
+    bool result = true;
+    if (resolution == ResolutionSamples) {
+        if (archive.isValid()) { result = archive.read(from, to, &exporter); }
+        BatteryHistory history(QString(), true);
+        QVector<BatterySample> samples = history.samples();
+        quint32 last = archive.lastTime();
+        for (int i=0;i<samples.size();++i) {
+            quint32 time = samples.at(i).time;
+            if ((last && time<=last) || time<from || time>to) { continue; }
+            if (!exporter.sample(samples.at(i))) { break; }
+        }
+    } else if (archive.isValid()) {
+        result = archive.readRollups(resolution, from, to, &exporter);
+    }
+    exporter.end();
+    return result;
+}
@@ -0,0 +1,147 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BATTERYARCHIVE_H
+#define BATTERYARCHIVE_H
+
+#include <QString>
+#include <QVector>
+#include <QByteArray>
+#include <QFile>
+#include <QTextStream>
+
+#include "batteryhistory.h"
+
+#define BATTERY_ARCHIVE_FILE "battery.archive"
+#define BATTERY_ARCHIVE_INDEX "battery.index"
+#define BATTERY_ARCHIVE_HOURLY "battery.hourly"
+#define BATTERY_ARCHIVE_DAILY "battery.daily"
+#define BATTERY_ARCHIVE_MAGIC 0x504b4131 // PKA1
+#define BATTERY_ARCHIVE_SYNC 3600000 // ms between syncs from history
+#define BATTERY_ARCHIVE_HOUR 3600
+#define BATTERY_ARCHIVE_DAY 86400 // UTC days
+
+// min/max/mean of a period
+struct BatteryRollup
+{
+    quint32 start;
+    quint32 count;
+    quint32 energyMin;
+    quint32 energyMax;
+    quint32 energyMean;
+    qint32 powerMin;
+    qint32 powerMax;
+    qint32 powerMean;
+    quint16 percentageMin;
+    quint16 percentageMax;
+    quint16 percentageMean;
+    quint16 state; // all state bits seen
+};
+
+// streaming reader callback
+class BatteryArchiveVisitor
+{
+public:
+    virtual ~BatteryArchiveVisitor() {}
+    virtual bool sample(const BatterySample &sample) { Q_UNUSED(sample) return true; }
+    virtual bool rollup(const BatteryRollup &rollup) { Q_UNUSED(rollup) return true; }
+};
+
+// long term history: append-only blocks of delta-of-delta/varint
+// encoded samples, an index of block time ranges for seeks and
+// hourly/daily rollups. imports new samples from the live history.
+class BatteryArchive
+{
+public:
+    enum ExportFormat {
+        ExportCSV,
+        ExportJSON
+    };
+    enum Resolution {
+        ResolutionSamples,
+        ResolutionHourly,
+        ResolutionDaily
+    };
+
+    explicit BatteryArchive(const QString &dir = QString(),
+                            bool readOnly = false);
+    ~BatteryArchive();
+    static bool exportHistory(QTextStream &out,
+                              ExportFormat format,
+                              Resolution resolution,
+                              quint32 from = 0,
+                              quint32 to = 0xffffffff);
+
+    bool isValid();
+    bool isReadOnly();
+    quint32 lastTime();
+    int blocks();
+    bool sync(BatteryHistory *history);
+    bool read(quint32 from, quint32 to, BatteryArchiveVisitor *visitor);
+    bool readRollups(Resolution resolution,
+                     quint32 from,
+                     quint32 to,
+                     BatteryArchiveVisitor *visitor);
+
+private:
+    struct BlockHeader
+    {
+        quint32 magic;
+        quint32 count;
+        quint32 first;
+        quint32 last;
+        quint32 size;
+        quint16 checksum;
+        quint16 reserved;
+    };
+    struct IndexEntry
+    {
+        quint32 first;
+        quint32 last;
+        quint64 offset;
+    };
+    struct Accumulator
+    {
+        Accumulator(quint32 length = BATTERY_ARCHIVE_HOUR);
+        quint32 period;
+        quint32 resume; // samples before are already in a rollup
+        BatteryRollup current;
+        qint64 energySum;
+        qint64 powerSum;
+        qint64 percentageSum;
+        bool add(const BatterySample &sample, BatteryRollup *done);
+        bool take(BatteryRollup *done);
+    };
+
+    bool _readOnly;
+    QFile archive;
+    QFile index;
+    QFile hourly;
+    QFile daily;
+    QVector<IndexEntry> entries;
+    Accumulator hours;
+    Accumulator days;
+
+    bool openFiles(const QString &dir);
+    bool loadIndex();
+    void restoreRollups();
+    void addRollups(const BatterySample &sample);
+    bool readBlock(const IndexEntry &entry,
+                   quint32 from,
+                   quint32 to,
+                   BatteryArchiveVisitor *visitor,
+                   bool *stop);
+    static QByteArray encode(const QVector<BatterySample> &samples);
+    static bool decode(const QByteArray &data,
+                       quint32 count,
+                       QVector<BatterySample> *samples);
+
+    friend class RollupRestore;
+};
+
+#endif // BATTERYARCHIVE_H
@@ -0,0 +1,99 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "batteryestimator.h"
+
+#include <math.h>
+
+BatteryEstimator::BatteryEstimator()
+{
+    reset();
+}
+
+// energy and full in Wh, time in seconds
+void BatteryEstimator::update(double energy,
+                              double energyFull,
+                              bool charging,
+                              qint64 time)
+{
+    full = energyFull;
+    if (!valid || charging != isCharging || time<lastTime) {
+        reset();
+        valid = true;
+        isCharging = charging;
+        lastEnergy = energy;
+        lastTime = time;
+        full = energyFull;
+        return;
+    }
+    qint64 elapsed = time-lastTime;
+    if (elapsed<ESTIMATOR_MIN_INTERVAL) { return; }
+    double delta = charging?energy-lastEnergy:lastEnergy-energy;
+    if (delta == 0 && elapsed<ESTIMATOR_TIME_CONSTANT) {
+        return; // energy moves in steps, wait for the next one
+    }
+    double sample = delta*3600.0/elapsed;
+    lastEnergy = energy;
+    lastTime = time;
+    if (sample<0) { return; } // wrong direction, state will catch up
+
+    if (samples == 0) {
+        mean = sample;
+        deviation = sample/2;
+    } else {
+        // clamp spikes to a few (mean absolute) deviations
+        double limit = ESTIMATOR_OUTLIER*deviation;
+        if (samples>=ESTIMATOR_MIN_SAMPLES && limit>0) {
+            if (sample>mean+limit) { sample = mean+limit; }
+            else if (sample<mean-limit) { sample = mean-limit; }
+        }
+        // weight by elapsed time, irregular updates are fine
+        double alpha = 1.0-exp(-(double)elapsed/ESTIMATOR_TIME_CONSTANT);
+        deviation += alpha*(fabs(sample-mean)-deviation);
+        mean += alpha*(sample-mean);
+    }
+    samples++;
+}
+
+void BatteryEstimator::reset()
+{
+    valid = false;
+    isCharging = false;
+    lastEnergy = 0;
+    full = 0;
+    lastTime = 0;
+    mean = 0;
+    deviation = 0;
+    samples = 0;
+}
+
+double BatteryEstimator::rate()
+{
+    return mean;
+}
+
+// grows with samples, shrinks with relative deviation
+double BatteryEstimator::confidence()
+{
+    if (samples == 0 || mean<=0) { return 0; }
+    double spread = qMin(1.0, deviation/mean);
+    double count = qMin(1.0, (double)samples/ESTIMATOR_MIN_SAMPLES);
+    return (1.0-spread)*count;
+}
+
+qlonglong BatteryEstimator::timeToEmpty()
+{
+    if (isCharging || samples == 0 || mean<=0) { return 0; }
+    return (qlonglong)(lastEnergy/mean*3600.0);
+}
+
+qlonglong BatteryEstimator::timeToFull()
+{
+    if (!isCharging || samples == 0 || mean<=0 || full<=lastEnergy) { return 0; }
+    return (qlonglong)((full-lastEnergy)/mean*3600.0);
+}
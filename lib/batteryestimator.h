@@ -0,0 +1,48 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BATTERYESTIMATOR_H
+#define BATTERYESTIMATOR_H
+
+#include <QtGlobal>
+
+#define ESTIMATOR_TIME_CONSTANT 300.0 // s, smoothing window
+#define ESTIMATOR_MIN_INTERVAL 5 // s between rate samples
+#define ESTIMATOR_OUTLIER 3.0 // deviations before a sample is clamped
+#define ESTIMATOR_MIN_SAMPLES 5 // for full confidence
+#define ESTIMATOR_MIN_CONFIDENCE 0.5 // to be shown instead of upower
+
+// time to empty/full from aggregate energy, the rate is an exponentially
+// weighted mean of energy deltas (outliers clamped), O(1) per update
+class BatteryEstimator
+{
+public:
+    BatteryEstimator();
+    void update(double energy,
+                double energyFull,
+                bool charging,
+                qint64 time);
+    void reset();
+
+    double rate(); // W
+    double confidence(); // 0-1
+    qlonglong timeToEmpty();
+    qlonglong timeToFull();
+
+private:
+    bool valid;
+    bool isCharging;
+    double lastEnergy;
+    double full;
+    qint64 lastTime;
+    double mean;
+    double deviation;
+    int samples;
+};
+
+#endif // BATTERYESTIMATOR_H
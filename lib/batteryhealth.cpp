@@ -0,0 +1,265 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "batteryhealth.h"
+#include "common.h"
+
+#include <QDir>
+#include <QDateTime>
+#include <QRegExp>
+#include <QDebug>
+
+#include <sys/file.h>
+
+struct BatteryHealthHeader
+{
+    quint32 magic;
+    quint32 version;
+    quint32 throughput; // mWh, also counted between samples
+};
+
+BatteryHealth::BatteryHealth(const QString &identity, const QString &dir)
+    : readOnly(false)
+    , throughput(0)
+    , savedThroughput(0)
+    , savedTime(0)
+    , lastEnergy(-1)
+    , energyFull(0)
+    , energyFullDesign(0)
+    , reportedCycles(-1)
+    , lastState(Device::StateUnknown)
+    , slope(0)
+{
+    QString path = dir;
+    if (path.isEmpty()) {
+        path = QString("%1/%2").arg(Common::cacheDir()).arg(BATTERY_HEALTH_DIR);
+        QDir().mkpath(path);
+    }
+    file.setFileName(QString("%1/%2.%3").arg(path).arg(identity).arg(BATTERY_HEALTH_SUFFIX));
+    if (!load()) { qWarning() << "unable to open battery health" << file.fileName(); }
+}
+
+BatteryHealth::~BatteryHealth()
+{
+    saveThroughput();
+}
+
+// vendor_model_serial, safe as a file name
+QString BatteryHealth::identity(Device *device)
+{
+    if (!device) { return QString(); }
+    QString result = QString("%1_%2_%3")
+                     .arg(device->vendor)
+                     .arg(device->model)
+                     .arg(device->serial.isEmpty()?device->nativePath:device->serial)
+                     .simplified();
+    result.replace(QRegExp("[^A-Za-z0-9._-]"), "_");
+    return result;
+}
+
+bool BatteryHealth::isValid()
+{
+    return file.isOpen();
+}
+
+bool BatteryHealth::isReadOnly()
+{
+    return readOnly;
+}
+
+QString BatteryHealth::fileName()
+{
+    return file.fileName();
+}
+
+// count discharged energy, sample capacity when a charge ends
+void BatteryHealth::update(Device *device)
+{
+    if (!device || !isValid()) { return; }
+    if (device->energyFull>0) { energyFull = device->energyFull; }
+    if (device->energyFullDesign>0) { energyFullDesign = device->energyFullDesign; }
+    if (device->chargeCycles>0) { reportedCycles = device->chargeCycles; }
+
+    if (lastEnergy>=0 &&
+        device->state == Device::StateDischarging &&
+        device->energy<lastEnergy) {
+        throughput += (quint32)((lastEnergy-device->energy)*1000);
+    }
+    lastEnergy = device->energy;
+    if (QDateTime::currentDateTime().toTime_t()-savedTime >= BATTERY_HEALTH_SAVE_INTERVAL) {
+        saveThroughput();
+    }
+
+    // fully charged, or held below full by a charge threshold
+    bool charged = device->state == Device::StateFullyCharged ||
+                   device->state == Device::StatePendingCharge;
+    bool ended = charged && lastState != device->state;
+    lastState = device->state;
+    if (!ended || energyFull<=0) { return; }
+    if (!records.isEmpty() &&
+        throughput-records.last().throughput < energyFull*1000*BATTERY_HEALTH_MIN_CYCLE) { return; }
+
+    BatteryHealthSample sample;
+    sample.time = QDateTime::currentDateTime().toTime_t();
+    sample.energyFull = (quint32)(energyFull*1000);
+    sample.energyFullDesign = (quint32)(energyFullDesign*1000);
+    sample.throughput = throughput;
+    sample.cycles = reportedCycles;
+    if (append(sample)) { analyze(); }
+}
+
+QVector<BatteryHealthSample> BatteryHealth::samples()
+{
+    return records;
+}
+
+double BatteryHealth::health()
+{
+    double full = energyFull;
+    double design = energyFullDesign;
+    if ((full<=0 || design<=0) && !records.isEmpty()) {
+        full = records.last().energyFull/1000.0;
+        design = records.last().energyFullDesign/1000.0;
+    }
+    if (full<=0 || design<=0) { return 0; }
+    return full/design*100;
+}
+
+double BatteryHealth::wearRate()
+{
+    if (slope>=0) { return 0; }
+    return -slope*BATTERY_HEALTH_MONTH;
+}
+
+// equivalent full cycles if the battery does not count them
+double BatteryHealth::cycles()
+{
+    if (reportedCycles>0) { return reportedCycles; }
+    double design = energyFullDesign>0?energyFullDesign:energyFull;
+    if (design<=0) { return 0; }
+    return throughput/1000.0/design;
+}
+
+qlonglong BatteryHealth::timeToReplace(double threshold)
+{
+    double current = health();
+    if (current<=0) { return -1; }
+    if (current<=threshold) { return 0; }
+    if (slope>=0) { return -1; }
+    return (qlonglong)((current-threshold)/-slope);
+}
+
+// one writer per file, other instances (the dialog) only read
+bool BatteryHealth::open()
+{
+    if (!file.open(QIODevice::ReadWrite)) { return false; }
+    if (flock(file.handle(), LOCK_EX|LOCK_NB) == 0) { return true; }
+    qDebug() << "battery health is in use, open read only" << file.fileName();
+    file.close();
+    readOnly = true;
+    return file.open(QIODevice::ReadOnly);
+}
+
+bool BatteryHealth::load()
+{
+    if (!open()) { return false; }
+    BatteryHealthHeader header;
+    savedTime = QDateTime::currentDateTime().toTime_t();
+    if (file.size() < (qint64)sizeof(header)) {
+        if (readOnly) { return true; } // not written yet
+        header.magic = BATTERY_HEALTH_MAGIC;
+        header.version = BATTERY_HEALTH_VERSION;
+        header.throughput = 0;
+        file.resize(0);
+        if (file.write((const char*)&header, sizeof(header)) != (qint64)sizeof(header) ||
+            !file.flush()) {
+            file.close();
+            return false;
+        }
+        return true;
+    }
+    if (file.read((char*)&header, sizeof(header)) != (qint64)sizeof(header) ||
+        header.magic != BATTERY_HEALTH_MAGIC ||
+        header.version != BATTERY_HEALTH_VERSION) {
+        file.close();
+        return false;
+    }
+    // a torn record at the end is dropped
+    int count = (int)((file.size()-sizeof(header))/sizeof(BatteryHealthSample));
+    records.resize(count);
+    if (count>0 &&
+        file.read((char*)records.data(), count*sizeof(BatteryHealthSample)) !=
+        (qint64)(count*sizeof(BatteryHealthSample))) {
+        records.clear();
+        count = 0;
+    }
+    if (!readOnly) { file.resize(sizeof(header)+count*sizeof(BatteryHealthSample)); }
+    throughput = header.throughput;
+    if (!records.isEmpty()) {
+        throughput = qMax(throughput, records.last().throughput);
+        reportedCycles = records.last().cycles;
+    }
+    savedThroughput = throughput;
+    analyze();
+    return true;
+}
+
+// rewrite the header if the throughput moved
+bool BatteryHealth::saveThroughput()
+{
+    if (!isValid() || readOnly) { return false; }
+    savedTime = QDateTime::currentDateTime().toTime_t();
+    if (throughput == savedThroughput) { return true; }
+    BatteryHealthHeader header;
+    header.magic = BATTERY_HEALTH_MAGIC;
+    header.version = BATTERY_HEALTH_VERSION;
+    header.throughput = throughput;
+    if (!file.seek(0) ||
+        file.write((const char*)&header, sizeof(header)) != (qint64)sizeof(header) ||
+        !file.flush()) { return false; }
+    savedThroughput = throughput;
+    return true;
+}
+
+bool BatteryHealth::append(const BatteryHealthSample &sample)
+{
+    if (readOnly) { return false; }
+    file.seek(file.size());
+    if (file.write((const char*)&sample, sizeof(sample)) != (qint64)sizeof(sample) ||
+        !file.flush()) { return false; }
+    records.append(sample);
+    qDebug() << "battery health sample" << file.fileName() << health() << "%" << cycles();
+    return true;
+}
+
+// least squares fit of health over time
+void BatteryHealth::analyze()
+{
+    slope = 0;
+    double sumT = 0;
+    double sumH = 0;
+    double sumTT = 0;
+    double sumTH = 0;
+    int count = 0;
+    for (int i=0;i<records.size();++i) {
+        const BatteryHealthSample &sample = records.at(i);
+        if (!sample.energyFull || !sample.energyFullDesign) { continue; }
+        double t = (double)(sample.time-records.first().time);
+        double h = (double)sample.energyFull/sample.energyFullDesign*100;
+        sumT += t;
+        sumH += h;
+        sumTT += t*t;
+        sumTH += t*h;
+        count++;
+    }
+    if (count<2 ||
+        records.last().time-records.first().time < BATTERY_HEALTH_MIN_SPAN) { return; }
+    double divisor = count*sumTT-sumT*sumT;
+    if (divisor<=0) { return; }
+    slope = (count*sumTH-sumT*sumH)/divisor;
+}
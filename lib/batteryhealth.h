@@ -0,0 +1,81 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BATTERYHEALTH_H
+#define BATTERYHEALTH_H
+
+#include <QString>
+#include <QVector>
+#include <QFile>
+#include <QtGlobal>
+
+#include "device.h"
+
+#define BATTERY_HEALTH_DIR "health"
+#define BATTERY_HEALTH_SUFFIX "health"
+#define BATTERY_HEALTH_MAGIC 0x504b4231 // PKB1
+#define BATTERY_HEALTH_VERSION 1
+#define BATTERY_HEALTH_MIN_CYCLE 0.5 // of full discharged between samples
+#define BATTERY_HEALTH_MIN_SPAN 604800 // s of samples before wear is projected
+#define BATTERY_HEALTH_MONTH 2592000 // s, unit of the wear rate
+#define BATTERY_HEALTH_SAVE_INTERVAL 3600 // s between throughput saves
+
+// capacity at the end of a charge (20 bytes)
+struct BatteryHealthSample
+{
+    quint32 time; // epoch seconds
+    quint32 energyFull; // mWh
+    quint32 energyFullDesign; // mWh
+    quint32 throughput; // mWh discharged since first seen
+    qint32 cycles; // as reported by the battery, -1 if unknown
+};
+
+// wear of one battery (vendor, model and serial), one sample
+// per charge cycle appended to a small file in the cache dir,
+// the running throughput is kept in the file header
+class BatteryHealth
+{
+public:
+    explicit BatteryHealth(const QString &identity,
+                           const QString &dir = QString());
+    ~BatteryHealth();
+    static QString identity(Device *device);
+
+    bool isValid();
+    bool isReadOnly();
+    QString fileName();
+    void update(Device *device);
+    QVector<BatteryHealthSample> samples();
+
+    double health(); // % of design capacity
+    double wearRate(); // % lost per 30 days, 0 if unknown
+    double cycles(); // reported or equivalent full cycles
+    qlonglong timeToReplace(double threshold); // s, -1 if unknown
+
+private:
+    QFile file;
+    bool readOnly;
+    QVector<BatteryHealthSample> records;
+    quint32 throughput;
+    quint32 savedThroughput;
+    quint32 savedTime;
+    double lastEnergy;
+    double energyFull;
+    double energyFullDesign;
+    int reportedCycles;
+    Device::DeviceState lastState;
+    double slope; // %/s
+
+    bool load();
+    bool open();
+    bool saveThroughput();
+    bool append(const BatteryHealthSample &sample);
+    void analyze();
+};
+
+#endif // BATTERYHEALTH_H
@@ -0,0 +1,216 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "batteryhistory.h"
+#include "common.h"
+
+#include <QFile>
+#include <QDebug>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/file.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+
+#define BATTERY_HISTORY_RETRY 100
+
+BatteryHistory::BatteryHistory(const QString &file,
+                               bool readOnly,
+                               quint32 capacity)
+    : _file(file)
+    , _readOnly(readOnly)
+    , fd(-1)
+    , size(0)
+    , header(NULL)
+    , ring(NULL)
+{
+    if (_file.isEmpty()) { _file = defaultFile(); }
+    openFile(capacity);
+}
+
+BatteryHistory::~BatteryHistory()
+{
+    closeFile();
+}
+
+QString BatteryHistory::defaultFile()
+{
+    return QString("%1/%2").arg(Common::cacheDir()).arg(BATTERY_HISTORY_FILE);
+}
+
+bool BatteryHistory::isValid()
+{
+    return header != NULL;
+}
+
+QString BatteryHistory::fileName()
+{
+    return _file;
+}
+
+bool BatteryHistory::isReadOnly()
+{
+    return _readOnly;
+}
+
+quint32 BatteryHistory::capacity()
+{
+    if (!header) { return 0; }
+    return header->capacity;
+}
+
+quint64 BatteryHistory::count()
+{
+    if (!header) { return 0; }
+    __sync_synchronize();
+    return header->head;
+}
+
+// single writer
+bool BatteryHistory::append(const BatterySample &sample)
+{
+    if (!header || _readOnly) { return false; }
+    BatterySample value = sample;
+    quint64 head = header->head;
+    if (head>0) { // keep time ordered
+        quint32 previous = ring[(head-1)%header->capacity].time;
+        if (value.time<previous) { value.time = previous; }
+    }
+    header->sequence++;
+    __sync_synchronize();
+    ring[head%header->capacity] = value;
+    header->head = head+1;
+    __sync_synchronize();
+    header->sequence++;
+    return true;
+}
+
+// oldest first, max = 0 for all
+QVector<BatterySample> BatteryHistory::samples(quint32 max)
+{
+    QVector<BatterySample> result;
+    if (!header) { return result; }
+    for (int retry=0;retry<BATTERY_HISTORY_RETRY;++retry) {
+        quint32 begin = header->sequence;
+        __sync_synchronize();
+        if (begin & 1) {
+            usleep(100);
+            continue;
+        }
+        quint64 head = header->head;
+        quint32 capacity = header->capacity;
+        quint64 available = qMin(head, (quint64)capacity);
+        if (max>0 && available>max) { available = max; }
+        result.resize((int)available);
+        for (quint64 i=0;i<available;++i) {
+            result[(int)i] = ring[(head-available+i)%capacity];
+        }
+        __sync_synchronize();
+        if (header->sequence == begin) { return result; }
+    }
+    qWarning() << "no consistent battery history snapshot";
+    return QVector<BatterySample>();
+}
+
+bool BatteryHistory::last(BatterySample *sample)
+{
+    QVector<BatterySample> result = samples(1);
+    if (result.isEmpty()) { return false; }
+    if (sample) { *sample = result.first(); }
+    return true;
+}
+
+// map file, (re)initialize if the layout does not match
+bool BatteryHistory::openFile(quint32 capacity)
+{
+    closeFile();
+    if (capacity<1) { return false; }
+    QByteArray path = QFile::encodeName(_file);
+    fd = open(path.constData(), (_readOnly?O_RDONLY:O_RDWR|O_CREAT)|O_CLOEXEC, 0644);
+    if (fd<0) { return false; }
+    // one writer per file, other instances (the dialog) only read
+    if (!_readOnly && flock(fd, LOCK_EX|LOCK_NB) != 0) {
+        qDebug() << "battery history is in use, open read only" << _file;
+        close(fd);
+        _readOnly = true;
+        fd = open(path.constData(), O_RDONLY|O_CLOEXEC);
+        if (fd<0) { return false; }
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0) {
+        closeFile();
+        return false;
+    }
+    bool valid = false;
+    if ((size_t)info.st_size >= sizeof(Header)) {
+        Header current;
+        if (pread(fd, &current, sizeof(current), 0) == (ssize_t)sizeof(current) &&
+            current.magic == BATTERY_HISTORY_MAGIC &&
+            current.version == BATTERY_HISTORY_VERSION &&
+            current.sampleSize == sizeof(BatterySample) &&
+            current.capacity>0 &&
+            (size_t)info.st_size == sizeof(Header)+current.capacity*sizeof(BatterySample))
+        {
+            valid = true;
+            capacity = current.capacity;
+        }
+    }
+    if (!valid) {
+        if (_readOnly) {
+            closeFile();
+            return false;
+        }
+        qDebug() << "create battery history" << _file << capacity;
+        size_t length = sizeof(Header)+capacity*sizeof(BatterySample);
+        if (ftruncate(fd, 0) != 0 || ftruncate(fd, length) != 0) {
+            closeFile();
+            return false;
+        }
+        Header fresh;
+        memset(&fresh, 0, sizeof(fresh));
+        fresh.magic = BATTERY_HISTORY_MAGIC;
+        fresh.version = BATTERY_HISTORY_VERSION;
+        fresh.capacity = capacity;
+        fresh.sampleSize = sizeof(BatterySample);
+        if (pwrite(fd, &fresh, sizeof(fresh), 0) != (ssize_t)sizeof(fresh)) {
+            closeFile();
+            return false;
+        }
+    }
+
+    size = sizeof(Header)+capacity*sizeof(BatterySample);
+    void *data = mmap(NULL,
+                      size,
+                      _readOnly?PROT_READ:PROT_READ|PROT_WRITE,
+                      MAP_SHARED,
+                      fd,
+                      0);
+    if (data == MAP_FAILED) {
+        closeFile();
+        return false;
+    }
+    header = (Header*)data;
+    ring = (BatterySample*)((char*)data+sizeof(Header));
+    if (!_readOnly && (header->sequence & 1)) {
+        header->sequence++; // writer died while writing
+    }
+    return true;
+}
+
+void BatteryHistory::closeFile()
+{
+    if (header) { munmap(header, size); }
+    header = NULL;
+    ring = NULL;
+    size = 0;
+    if (fd>=0) { close(fd); }
+    fd = -1;
+}
@@ -0,0 +1,84 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BATTERYHISTORY_H
+#define BATTERYHISTORY_H
+
+#include <QString>
+#include <QVector>
+#include <QtGlobal>
+
+#define BATTERY_HISTORY_FILE "battery.history"
+#define BATTERY_HISTORY_MAGIC 0x504b4831 // PKH1
+#define BATTERY_HISTORY_VERSION 1
+#define BATTERY_HISTORY_SIZE 8192 // samples (128 KiB)
+#define BATTERY_HISTORY_INTERVAL 10 // s between samples with the same state
+
+// state bits
+#define BATTERY_HISTORY_ON_BATTERY 0x01
+#define BATTERY_HISTORY_CHARGING 0x02
+#define BATTERY_HISTORY_DISCHARGING 0x04
+#define BATTERY_HISTORY_FULL 0x08
+#define BATTERY_HISTORY_PRESENT 0x10
+
+// one aggregate reading (16 bytes)
+struct BatterySample
+{
+    quint32 time; // epoch seconds, never decreasing
+    quint32 energy; // mWh
+    qint32 power; // mW, negative while charging
+    quint16 percentage; // 1/100 %
+    quint16 state;
+};
+
+// fixed size ring of samples in a shared memory mapped file,
+// one writer (flock, others fall back to read only), readers copy
+// a consistent snapshot (sequence counter, retried if a write was
+// in progress)
+class BatteryHistory
+{
+public:
+    explicit BatteryHistory(const QString &file = QString(),
+                            bool readOnly = false,
+                            quint32 capacity = BATTERY_HISTORY_SIZE);
+    ~BatteryHistory();
+    static QString defaultFile();
+
+    bool isValid();
+    QString fileName();
+    bool isReadOnly();
+    quint32 capacity();
+    quint64 count();
+    bool append(const BatterySample &sample);
+    QVector<BatterySample> samples(quint32 max = 0);
+    bool last(BatterySample *sample);
+
+private:
+    struct Header
+    {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 sampleSize;
+        volatile quint32 sequence; // odd while writing
+        quint32 reserved;
+        volatile quint64 head; // samples written
+    };
+
+    QString _file;
+    bool _readOnly;
+    int fd;
+    size_t size;
+    Header *header;
+    BatterySample *ring;
+
+    bool openFile(quint32 capacity);
+    void closeFile();
+};
+
+#endif // BATTERYHISTORY_H
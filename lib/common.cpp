@@ -7,6 +7,8 @@
 */
 
 #include "common.h"
+#include "backlight.h"
+#include "sysfsattribute.h"
 #include <QFile>
 #include <QFileInfo>
 //#include <QIcon>
@@ -14,80 +16,172 @@
 #include <QDir>
 #include <QSettings>
 #include <QDebug>
-#include <QDirIterator>
-#include <QTextStream>
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMapIterator>
 
 #include "def.h"
 
 #define PK "powerkit"
 
+// merged settings snapshot (defaults, system drop-ins and user file)
+struct ConfStamp
+{
+    QDateTime modified;
+    qint64 size;
+};
+static QVariantMap confSnapshot;
+static QStringList confLocked;
+static QMap<QString, ConfStamp> confStamps;
+static QElapsedTimer confChecked;
+static bool confValid = false;
+
+static ConfStamp confStamp(const QString &file)
+{
+    QFileInfo info(file);
+    ConfStamp stamp;
+    stamp.modified = info.exists()?info.lastModified():QDateTime();
+    stamp.size = info.exists()?info.size():-1;
+    return stamp;
+}
+
+static bool confChanged()
+{
+    QMapIterator<QString, ConfStamp> i(confStamps);
+    while (i.hasNext()) {
+        i.next();
+        ConfStamp stamp = confStamp(i.key());
+        if (stamp.modified != i.value().modified ||
+            stamp.size != i.value().size) { return true; }
+    }
+    return false;
+}
+
+static void confMerge()
+{
+    confSnapshot = Common::defaultPowerSettings();
+    confLocked.clear();
+    confStamps.clear();
+
+    // system drop-ins in lexical order, dir is stamped to catch new/removed files
+    QDir dir(CONF_SYSTEM_DIR);
+    confStamps[dir.absolutePath()] = confStamp(dir.absolutePath());
+    QStringList dropins = dir.entryList(QStringList() << "*.conf",
+                                        QDir::Files|QDir::Readable,
+                                        QDir::Name);
+    foreach (QString dropin, dropins) {
+        QString file = dir.absoluteFilePath(dropin);
+        confStamps[file] = confStamp(file);
+        QSettings layer(file, QSettings::IniFormat);
+        foreach (QString key, layer.allKeys()) {
+            if (key == CONF_LOCKED) { continue; }
+            if (confLocked.contains(key)) { continue; }
+            confSnapshot[key] = layer.value(key);
+        }
+        foreach (QString key, layer.value(CONF_LOCKED).toStringList()) {
+            if (!confLocked.contains(key)) { confLocked << key; }
+        }
+    }
+
+    // user
+    QString user = QString("%1/powerkit.conf").arg(Common::confDir());
+    confStamps[user] = confStamp(user);
+    QSettings layer(user, QSettings::IniFormat);
+    foreach (QString key, layer.allKeys()) {
+        if (confLocked.contains(key)) { continue; }
+        confSnapshot[key] = layer.value(key);
+    }
+
+    confValid = true;
+    qDebug() << "merged settings from" << confStamps.keys() << "locked" << confLocked;
+}
+
+// layers are only checked for changes every CONF_CHECK_INTERVAL ms
+static const QVariantMap &confCurrent()
+{
+    if (!confValid) {
+        confMerge();
+        confChecked.start();
+    } else if (!confChecked.isValid() ||
+               confChecked.elapsed() >= CONF_CHECK_INTERVAL) {
+        if (confChanged()) { confMerge(); }
+        confChecked.start();
+    }
+    return confSnapshot;
+}
+
 void Common::savePowerSettings(QString type, QVariant value)
 {
+    if (lockedPowerSettings(type)) {
+        qWarning() << "setting is locked by the system administrator" << type;
+        return;
+    }
     QSettings settings(PK, PK);
     settings.setValue(type, value);
     settings.sync();
+    invalidatePowerSettings();
 }
 
 QVariant Common::loadPowerSettings(QString type)
 {
-    QSettings settings(PK, PK);
-    return settings.value(type);
+    return confCurrent().value(type);
 }
 
 bool Common::validPowerSettings(QString type)
 {
-    QSettings settings(PK, PK);
-    return settings.value(type).isValid();
+    return confCurrent().value(type).isValid();
+}
+
+bool Common::lockedPowerSettings(QString type)
+{
+    confCurrent();
+    return confLocked.contains(type);
+}
+
+void Common::invalidatePowerSettings()
+{
+    confValid = false;
+}
+
+QVariantMap Common::defaultPowerSettings()
+{
+    QVariantMap result;
+    result[CONF_LID_BATTERY_ACTION] = LID_BATTERY_DEFAULT;
+    result[CONF_LID_AC_ACTION] = LID_AC_DEFAULT;
+    result[CONF_CRITICAL_BATTERY_ACTION] = CRITICAL_DEFAULT;
+    result[CONF_CRITICAL_BATTERY_TIMEOUT] = CRITICAL_BATTERY;
+    result[CONF_SUSPEND_BATTERY_TIMEOUT] = AUTO_SLEEP_BATTERY;
+    result[CONF_FREEDESKTOP_SS] = true;
+    result[CONF_FREEDESKTOP_PM] = true;
+    result[CONF_TRAY_NOTIFY] = true;
+    result[CONF_TRAY_SHOW] = true;
+    result[CONF_LID_DISABLE_IF_EXTERNAL] = false;
+    result[CONF_SUSPEND_BATTERY_ACTION] = suspendSleep;
+    result[CONF_SUSPEND_AC_ACTION] = suspendNone;
+    result[CONF_BACKLIGHT_BATTERY_ENABLE] = false;
+    result[CONF_BACKLIGHT_AC_ENABLE] = false;
+    result[CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER] = false;
+    result[CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER] = false;
+    result[CONF_WARN_ON_LOW_BATTERY] = true;
+    result[CONF_WARN_ON_VERYLOW_BATTERY] = true;
+    result[CONF_NOTIFY_ON_BATTERY] = true;
+    result[CONF_NOTIFY_ON_AC] = true;
+    result[CONF_BACKLIGHT_MOUSE_WHEEL] = true;
+    result[CONF_SUSPEND_LOCK_SCREEN] = true;
+    result[CONF_RESUME_LOCK_SCREEN] = false;
+    result[CONF_SUSPEND_HIBERNATE_FLOOR] = SUSPEND_FLOOR_DEFAULT;
+    result[CONF_BATTERY_REPLACE_THRESHOLD] = BATTERY_REPLACE_DEFAULT;
+    return result;
 }
 
 void Common::saveDefaultSettings()
 {
-    savePowerSettings(CONF_LID_BATTERY_ACTION,
-                      LID_BATTERY_DEFAULT);
-    savePowerSettings(CONF_LID_AC_ACTION,
-                      LID_AC_DEFAULT);
-    savePowerSettings(CONF_CRITICAL_BATTERY_ACTION,
-                      CRITICAL_DEFAULT);
-    savePowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT,
-                      CRITICAL_BATTERY);
-    savePowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT,
-                      AUTO_SLEEP_BATTERY);
-    savePowerSettings(CONF_FREEDESKTOP_SS,
-                      true);
-    savePowerSettings(CONF_FREEDESKTOP_PM,
-                      true);
-    savePowerSettings(CONF_TRAY_NOTIFY,
-                      true);
-    savePowerSettings(CONF_TRAY_SHOW,
-                      true);
-    savePowerSettings(CONF_LID_DISABLE_IF_EXTERNAL,
-                      false);
-    savePowerSettings(CONF_SUSPEND_BATTERY_ACTION,
-                      suspendSleep);
-    savePowerSettings(CONF_SUSPEND_AC_ACTION,
-                      suspendNone);
-    savePowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE,
-                      false);
-    savePowerSettings(CONF_BACKLIGHT_AC_ENABLE,
-                      false);
-    savePowerSettings(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER,
-                      false);
-    savePowerSettings(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER,
-                      false);
-    savePowerSettings(CONF_WARN_ON_LOW_BATTERY,
-                      true);
-    savePowerSettings(CONF_WARN_ON_VERYLOW_BATTERY,
-                      true);
-    savePowerSettings(CONF_NOTIFY_ON_BATTERY,
-                      true);
-    savePowerSettings(CONF_NOTIFY_ON_AC,
-                      true);
-    savePowerSettings(CONF_BACKLIGHT_MOUSE_WHEEL,
-                      true);
-    savePowerSettings(CONF_SUSPEND_LOCK_SCREEN,
-                      true);
-    savePowerSettings(CONF_RESUME_LOCK_SCREEN,
-                      false);
+    QMapIterator<QString, QVariant> i(defaultPowerSettings());
+    while (i.hasNext()) {
+        i.next();
+        savePowerSettings(i.key(), i.value());
+    }
 }
 
 /*void Common::setIconTheme()
@@ -137,9 +231,13 @@ void Common::saveDefaultSettings()
 
 QString Common::confFile()
 {
-    QString config = QString("%1/.config/powerkit/powerkit.conf")
-                     .arg(QDir::homePath());
-    if (!QFile::exists(config)) { saveDefaultSettings(); }
+    // defaults and system drop-ins are merged at load,
+    // so the user file only holds what the user changed
+    QString config = QString("%1/powerkit.conf").arg(confDir());
+    if (!QFile::exists(config)) {
+        QFile file(config);
+        if (file.open(QIODevice::WriteOnly)) { file.close(); }
+    }
     return config;
 }
 
@@ -153,6 +251,18 @@ QString Common::confDir()
     return config;
 }
 
+QString Common::cacheDir()
+{
+    QString cache = QString::fromLocal8Bit(qgetenv("XDG_CACHE_HOME"));
+    if (cache.isEmpty()) { cache = QString("%1/.cache").arg(QDir::homePath()); }
+    cache.append("/powerkit");
+    if (!QFile::exists(cache)) {
+        QDir dir(cache);
+        dir.mkpath(cache);
+    }
+    return cache;
+}
+
 bool Common::kernelCanResume(bool ignore)
 {
     if (ignore) { return true; }
@@ -169,69 +279,44 @@ bool Common::kernelCanResume(bool ignore)
     return false;
 }
 
+// preferred (or configured) device from the backlight registry
 QString Common::backlightDevice()
 {
-#ifdef __FreeBSD__
-    // ???
-    return QString();
-#else
-    QString path = "/sys/class/backlight";
-    QDirIterator it(path, QDirIterator::Subdirectories);
-    while (it.hasNext()) {
-        QString foundDir = it.next();
-        if (foundDir.startsWith(QString("%1/radeon").arg(path))) {
-            return foundDir;
-        } else if (foundDir.startsWith(QString("%1/intel").arg(path))) {
-            return foundDir;
-        } else if (foundDir.startsWith(QString("%1/acpi").arg(path))) {
-            return foundDir;
-        }
+    QString name;
+    if (validPowerSettings(CONF_BACKLIGHT_DEVICE)) {
+        name = loadPowerSettings(CONF_BACKLIGHT_DEVICE).toString();
     }
-    return QString();
-#endif
+    return Backlight::device(name).path;
+}
+
+QStringList Common::backlightDevices()
+{
+    QStringList result;
+    QList<BacklightDevice> devices = Backlight::devices();
+    for (int i=0;i<devices.size();++i) { result << devices.at(i).path; }
+    return result;
 }
 
 bool Common::canAdjustBacklight(QString device)
 {
-    QFileInfo backlight(QString("%1/brightness").arg(device));
-    if (backlight.isWritable()) { return true; }
-    return false;
+    return Backlight::writable(device);
 }
 
 int Common::backlightMax(QString device)
 {
-    int result = 0;
-    QFile backlight(QString("%1/max_brightness").arg(device));
-    if (backlight.open(QIODevice::ReadOnly)) {
-        result = backlight.readAll().trimmed().toInt();
-        backlight.close();
-    }
-    return result;
+    return Backlight::max(device);
 }
 
 int Common::backlightValue(QString device)
 {
-    int result = 0;
-    QFile backlight(QString("%1/brightness").arg(device));
-    if (backlight.open(QIODevice::ReadOnly)) {
-        result = backlight.readAll().trimmed().toInt();
-        backlight.close();
-    }
-    return result;
+    return SysfsAttribute::shared(QString("%1/brightness").arg(device))->toInt();
 }
 
 bool Common::adjustBacklight(QString device, int value)
 {
     if (!canAdjustBacklight(device)) { return false; }
-    QFile backlight(QString("%1/brightness").arg(device));
-    if (backlight.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
-        QTextStream out(&backlight);
-        if (value<1) { value = 1; }
-        out << QString::number(value);
-        backlight.close();
-        if (value == backlightValue(device)) { return true;}
-    }
-    return false;
+    if (value<1) { value = 1; }
+    return SysfsAttribute::shared(QString("%1/brightness").arg(device))->write(value);
 }
 
 void Common::checkSettings()
@@ -11,6 +11,8 @@
 
 #include <QVariant>
 #include <QString>
+#include <QVariantMap>
+#include <QStringList>
 
 class Common
 {
@@ -18,12 +20,17 @@ public:
     static void savePowerSettings(QString type, QVariant value);
     static QVariant loadPowerSettings(QString type);
     static bool validPowerSettings(QString type);
+    static bool lockedPowerSettings(QString type);
+    static void invalidatePowerSettings();
+    static QVariantMap defaultPowerSettings();
     static void saveDefaultSettings();
     //static void setIconTheme();
     static QString confFile();
     static QString confDir();
+    static QString cacheDir();
     static bool kernelCanResume(bool ignore = false /* if ignore then always return true */);
     static QString backlightDevice();
+    static QStringList backlightDevices();
     static bool canAdjustBacklight(QString device);
     static int backlightMax(QString device);
     static int backlightValue(QString device);
@@ -0,0 +1,158 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "compositebattery.h"
+
+CompositeBattery::CompositeBattery()
+{
+    clear();
+}
+
+// replace the previous contribution of device, devices that are not
+// (or no longer) a present battery are removed
+void CompositeBattery::update(const QString &path, Device *device)
+{
+    if (!device ||
+        !device->isBattery ||
+        !device->isPresent ||
+        device->nativePath.isEmpty())
+    {
+        remove(path);
+        return;
+    }
+
+    Pack pack;
+    pack.energy = device->energy;
+    pack.energyFull = device->energyFull;
+    pack.rate = device->state == Device::StateCharging?-device->energyRate:device->energyRate;
+    pack.percentage = device->percentage;
+    pack.state = device->state;
+
+    QMap<QString, Pack>::iterator previous = packs.find(path);
+    if (previous != packs.end()) {
+        add(previous.value(), -1);
+        previous.value() = pack;
+    } else { packs.insert(path, pack); }
+    add(pack, 1);
+
+    if (pack.state == Device::StateDischarging) {
+        if (drained.isEmpty() ||
+            packs.value(drained).rate<pack.rate) { drained = path; }
+    } else if (drained == path) { findDischarging(); }
+}
+
+void CompositeBattery::remove(const QString &path)
+{
+    QMap<QString, Pack>::iterator previous = packs.find(path);
+    if (previous == packs.end()) { return; }
+    add(previous.value(), -1);
+    packs.erase(previous);
+    if (packs.isEmpty()) { clear(); } // no drift left in the sums
+    else if (drained == path) { findDischarging(); }
+}
+
+void CompositeBattery::clear()
+{
+    packs.clear();
+    sumEnergy = 0;
+    sumEnergyFull = 0;
+    sumRate = 0;
+    sumPercentage = 0;
+    charging = 0;
+    dischargingCount = 0;
+    full = 0;
+    drained.clear();
+}
+
+int CompositeBattery::count()
+{
+    return packs.size();
+}
+
+double CompositeBattery::energy()
+{
+    return sumEnergy;
+}
+
+double CompositeBattery::energyFull()
+{
+    return sumEnergyFull;
+}
+
+double CompositeBattery::rate()
+{
+    return sumRate;
+}
+
+// packs without energy info fall back to the mean percentage
+double CompositeBattery::percentage()
+{
+    if (packs.isEmpty()) { return 0; }
+    if (sumEnergyFull>0) {
+        double result = sumEnergy/sumEnergyFull*100;
+        return qBound(0.0, result, 100.0);
+    }
+    return sumPercentage/packs.size();
+}
+
+bool CompositeBattery::isCharging()
+{
+    return charging>0;
+}
+
+bool CompositeBattery::isDischarging()
+{
+    return dischargingCount>0;
+}
+
+bool CompositeBattery::isFull()
+{
+    return !packs.isEmpty() && full == packs.size();
+}
+
+QString CompositeBattery::discharging()
+{
+    return drained;
+}
+
+void CompositeBattery::add(const Pack &pack, int sign)
+{
+    sumEnergy += sign*pack.energy;
+    sumEnergyFull += sign*pack.energyFull;
+    sumRate += sign*pack.rate;
+    sumPercentage += sign*pack.percentage;
+    switch (pack.state) {
+    case Device::StateCharging:
+        charging += sign;
+        break;
+    case Device::StateDischarging:
+        dischargingCount += sign;
+        break;
+    case Device::StateFullyCharged:
+        full += sign;
+        break;
+    default:;
+    }
+}
+
+// the discharging pack went away, pick the one drained the most
+void CompositeBattery::findDischarging()
+{
+    drained.clear();
+    if (dischargingCount<1) { return; }
+    double highest = 0;
+    QMapIterator<QString, Pack> pack(packs);
+    while (pack.hasNext()) {
+        pack.next();
+        if (pack.value().state != Device::StateDischarging) { continue; }
+        if (drained.isEmpty() || pack.value().rate>highest) {
+            drained = pack.key();
+            highest = pack.value().rate;
+        }
+    }
+}
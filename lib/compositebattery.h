@@ -0,0 +1,60 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef COMPOSITEBATTERY_H
+#define COMPOSITEBATTERY_H
+
+#include <QMap>
+#include <QString>
+
+#include "device.h"
+
+// aggregate of all present batteries (like the upower display device),
+// sums are adjusted by each device delta instead of being recomputed
+class CompositeBattery
+{
+public:
+    CompositeBattery();
+    void update(const QString &path, Device *device);
+    void remove(const QString &path);
+    void clear();
+
+    int count();
+    double energy(); // Wh
+    double energyFull(); // Wh
+    double rate(); // W, negative while charging
+    double percentage(); // energy weighted
+    bool isCharging();
+    bool isDischarging();
+    bool isFull();
+    QString discharging(); // path of the pack being drained
+
+private:
+    struct Pack
+    {
+        double energy;
+        double energyFull;
+        double rate;
+        double percentage;
+        Device::DeviceState state;
+    };
+    QMap<QString, Pack> packs;
+    double sumEnergy;
+    double sumEnergyFull;
+    double sumRate;
+    double sumPercentage;
+    int charging;
+    int dischargingCount;
+    int full;
+    QString drained;
+
+    void add(const Pack &pack, int sign);
+    void findDischarging();
+};
+
+#endif // COMPOSITEBATTERY_H
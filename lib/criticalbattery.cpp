@@ -0,0 +1,138 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "criticalbattery.h"
+#include "def.h"
+
+#include <QDebug>
+
+#include <limits.h>
+
+CriticalBattery::CriticalBattery(QObject *parent)
+    : QObject(parent)
+    , timer(0)
+    , threshold(CRITICAL_BATTERY)
+    , latched(false)
+    , lastLeft(-1)
+    , dischargeRate(0)
+{
+    timer = new QTimer(this);
+    timer->setSingleShot(true);
+    connect(timer, SIGNAL(timeout()),
+            this, SLOT(handleDeadline()));
+}
+
+bool CriticalBattery::isTriggered()
+{
+    return latched;
+}
+
+QDateTime CriticalBattery::deadline()
+{
+    return planned;
+}
+
+double CriticalBattery::rate()
+{
+    return dischargeRate;
+}
+
+void CriticalBattery::setThreshold(int percent)
+{
+    if (percent == threshold) { return; }
+    threshold = percent;
+    planned = QDateTime();
+    if (lastLeft>0) { plan(lastLeft); }
+}
+
+// new battery level, the rate is learned from level drops
+void CriticalBattery::update(double left, bool onBattery)
+{
+    if (!onBattery || left<=0) {
+        reset();
+        return;
+    }
+    if (latched) { return; }
+    if (left<=(double)threshold) {
+        lastLeft = left;
+        handleDeadline();
+        return;
+    }
+
+    QDateTime now = QDateTime::currentDateTime();
+    if (lastLeft>0 && left<lastLeft && lastDate.isValid()) {
+        qint64 secs = lastDate.secsTo(now);
+        if (secs>0) {
+            double sample = (lastLeft-left)/secs;
+            if (dischargeRate>0) {
+                sample = dischargeRate+CRITICAL_RATE_WEIGHT*(sample-dischargeRate);
+            }
+            dischargeRate = sample;
+        }
+    }
+    if (left != lastLeft || !lastDate.isValid()) {
+        lastLeft = left;
+        lastDate = now;
+    }
+    plan(left);
+}
+
+// the latch only guards an action in flight, after a (critical)
+// suspend or hibernate a battery still below the threshold triggers again
+void CriticalBattery::resume()
+{
+    if (latched) { qDebug() << "critical battery latch reset on resume"; }
+    latched = false;
+    planned = QDateTime();
+    // the level dropped while asleep, no rate sample over it
+    lastLeft = -1;
+    lastDate = QDateTime();
+}
+
+// one deadline, moved only when the estimate changed enough
+void CriticalBattery::plan(double left)
+{
+    if (latched || dischargeRate<=0) { return; }
+    QDateTime now = QDateTime::currentDateTime();
+    qint64 secs = (qint64)((left-threshold)/dischargeRate)-CRITICAL_LEAD_TIME;
+    if (secs<=0) {
+        handleDeadline();
+        return;
+    }
+    QDateTime deadline = now.addSecs(secs);
+    if (planned.isValid() && timer->isActive()) {
+        qint64 diff = planned.secsTo(deadline);
+        qint64 tolerance = qMax((qint64)CRITICAL_REPLAN_MIN,
+                                (qint64)(now.secsTo(planned)*CRITICAL_REPLAN_RATIO));
+        if (qAbs(diff)<tolerance) { return; }
+    }
+    planned = deadline;
+    qDebug() << "critical battery expected at" << planned << dischargeRate*3600 << "%/h";
+    timer->start((int)qMin(secs*1000, (qint64)INT_MAX));
+}
+
+void CriticalBattery::reset()
+{
+    if (latched) { qDebug() << "critical battery latch reset"; }
+    timer->stop();
+    latched = false;
+    lastLeft = -1;
+    lastDate = QDateTime();
+    dischargeRate = 0;
+    planned = QDateTime();
+}
+
+// timers stop during suspend, update() re-plans on resume
+void CriticalBattery::handleDeadline()
+{
+    if (latched) { return; }
+    timer->stop();
+    latched = true;
+    qDebug() << "critical battery!" << lastLeft;
+    emit triggered(lastLeft);
+}
@@ -0,0 +1,57 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef CRITICALBATTERY_H
+#define CRITICALBATTERY_H
+
+#include <QObject>
+#include <QDateTime>
+#include <QTimer>
+
+#define CRITICAL_LEAD_TIME 60 // s, the action must be done before the threshold
+#define CRITICAL_RATE_WEIGHT 0.3 // of a new rate sample
+#define CRITICAL_REPLAN_RATIO 0.1 // of the time left
+#define CRITICAL_REPLAN_MIN 30 // s
+
+// predicts when the battery crosses the critical threshold and
+// triggers once (reset on AC or resume)
+class CriticalBattery : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit CriticalBattery(QObject *parent = NULL);
+    bool isTriggered();
+    QDateTime deadline();
+    double rate();
+
+private:
+    QTimer *timer;
+    int threshold;
+    bool latched;
+    double lastLeft;
+    QDateTime lastDate;
+    double dischargeRate; // %/s
+    QDateTime planned;
+
+    void plan(double left);
+    void reset();
+
+signals:
+    void triggered(double left);
+
+public slots:
+    void setThreshold(int percent);
+    void update(double left, bool onBattery);
+    void resume();
+
+private slots:
+    void handleDeadline();
+};
+
+#endif // CRITICALBATTERY_H
@@ -46,10 +46,9 @@ enum criticalAction
 };
 
 #define VIRTUAL_MONITOR "VIRTUAL"
-#define TURN_OFF_MONITOR "xrandr --output %1 --off"
-#define TURN_ON_MONITOR "xrandr --output %1 --auto "
 #define LUMINA_XCONFIG "lumina-xconfig --reset-monitors"
 #define DRACO_XCONFIG "draco-xconfig --reset-monitors"
+#define RANDR_ACTION_DEFAULT randrRightOf
 
 #define LID_BATTERY_DEFAULT lidSleep
 #define LID_AC_DEFAULT lidLock
@@ -59,6 +58,16 @@ enum criticalAction
 #define LOW_BATTERY 5 // % over critical
 #define CRITICAL_BATTERY 10
 #define AUTO_SLEEP_BATTERY 15
+#define SUSPEND_FLOOR_DEFAULT 5 // % left when suspend turns into hibernate
+#define SUSPEND_DRAIN_FILE "suspend_drain.conf"
+#define SUSPEND_DRAIN_MIN_TIME 900 // s asleep for a usable sample
+#define SUSPEND_DRAIN_MIN_RATE 0.1 // %/h
+#define SUSPEND_DRAIN_MAX_RATE 10 // %/h, higher samples are ignored
+#define SUSPEND_DRAIN_WEIGHT 0.3 // of a new sample
+#define SUSPEND_DRAIN_SETTLE 10000 // ms to wait for upower after resume
+#define SUSPEND_WAKE_MARGIN 600 // s, wake before the floor is reached
+#define SUSPEND_HIBERNATE_MIN_TIME 1800 // s, hibernate right away if closer
+#define BATTERY_REPLACE_DEFAULT 70 // % of design capacity
 #define DEFAULT_THEME "Adwaita"
 #define DEFAULT_AC_ICON "ac-adapter"
 #define DEFAULT_BATTERY_ICON "battery"
@@ -117,6 +126,8 @@ enum criticalAction
 #define CONF_SUSPEND_AC_ACTION "suspend_ac_action"
 #define CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY "suspend_wakeup_hibernate_battery"
 #define CONF_SUSPEND_WAKEUP_HIBERNATE_AC "suspend_wakeup_hibernate_ac"
+#define CONF_SUSPEND_HIBERNATE_FLOOR "suspend_hibernate_floor"
+#define CONF_BATTERY_REPLACE_THRESHOLD "battery_replace_threshold"
 #define CONF_CRITICAL_BATTERY_TIMEOUT "critical_battery_timeout"
 #define CONF_CRITICAL_BATTERY_ACTION "critical_battery_action"
 #define CONF_LID_BATTERY_ACTION "lid_battery_action"
@@ -127,6 +138,8 @@ enum criticalAction
 #define CONF_TRAY_NOTIFY "tray_notify"
 #define CONF_TRAY_SHOW "show_tray"
 #define CONF_LID_XRANDR "lid_xrandr_action"
+#define CONF_RANDR_ACTION "randr_action"
+#define CONF_REFRESH_LOW_BATTERY "refresh_rate_low_battery"
 #define CONF_BACKLIGHT_BATTERY "backlight_battery_value"
 #define CONF_BACKLIGHT_BATTERY_ENABLE "backlight_battery_enable"
 #define CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER "backlight_battery_disable_if_lower"
@@ -134,6 +147,7 @@ enum criticalAction
 #define CONF_BACKLIGHT_AC_ENABLE "backlight_ac_enable"
 #define CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER "backlight_ac_disable_if_higher"
 #define CONF_BACKLIGHT_MOUSE_WHEEL "backlight_mouse_wheel"
+#define CONF_BACKLIGHT_DEVICE "backlight_device"
 #define CONF_DIALOG "dialog_geometry"
 #define CONF_WARN_ON_LOW_BATTERY "warn_on_low_battery"
 #define CONF_WARN_ON_VERYLOW_BATTERY "warn_on_verylow_battery"
@@ -144,4 +158,9 @@ enum criticalAction
 #define CONF_ICON_THEME "icon_theme"
 #define CONF_KERNEL_BYPASS "kernel_cmd_bypass"
 
+#define CONF_WRITE_DELAY 750 // ms of quiet before settings are written
+#define CONF_CHECK_INTERVAL 1000 // ms between settings layer mtime checks
+#define CONF_SYSTEM_DIR "/etc/xdg/powerkit.d"
+#define CONF_LOCKED "locked"
+
 #endif // DEF_H
@@ -21,6 +21,8 @@
 #define PROP_DEV_ENERGY_FULL "EnergyFull"
 #define PROP_DEV_ENERGY_EMPTY "EnergyEmpty"
 #define PROP_DEV_ENERGY "Energy"
+#define PROP_DEV_ENERGY_RATE "EnergyRate"
+#define PROP_DEV_STATE "State"
 #define PROP_DEV_ONLINE "Online"
 #define PROP_DEV_POWER_SUPPLY "PowerSupply"
 #define PROP_DEV_TIME_TO_EMPTY "TimeToEmpty"
@@ -28,6 +30,8 @@
 #define PROP_DEV_TYPE "Type"
 #define PROP_DEV_VENDOR "Vendor"
 #define PROP_DEV_NATIVEPATH "NativePath"
+#define PROP_DEV_SERIAL "Serial"
+#define PROP_DEV_CHARGE_CYCLES "ChargeCycles"
 
 Device::Device(const QString block, QObject *parent)
     : QObject(parent)
@@ -44,6 +48,9 @@ Device::Device(const QString block, QObject *parent)
     , energyFullDesign(0)
     , energyFull(0)
     , energyEmpty(0)
+    , energyRate(0)
+    , state(StateUnknown)
+    , chargeCycles(-1)
     , dbus(0)
     , dbusp(0)
 {
@@ -88,6 +95,8 @@ void Device::updateDeviceProperties()
     energyFull = dbus->property(PROP_DEV_ENERGY_FULL).toDouble();
     energyEmpty = dbus->property(PROP_DEV_ENERGY_EMPTY).toDouble();
     energy = dbus->property(PROP_DEV_ENERGY).toDouble();
+    energyRate = dbus->property(PROP_DEV_ENERGY_RATE).toDouble();
+    state = (DeviceState)dbus->property(PROP_DEV_STATE).toUInt();
     online = dbus->property(PROP_DEV_ONLINE).toBool();
     hasPowerSupply = dbus->property(PROP_DEV_POWER_SUPPLY).toBool();
     timeToEmpty = dbus->property(PROP_DEV_TIME_TO_EMPTY).toLongLong();
@@ -103,6 +112,9 @@ void Device::updateDeviceProperties()
 
     vendor = dbus->property(PROP_DEV_VENDOR).toString();
     nativePath = dbus->property(PROP_DEV_NATIVEPATH).toString();
+    serial = dbus->property(PROP_DEV_SERIAL).toString();
+    QVariant cycles = dbus->property(PROP_DEV_CHARGE_CYCLES); // upower >= 0.99.14
+    chargeCycles = cycles.isValid()?cycles.toInt():-1;
 
     emit deviceChanged(path);
 }
@@ -115,6 +127,9 @@ void Device::update()
 void Device::updateBattery()
 {
     percentage =  dbus->property(PROP_DEV_PERCENT).toDouble();
+    energy = dbus->property(PROP_DEV_ENERGY).toDouble();
+    energyRate = dbus->property(PROP_DEV_ENERGY_RATE).toDouble();
+    state = (DeviceState)dbus->property(PROP_DEV_STATE).toUInt();
     timeToEmpty = dbus->property(PROP_DEV_TIME_TO_EMPTY).toLongLong();
     timeToFull = dbus->property(PROP_DEV_TIME_TO_FULL).toLongLong();
 }
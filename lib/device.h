@@ -33,6 +33,15 @@ public:
         DevicePda,
         DevicePhone
     };
+    enum DeviceState {
+        StateUnknown,
+        StateCharging,
+        StateDischarging,
+        StateEmpty,
+        StateFullyCharged,
+        StatePendingCharge,
+        StatePendingDischarge
+    };
     explicit Device(const QString block,
                     QObject *parent = NULL);
     QString name;
@@ -48,13 +57,17 @@ public:
     bool isAC;
     QString vendor;
     QString nativePath;
+    QString serial;
     double capacity;
     double energy;
     double energyFullDesign;
     double energyFull;
     double energyEmpty;
+    double energyRate;
+    DeviceState state;
     qlonglong timeToEmpty;
     qlonglong timeToFull;
+    int chargeCycles; // -1 if unknown
 
 private:
     QDBusInterface *dbus;
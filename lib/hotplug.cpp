@@ -8,75 +8,55 @@
 
 #include "hotplug.h"
 
-HotPlug::HotPlug(QObject *parent) :
+HotPlug::HotPlug(Screens *screens, QObject *parent) :
     QObject(parent)
+  , _screens(screens)
   , _scanning(false)
 {
-    moveToThread(&t);
-    t.start();
+    // the Screens socket notifier delivers RandR events, no thread needed
+    if (!_screens) { _screens = new Screens(this); }
+    connect(_screens, SIGNAL(outputChanged(QString,bool)),
+            this, SLOT(handleOutputChanged(QString,bool)));
+    connect(_screens, SIGNAL(outputsChanged()),
+            this, SLOT(handleOutputsChanged()));
 }
 
-HotPlug::~HotPlug()
+bool HotPlug::isScanning()
 {
-    _scanning = false;
-    t.wait();
-    t.quit();
+    return _scanning;
 }
 
 void HotPlug::requestScan()
 {
-    QMetaObject::invokeMethod(this, "scan");
+    scan();
 }
 
 void HotPlug::scan()
 {
     if (_scanning) { return; }
     _scanning = true;
-
-    Display *dpy;
-    if ((dpy = XOpenDisplay(NULL)) == NULL) { return; }
-
-    XRRScreenResources *sr;
-    XRROutputInfo *info;
-    XEvent ev;
-
-    getScreens(dpy);
-
-    XRRSelectInput(dpy, DefaultRootWindow(dpy), RROutputChangeNotifyMask);
-    XSync(dpy, 0);
-    while(_scanning) {
-        if (!XNextEvent(dpy, &ev)) {
-            sr = XRRGetScreenResources(OCNE(&ev)->display, OCNE(&ev)->window);
-            if (sr == NULL) { continue; }
-            info = XRRGetOutputInfo(OCNE(&ev)->display, sr, OCNE(&ev)->output);
-            if (info == NULL) {
-                XRRFreeScreenResources(sr);
-                continue;
-            }
-            QString screenName = info->name;
-            bool screenConnected = false;
-            if (info->connection == RR_Connected) { screenConnected = true; }
-            emit status(screenName, screenConnected);
-            XRRFreeScreenResources(sr);
-            XRRFreeOutputInfo(info);
-        }
-    }
-    XCloseDisplay(dpy);
+    emit found(_screens->cachedOutputs());
 }
 
 void HotPlug::requestSetScan(bool scanning)
 {
-    QMetaObject::invokeMethod(this, "setScan", Q_ARG(bool, scanning));
+    setScan(scanning);
 }
 
-void HotPlug::getScreens(Display *dpy)
+void HotPlug::setScan(bool scanning)
 {
-    if (dpy == NULL) { return; }
-    QMap<QString,bool> result = Screens::outputsDpy(dpy);
-    emit found(result);
+    if (scanning) { scan(); }
+    else { _scanning = false; }
 }
 
-void HotPlug::setScan(bool scanning)
+void HotPlug::handleOutputChanged(const QString &output, bool connected)
+{
+    if (!_scanning) { return; }
+    emit status(output, connected);
+}
+
+void HotPlug::handleOutputsChanged()
 {
-    _scanning = scanning;
+    if (!_scanning) { return; }
+    emit found(_screens->cachedOutputs());
 }
@@ -10,25 +10,21 @@
 #define HOTPLUG_H
 
 #include <QObject>
-#include <QThread>
 #include <QMap>
 
 #include "screens.h"
-#include <X11/extensions/Xrandr.h>
-
-#undef Bool // fix X11 inc
-#define OCNE(X) ((XRROutputChangeNotifyEvent*)X)
 
+// output hotplug, runs in the event loop on the Screens connection
 class HotPlug : public QObject
 {
     Q_OBJECT
 
 public:
-    explicit HotPlug(QObject *parent = 0);
-    ~HotPlug();
+    explicit HotPlug(Screens *screens = NULL, QObject *parent = NULL);
+    bool isScanning();
 
 private:
-    QThread t;
+    Screens *_screens;
     bool _scanning;
 
 signals:
@@ -40,8 +36,9 @@ public slots:
     void requestSetScan(bool scanning);
 private slots:
     void scan();
-    void getScreens(Display *dpy);
     void setScan(bool scanning);
+    void handleOutputChanged(const QString &output, bool connected);
+    void handleOutputsChanged();
 };
 
 #endif // HOTPLUG_H
@@ -17,18 +17,44 @@ SOURCES += \
     screensaver.cpp \
     device.cpp \
     screens.cpp \
+    hotplug.cpp \
+    randrlayout.cpp \
+    refreshrate.cpp \
+    criticalbattery.cpp \
+    batteryhistory.cpp \
+    batteryarchive.cpp \
+    batteryestimator.cpp \
+    compositebattery.cpp \
+    batteryhealth.cpp \
+    backlight.cpp \
+    backlighttransition.cpp \
+    sysfsattribute.cpp \
     powerkit.cpp \
     rtc.cpp \
-    common.cpp
+    common.cpp \
+    settingswriter.cpp
 HEADERS += \
     powermanagement.h \
     screensaver.h \
     def.h \
     device.h \
     screens.h \
+    hotplug.h \
+    randrlayout.h \
+    refreshrate.h \
+    criticalbattery.h \
+    batteryhistory.h \
+    batteryarchive.h \
+    batteryestimator.h \
+    compositebattery.h \
+    batteryhealth.h \
+    backlight.h \
+    backlighttransition.h \
+    sysfsattribute.h \
     powerkit.h \
     rtc.h \
-    common.h
+    common.h \
+    settingswriter.h
 
 include(../powerkit.pri)
 CONFIG(install_lib) {
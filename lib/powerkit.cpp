@@ -8,6 +8,7 @@
 
 #include "powerkit.h"
 #include "def.h"
+#include "common.h"
 
 #include <QDBusInterface>
 #include <QDBusMessage>
@@ -15,6 +16,7 @@
 #include <QXmlStreamReader>
 #include <QProcess>
 #include <QMapIterator>
+#include <QSettings>
 #include <QDebug>
 #include <QDBusReply>
 
@@ -29,9 +31,30 @@ PowerKit::PowerKit(QObject *parent) : QObject(parent)
   , wakeAlarm(false)
   , suspendWakeupBattery(0)
   , suspendWakeupAC(0)
+  , suspendHibernateFloor(SUSPEND_FLOOR_DEFAULT)
+  , sleepEnergy(0)
+  , sleepEnergyFull(0)
+  , sleepSuspend(false)
+  , suspendDrainRate(0)
+  , suspendDrainSamples(0)
   , lockScreenOnSuspend(true)
   , lockScreenOnResume(false)
+  , history(0)
+  , archive(0)
+  , batteryReplaceThreshold(BATTERY_REPLACE_DEFAULT)
 {
+    history = new BatteryHistory();
+    archive = new BatteryArchive();
+    syncArchive();
+    archiveTimer.setInterval(BATTERY_ARCHIVE_SYNC);
+    connect(&archiveTimer, SIGNAL(timeout()),
+            this, SLOT(syncArchive()));
+    archiveTimer.start();
+    loadSuspendDrain();
+    drainTimer.setSingleShot(true);
+    drainTimer.setInterval(SUSPEND_DRAIN_SETTLE);
+    connect(&drainTimer, SIGNAL(timeout()),
+            this, SLOT(measureSleepDrain()));
     setup();
     timer.setInterval(TIMEOUT_CHECK);
     connect(&timer, SIGNAL(timeout()),
@@ -43,6 +66,10 @@ PowerKit::~PowerKit()
 {
     clearDevices();
     releaseSuspendLock();
+    syncArchive();
+    delete archive;
+    delete history;
+    qDeleteAll(healths);
 }
 
 QMap<QString, Device *> PowerKit::getDevices()
@@ -50,6 +77,11 @@ QMap<QString, Device *> PowerKit::getDevices()
     return devices;
 }
 
+BatteryHistory *PowerKit::getHistory()
+{
+    return history;
+}
+
 bool PowerKit::availableService(const QString &service,
                           const QString &path,
                           const QString &interface)
@@ -321,6 +353,8 @@ void PowerKit::scan()
                 this,
                 SLOT(handleDeviceChanged(QString)));
         devices[foundDevicePath] = newDevice;
+        composite.update(foundDevicePath, newDevice);
+        updateHealth(newDevice);
     }
     UpdateDevices();
     emit UpdatedDevices();
@@ -352,6 +386,7 @@ void PowerKit::deviceRemoved(const QString &path)
     if (deviceExists) {
         if (find().contains(path)) { return; }
         delete devices.take(path);
+        composite.remove(path);
         emit DeviceWasRemoved(path);
     }
     scan();
@@ -377,13 +412,20 @@ void PowerKit::deviceChanged()
     }
     wasOnBattery = OnBattery();
 
+    recordHistory();
     emit UpdatedDevices();
 }
 
 void PowerKit::handleDeviceChanged(const QString &device)
 {
     if (device.isEmpty()) { return; }
+    composite.update(device, devices.value(device));
+    updateHealth(devices.value(device));
     deviceChanged();
+    // first battery update from upower since resume
+    if (drainTimer.isActive() &&
+        devices.value(device) &&
+        devices.value(device)->isBattery) { measureSleepDrain(); }
 }
 
 void PowerKit::handleResume()
@@ -398,6 +440,7 @@ void PowerKit::handleSuspend()
     if (HasLogind() || HasConsoleKit()) { return; }
     qDebug() << "handle suspend from upower";
     if (lockScreenOnSuspend) { LockScreen(); }
+    recordSleep();
     emit PrepareForSuspend();
 }
 
@@ -406,11 +449,18 @@ void PowerKit::handlePrepareForSuspend(bool prepare)
     qDebug() << "handle prepare for suspend/resume from consolekit/logind" << prepare;
     if (prepare) {
         if (lockScreenOnSuspend) { LockScreen(); }
+        recordSleep();
         emit PrepareForSuspend();
         releaseSuspendLock(); // we are ready for suspend
     }
     else { // resume
+        // the energy delta over the sleep is not a discharge rate
+        estimator.reset();
         UpdateDevices();
+        // upower has not read the battery yet, measure on its first update
+        sleepSuspend = false;
+        wakeDate = QDateTime::currentDateTime();
+        if (sleepDate.isValid()) { drainTimer.start(); }
         if (lockScreenOnResume) { LockScreen(); }
         if (hasWakeAlarm() &&
              wakeAlarmDate.isValid() &&
@@ -430,6 +480,71 @@ void PowerKit::handlePrepareForSuspend(bool prepare)
     }
 }
 
+// aggregate battery reading to estimator and history, history
+// is skipped if the state is the same and the last sample is recent
+void PowerKit::recordHistory()
+{
+    if (composite.count()<1) {
+        estimator.reset();
+        return;
+    }
+    quint16 state = BATTERY_HISTORY_PRESENT;
+    if (composite.isCharging()) { state |= BATTERY_HISTORY_CHARGING; }
+    if (composite.isDischarging()) { state |= BATTERY_HISTORY_DISCHARGING; }
+    if (composite.isFull()) { state |= BATTERY_HISTORY_FULL; }
+    if (wasOnBattery) { state |= BATTERY_HISTORY_ON_BATTERY; }
+
+    uint now = QDateTime::currentDateTime().toTime_t();
+    estimator.update(composite.energy(), composite.energyFull(), !wasOnBattery, now);
+    if (!history->isValid()) { return; }
+
+    BatterySample sample;
+    sample.time = now;
+    sample.energy = (quint32)(composite.energy()*1000);
+    sample.power = (qint32)(composite.rate()*1000);
+    sample.percentage = (quint16)(composite.percentage()*100);
+    sample.state = state;
+
+    BatterySample previous;
+    if (history->last(&previous) &&
+        previous.state == sample.state &&
+        sample.time-previous.time < BATTERY_HISTORY_INTERVAL) { return; }
+    history->append(sample);
+}
+
+// move live history to the long term archive
+void PowerKit::syncArchive()
+{
+    archive->sync(history);
+}
+
+// per battery wear, created on first sight
+void PowerKit::updateHealth(Device *device)
+{
+    if (!device ||
+        !device->isBattery ||
+        !device->isPresent ||
+        device->nativePath.isEmpty()) { return; }
+    QString identity = BatteryHealth::identity(device);
+    if (!healths.contains(identity)) { healths[identity] = new BatteryHealth(identity); }
+    healths.value(identity)->update(device);
+}
+
+QList<BatteryHealth*> PowerKit::presentHealths()
+{
+    QList<BatteryHealth*> result;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (!device.value()->isBattery ||
+            !device.value()->isPresent ||
+            device.value()->nativePath.isEmpty()) { continue; }
+        BatteryHealth *health = healths.value(BatteryHealth::identity(device.value()));
+        if (health) { result << health; }
+    }
+    return result;
+}
+
 void PowerKit::clearDevices()
 {
     QMapIterator<QString, Device*> device(devices);
@@ -438,6 +553,7 @@ void PowerKit::clearDevices()
         delete device.value();
     }
     devices.clear();
+    composite.clear();
 }
 
 void PowerKit::handleNewInhibitScreenSaver(const QString &application, const QString &reason, quint32 cookie)
@@ -497,15 +613,86 @@ bool PowerKit::registerSuspendLock()
     return false;
 }
 
-void PowerKit::setWakeAlarmFromSettings()
+// wake up (and hibernate) before the battery reaches the floor,
+// false if the floor is too close and we should hibernate right away
+bool PowerKit::setWakeAlarmFromSettings()
 {
-    if (!CanHibernate()) { return; }
-    int wmin = OnBattery()?suspendWakeupBattery:suspendWakeupAC;
-    if (wmin>0) {
-        qDebug() << "we need to set a wake alarm" << wmin << "min from now";
-        QDateTime date = QDateTime::currentDateTime().addSecs(wmin*60);
-        setWakeAlarm(date);
+    if (!CanHibernate()) { return true; }
+    bool battery = OnBattery();
+    int wmin = battery?suspendWakeupBattery:suspendWakeupAC;
+    if (wmin<1) { return true; }
+    qint64 secs = wmin*60;
+    if (battery && suspendDrainSamples>0) {
+        double rate = qMax(suspendDrainRate, (double)SUSPEND_DRAIN_MIN_RATE);
+        double left = BatteryLeft()-suspendHibernateFloor;
+        secs = (qint64)(left/rate*3600)-SUSPEND_WAKE_MARGIN;
+        qDebug() << "suspend drain" << rate << "%/h," << left << "% above floor";
+        if (secs<SUSPEND_HIBERNATE_MIN_TIME) {
+            qDebug() << "battery floor is too close, hibernate instead of suspend";
+            return false;
+        }
     }
+    qDebug() << "we need to set a wake alarm" << secs/60 << "min from now";
+    QDateTime date = QDateTime::currentDateTime().addSecs(secs);
+    setWakeAlarm(date);
+    return true;
+}
+
+// energy of present batteries (Wh)
+double PowerKit::batteryEnergy(double *full)
+{
+    UpdateBattery();
+    if (full) { *full = composite.energyFull(); }
+    return composite.energy();
+}
+
+void PowerKit::loadSuspendDrain()
+{
+    QSettings settings(QString("%1/%2").arg(Common::confDir()).arg(SUSPEND_DRAIN_FILE),
+                       QSettings::IniFormat);
+    suspendDrainRate = settings.value("rate", 0).toDouble();
+    suspendDrainSamples = settings.value("samples", 0).toInt();
+}
+
+// once per Suspend()
+void PowerKit::recordSleep()
+{
+    drainTimer.stop();
+    sleepDate = QDateTime();
+    bool requested = sleepSuspend;
+    sleepSuspend = false;
+    if (!requested || !OnBattery()) { return; }
+    sleepEnergy = batteryEnergy(&sleepEnergyFull);
+    if (sleepEnergyFull<=0) { return; }
+    sleepDate = QDateTime::currentDateTime();
+}
+
+// update the drain estimate (moving average), only full cycles on battery
+void PowerKit::measureSleepDrain()
+{
+    drainTimer.stop();
+    if (!sleepDate.isValid()) { return; }
+    qint64 secs = sleepDate.secsTo(wakeDate);
+    sleepDate = QDateTime();
+    if (secs<SUSPEND_DRAIN_MIN_TIME || !OnBattery()) { return; }
+    double energy = batteryEnergy(NULL);
+    if (energy>sleepEnergy) { return; } // charged or bogus
+    double rate = (sleepEnergy-energy)/sleepEnergyFull*100/(secs/3600.0);
+    // nothing drained (hibernated) or a bad reading
+    if (rate<SUSPEND_DRAIN_MIN_RATE || rate>SUSPEND_DRAIN_MAX_RATE) {
+        qDebug() << "ignore suspend drain sample" << rate << "%/h";
+        return;
+    }
+    if (suspendDrainSamples>0) {
+        rate = suspendDrainRate+SUSPEND_DRAIN_WEIGHT*(rate-suspendDrainRate);
+    }
+    suspendDrainRate = rate;
+    suspendDrainSamples++;
+    qDebug() << "suspend drain is" << suspendDrainRate << "%/h" << suspendDrainSamples;
+    QSettings settings(QString("%1/%2").arg(Common::confDir()).arg(SUSPEND_DRAIN_FILE),
+                       QSettings::IniFormat);
+    settings.setValue("rate", suspendDrainRate);
+    settings.setValue("samples", suspendDrainSamples);
 }
 
 bool PowerKit::HasConsoleKit()
@@ -621,16 +808,18 @@ QString PowerKit::Suspend()
 {
     qDebug() << "try to suspend";
     if (lockScreenOnSuspend) { LockScreen(); }
-    if (HasLogind()) {
-        setWakeAlarmFromSettings();
-        return executeAction(PKSuspendAction, PKLogind);
-    } else if (HasConsoleKit()) {
-        setWakeAlarmFromSettings();
-        return executeAction(PKSuspendAction, PKConsoleKit);
-    } else if (HasUPower()) {
-        return executeAction(PKSuspendAction, PKUPower);
-    }
-    return QObject::tr(PK_NO_BACKEND);
+    PKBackend backend = PKNoBackend;
+    if (HasLogind()) { backend = PKLogind; }
+    else if (HasConsoleKit()) { backend = PKConsoleKit; }
+    else if (HasUPower()) { backend = PKUPower; }
+    else { return QObject::tr(PK_NO_BACKEND); }
+    if (backend != PKUPower && !setWakeAlarmFromSettings()) { return Hibernate(); }
+    // only cycles started here are sampled, not external
+    // (hybrid) sleep or hibernate
+    sleepSuspend = true;
+    QString result = executeAction(PKSuspendAction, backend);
+    if (!result.isEmpty()) { sleepSuspend = false; }
+    return result;
 }
 
 QString PowerKit::Hibernate()
@@ -707,23 +896,32 @@ bool PowerKit::OnBattery()
     return false;
 }
 
+// energy weighted charge of all batteries, 0 if none
 double PowerKit::BatteryLeft()
 {
     if (OnBattery()) { UpdateBattery(); }
-    double batteryLeft = 0;
-    QMapIterator<QString, Device*> device(devices);
-    int batteries = 0;
-    while (device.hasNext()) {
-        device.next();
-        if (device.value()->isBattery &&
-            device.value()->isPresent &&
-            !device.value()->nativePath.isEmpty())
-        {
-            batteryLeft += device.value()->percentage;
-            batteries++;
-        } else { continue; }
-    }
-    return batteryLeft/batteries;
+    return composite.percentage();
+}
+
+double PowerKit::BatteryEnergy()
+{
+    return composite.energy();
+}
+
+double PowerKit::BatteryEnergyFull()
+{
+    return composite.energyFull();
+}
+
+// W, negative while charging
+double PowerKit::BatteryRate()
+{
+    return composite.rate();
+}
+
+QString PowerKit::DischargingBattery()
+{
+    return composite.discharging();
 }
 
 void PowerKit::LockScreen()
@@ -775,6 +973,24 @@ qlonglong PowerKit::TimeToFull()
     return result;
 }
 
+// own estimate (see BatteryEstimator), 0 if unknown
+qlonglong PowerKit::EstimatedTimeToEmpty()
+{
+    if (!OnBattery()) { return 0; }
+    return estimator.timeToEmpty();
+}
+
+qlonglong PowerKit::EstimatedTimeToFull()
+{
+    if (OnBattery()) { return 0; }
+    return estimator.timeToFull();
+}
+
+double PowerKit::EstimateConfidence()
+{
+    return estimator.confidence();
+}
+
 void PowerKit::UpdateDevices()
 {
     QMapIterator<QString, Device*> device(devices);
@@ -791,6 +1007,8 @@ void PowerKit::UpdateBattery()
         device.next();
         if (device.value()->isBattery) {
             device.value()->updateBattery();
+            composite.update(device.key(), device.value());
+            updateHealth(device.value());
         }
     }
 }
@@ -800,6 +1018,12 @@ void PowerKit::UpdateConfig()
     emit Update();
 }
 
+void PowerKit::UpdateConfigKeys(const QStringList &keys)
+{
+    qDebug() << "config changed" << keys;
+    emit UpdatedConfig(keys);
+}
+
 QStringList PowerKit::ScreenSaverInhibitors()
 {
     QStringList result;
@@ -822,6 +1046,57 @@ QStringList PowerKit::PowerManagementInhibitors()
     return result;
 }
 
+// full snapshot for clients (config dialog etc)
+QVariantMap PowerKit::State()
+{
+    QVariantMap result = Status();
+    result[PK_CAN_SUSPEND] = CanSuspend();
+    result[PK_CAN_HIBERNATE] = CanHibernate();
+    result[PK_CAN_POWEROFF] = CanPowerOff();
+    result[UPOWER_LID_IS_PRESENT] = LidIsPresent();
+    return result;
+}
+
+// battery, devices and inhibitors (what changes at runtime)
+QVariantMap PowerKit::Status()
+{
+    QVariantMap result;
+    result[UPOWER_ON_BATTERY] = OnBattery();
+    result[PK_HAS_BATTERY] = HasBattery();
+    result[PK_BATTERY_LEFT] = BatteryLeft();
+    result[PK_BATTERY_ENERGY] = BatteryEnergy();
+    result[PK_BATTERY_ENERGY_FULL] = BatteryEnergyFull();
+    result[PK_BATTERY_RATE] = BatteryRate();
+    result[PK_DISCHARGING_BATTERY] = DischargingBattery();
+    result[PK_BATTERY_HEALTH] = batteryHealth();
+    result[PK_BATTERY_WEAR_RATE] = batteryWearRate();
+    result[PK_BATTERY_CYCLES] = batteryCycles();
+    result[PK_BATTERY_REPLACE_IN] = batteryReplaceIn();
+    result[PK_TIME_TO_EMPTY] = TimeToEmpty();
+    result[PK_TIME_TO_FULL] = TimeToFull();
+    result[PK_ESTIMATED_TIME_TO_EMPTY] = EstimatedTimeToEmpty();
+    result[PK_ESTIMATED_TIME_TO_FULL] = EstimatedTimeToFull();
+    result[PK_ESTIMATE_CONFIDENCE] = EstimateConfidence();
+    result[PK_SS_INHIBITORS] = ScreenSaverInhibitors();
+    result[PK_PM_INHIBITORS] = PowerManagementInhibitors();
+
+    QVariantList list;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        QVariantMap info;
+        info[PK_DEVICE_PATH] = device.value()->path;
+        info[PK_DEVICE_NAME] = device.value()->name;
+        info[PK_DEVICE_MODEL] = device.value()->model;
+        info[PK_DEVICE_TYPE] = (uint)device.value()->type;
+        info[PK_DEVICE_PRESENT] = device.value()->isPresent;
+        info[PK_DEVICE_PERCENT] = device.value()->percentage;
+        list << info;
+    }
+    result[PK_DEVICES] = list;
+    return result;
+}
+
 const QDateTime PowerKit::getWakeAlarm()
 {
     return wakeAlarmDate;
@@ -845,6 +1120,91 @@ void PowerKit::setSuspendWakeAlarmOnAC(int value)
     suspendWakeupAC = value;
 }
 
+void PowerKit::setSuspendHibernateFloor(int value)
+{
+    qDebug() << "set suspend hibernate floor" << value;
+    suspendHibernateFloor = value;
+}
+
+void PowerKit::setBatteryReplaceThreshold(int value)
+{
+    qDebug() << "set battery replace threshold" << value;
+    batteryReplaceThreshold = value;
+}
+
+// % of design capacity, 0 if unknown
+double PowerKit::batteryHealth()
+{
+    double result = 0;
+    QList<BatteryHealth*> batteries = presentHealths();
+    for (int i=0;i<batteries.size();++i) {
+        double health = batteries.at(i)->health();
+        if (health>0 && (result == 0 || health<result)) { result = health; }
+    }
+    return result;
+}
+
+// % lost per 30 days
+double PowerKit::batteryWearRate()
+{
+    double result = 0;
+    QList<BatteryHealth*> batteries = presentHealths();
+    for (int i=0;i<batteries.size();++i) {
+        result = qMax(result, batteries.at(i)->wearRate());
+    }
+    return result;
+}
+
+double PowerKit::batteryCycles()
+{
+    double result = 0;
+    QList<BatteryHealth*> batteries = presentHealths();
+    for (int i=0;i<batteries.size();++i) {
+        result = qMax(result, batteries.at(i)->cycles());
+    }
+    return result;
+}
+
+// s until the replace threshold is reached, -1 if unknown
+qlonglong PowerKit::batteryReplaceIn()
+{
+    qlonglong result = -1;
+    QList<BatteryHealth*> batteries = presentHealths();
+    for (int i=0;i<batteries.size();++i) {
+        qlonglong left = batteries.at(i)->timeToReplace(batteryReplaceThreshold);
+        if (left>=0 && (result<0 || left<result)) { result = left; }
+    }
+    return result;
+}
+
+// health of each present battery
+QVariantMap PowerKit::BatteryHealthReport()
+{
+    QVariantMap result;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        QString identity = BatteryHealth::identity(device.value());
+        BatteryHealth *health = healths.value(identity);
+        if (!health ||
+            !device.value()->isBattery ||
+            !device.value()->isPresent) { continue; }
+        QVariantMap battery;
+        battery[PK_BATTERY_HEALTH] = health->health();
+        battery[PK_BATTERY_WEAR_RATE] = health->wearRate();
+        battery[PK_BATTERY_CYCLES] = health->cycles();
+        battery[PK_BATTERY_REPLACE_IN] = health->timeToReplace(batteryReplaceThreshold);
+        battery["Samples"] = health->samples().size();
+        result[identity] = battery;
+    }
+    return result;
+}
+
+double PowerKit::getSuspendDrainRate()
+{
+    return suspendDrainRate;
+}
+
 void PowerKit::setLockScreenOnSuspend(bool lock)
 {
     qDebug() << "set lock screen on suspend" << lock;
@@ -17,8 +17,14 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QDBusUnixFileDescriptor>
+#include <QVariantMap>
 
 #include "device.h"
+#include "batteryhistory.h"
+#include "batteryarchive.h"
+#include "batteryestimator.h"
+#include "compositebattery.h"
+#include "batteryhealth.h"
 
 #define POWERKIT_SERVICE "org.freedesktop.PowerKit"
 #define POWERKIT_PATH "/PowerKit"
@@ -57,6 +63,30 @@
 #define PK_HIBERNATE "Hibernate"
 #define PK_CAN_HYBRIDSLEEP "CanHybridSleep"
 #define PK_HYBRIDSLEEP "HybridSleep"
+#define PK_BATTERY_LEFT "BatteryLeft"
+#define PK_HAS_BATTERY "HasBattery"
+#define PK_TIME_TO_EMPTY "TimeToEmpty"
+#define PK_TIME_TO_FULL "TimeToFull"
+#define PK_BATTERY_ENERGY "BatteryEnergy"
+#define PK_BATTERY_ENERGY_FULL "BatteryEnergyFull"
+#define PK_BATTERY_RATE "BatteryRate"
+#define PK_DISCHARGING_BATTERY "DischargingBattery"
+#define PK_BATTERY_HEALTH "BatteryHealth"
+#define PK_BATTERY_WEAR_RATE "BatteryWearRate"
+#define PK_BATTERY_CYCLES "BatteryCycles"
+#define PK_BATTERY_REPLACE_IN "BatteryReplaceIn"
+#define PK_ESTIMATED_TIME_TO_EMPTY "EstimatedTimeToEmpty"
+#define PK_ESTIMATED_TIME_TO_FULL "EstimatedTimeToFull"
+#define PK_ESTIMATE_CONFIDENCE "EstimateConfidence"
+#define PK_DEVICES "Devices"
+#define PK_SS_INHIBITORS "ScreenSaverInhibitors"
+#define PK_PM_INHIBITORS "PowerManagementInhibitors"
+#define PK_DEVICE_PATH "Path"
+#define PK_DEVICE_NAME "Name"
+#define PK_DEVICE_MODEL "Model"
+#define PK_DEVICE_TYPE "Type"
+#define PK_DEVICE_PRESENT "IsPresent"
+#define PK_DEVICE_PERCENT "Percentage"
 #define PK_NO_BACKEND "No backend available."
 #define PK_NO_ACTION "Action no available."
 
@@ -78,6 +108,11 @@
 class PowerKit : public QObject
 {
     Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", POWERKIT_SERVICE)
+    Q_PROPERTY(double BatteryHealth READ batteryHealth)
+    Q_PROPERTY(double BatteryWearRate READ batteryWearRate)
+    Q_PROPERTY(double BatteryCycles READ batteryCycles)
+    Q_PROPERTY(qlonglong BatteryReplaceIn READ batteryReplaceIn)
 
 public:
     enum PKBackend {
@@ -110,6 +145,13 @@ public:
     explicit PowerKit(QObject *parent = 0);
     ~PowerKit();
     QMap<QString, Device*> getDevices();
+    BatteryHistory *getHistory();
+
+    // worst of the present batteries
+    double batteryHealth();
+    double batteryWearRate();
+    double batteryCycles();
+    qlonglong batteryReplaceIn();
 
 private:
     QMap<QString, Device*> devices;
@@ -134,10 +176,29 @@ private:
 
     int suspendWakeupBattery;
     int suspendWakeupAC;
+    int suspendHibernateFloor;
+
+    // energy before suspend, drain while suspended (%/h)
+    QDateTime sleepDate;
+    QDateTime wakeDate;
+    QTimer drainTimer; // upower updates after resume
+    double sleepEnergy;
+    double sleepEnergyFull;
+    bool sleepSuspend; // set by Suspend()
+    double suspendDrainRate;
+    int suspendDrainSamples;
 
     bool lockScreenOnSuspend;
     bool lockScreenOnResume;
 
+    BatteryHistory *history;
+    BatteryArchive *archive;
+    QTimer archiveTimer;
+    BatteryEstimator estimator;
+    CompositeBattery composite;
+    QMap<QString, BatteryHealth*> healths;
+    int batteryReplaceThreshold;
+
 signals:
     void Update();
     void UpdatedDevices();
@@ -150,6 +211,7 @@ signals:
     void DeviceWasRemoved(const QString &path);
     void DeviceWasAdded(const QString &path);
     void UpdatedInhibitors();
+    void UpdatedConfig(const QStringList &keys);
 
 private slots:
     bool availableService(const QString &service,
@@ -185,7 +247,15 @@ private slots:
     void handleDelInhibitPowerManagement(quint32 cookie);
     
     bool registerSuspendLock();
-    void setWakeAlarmFromSettings();
+    bool setWakeAlarmFromSettings();
+    double batteryEnergy(double *full);
+    void loadSuspendDrain();
+    void recordSleep();
+    void measureSleepDrain();
+    void recordHistory();
+    void syncArchive();
+    void updateHealth(Device *device);
+    QList<BatteryHealth*> presentHealths();
 
 public slots:
     bool HasConsoleKit();
@@ -213,19 +283,33 @@ public slots:
     bool LidIsClosed();
     bool OnBattery();
     double BatteryLeft();
+    double BatteryEnergy();
+    double BatteryEnergyFull();
+    double BatteryRate();
+    QString DischargingBattery();
     void LockScreen();
     bool HasBattery();
     qlonglong TimeToEmpty();
     qlonglong TimeToFull();
+    qlonglong EstimatedTimeToEmpty();
+    qlonglong EstimatedTimeToFull();
+    double EstimateConfidence();
     void UpdateDevices();
     void UpdateBattery();
     void UpdateConfig();
+    void UpdateConfigKeys(const QStringList &keys);
     QStringList ScreenSaverInhibitors();
     QStringList PowerManagementInhibitors();
+    QVariantMap State();
+    QVariantMap Status();
     const QDateTime getWakeAlarm();
     void releaseSuspendLock();
     void setSuspendWakeAlarmOnBattery(int value);
     void setSuspendWakeAlarmOnAC(int value);
+    void setSuspendHibernateFloor(int value);
+    void setBatteryReplaceThreshold(int value);
+    QVariantMap BatteryHealthReport();
+    double getSuspendDrainRate();
     void setLockScreenOnSuspend(bool lock);
     void setLockScreenOnResume(bool lock);
 };
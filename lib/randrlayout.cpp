@@ -0,0 +1,500 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "randrlayout.h"
+#include "common.h"
+#include "def.h"
+
+#include <QVector>
+#include <QMap>
+#include <QStringList>
+#include <QCryptographicHash>
+#include <QTimer>
+#include <QSettings>
+#include <QDebug>
+
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
+#include <stdlib.h>
+
+#define EDID_BLOCK_SIZE 128
+
+struct RandRMonitor
+{
+    RandRMonitor()
+        : output(0)
+        , connected(false)
+        , preferred(0)
+        , crtc(0)
+        , enabled(false)
+        , placed(false)
+        , mode(0)
+        , x(0)
+        , y(0)
+        , width(0)
+        , height(0) {}
+    xcb_randr_output_t output;
+    QString name;
+    QString id;
+    bool connected;
+    QVector<xcb_randr_mode_t> modes;
+    QVector<xcb_randr_crtc_t> crtcs;
+    int preferred;
+    xcb_randr_crtc_t crtc;
+    bool enabled;
+    bool placed;
+    xcb_randr_mode_t mode;
+    int x;
+    int y;
+    int width;
+    int height;
+};
+
+struct RandRCrtc
+{
+    RandRCrtc()
+        : mode(0)
+        , output(0)
+        , x(0)
+        , y(0) {}
+    xcb_randr_mode_t mode;
+    xcb_randr_output_t output;
+    int x;
+    int y;
+};
+
+// best mode for size (preferred first, then highest refresh)
+static xcb_randr_mode_t findMode(const RandRMonitor &monitor,
+                                 const QMap<xcb_randr_mode_t, xcb_randr_mode_info_t> &modeTable,
+                                 int width,
+                                 int height)
+{
+    xcb_randr_mode_t result = 0;
+    double rate = 0;
+    for (int i=0;i<monitor.modes.size();++i) {
+        if (!modeTable.contains(monitor.modes.at(i))) { continue; }
+        xcb_randr_mode_info_t info = modeTable.value(monitor.modes.at(i));
+        if (info.width != width || info.height != height) { continue; }
+        if (i<monitor.preferred) { return info.id; }
+        double modeRate = 0;
+        if (info.htotal && info.vtotal) {
+            modeRate = (double)info.dot_clock/((double)info.htotal*info.vtotal);
+        }
+        if (result == 0 || modeRate>rate) {
+            result = info.id;
+            rate = modeRate;
+        }
+    }
+    return result;
+}
+
+RandRLayout::RandRLayout(Screens *screens, QObject *parent)
+    : QObject(parent)
+    , _screens(screens)
+    , edidAtom(0)
+{
+}
+
+// monitor identity from the EDID base block (vendor/product/serial)
+QString RandRLayout::edidIdentity(const unsigned char *edid, int length)
+{
+    if (edid == NULL || length<EDID_BLOCK_SIZE) { return QString(); }
+    QByteArray block((const char*)edid, EDID_BLOCK_SIZE);
+    return QString::fromLatin1(QCryptographicHash::hash(block,
+                                                        QCryptographicHash::Md5).toHex());
+}
+
+// kept out of powerkit.conf, that one is watched and reloaded
+void RandRLayout::loadLayouts()
+{
+    QSettings settings(QString("%1/%2").arg(Common::confDir()).arg(RANDR_LAYOUTS_FILE),
+                       QSettings::IniFormat);
+    layouts = settings.value("layouts").toMap();
+}
+
+void RandRLayout::saveLayouts()
+{
+    QSettings settings(QString("%1/%2").arg(Common::confDir()).arg(RANDR_LAYOUTS_FILE),
+                       QSettings::IniFormat);
+    settings.setValue("layouts", layouts);
+}
+
+// apply layout to all outputs in one server grab,
+// queries and crtc changes are pipelined (one round trip each)
+bool RandRLayout::apply(bool internalOff)
+{
+    if (!_screens || !_screens->isValid()) { return false; }
+    Display *dpy = _screens->display();
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+    if (conn == NULL) { return false; }
+    xcb_window_t root = DefaultRootWindow(dpy);
+    loadLayouts();
+    QVariantMap oldLayouts = layouts;
+
+    xcb_grab_server(conn);
+    xcb_randr_get_screen_resources_current_reply_t *sr =
+            xcb_randr_get_screen_resources_current_reply(conn,
+                                                         xcb_randr_get_screen_resources_current(conn, root),
+                                                         NULL);
+    if (sr == NULL) {
+        xcb_ungrab_server(conn);
+        xcb_flush(conn);
+        return false;
+    }
+
+    QMap<xcb_randr_mode_t, xcb_randr_mode_info_t> modeTable;
+    xcb_randr_mode_info_t *modeInfo = xcb_randr_get_screen_resources_current_modes(sr);
+    for (int i=0;i<xcb_randr_get_screen_resources_current_modes_length(sr);++i) {
+        modeTable[modeInfo[i].id] = modeInfo[i];
+    }
+    int outputCount = xcb_randr_get_screen_resources_current_outputs_length(sr);
+    xcb_randr_output_t *outputs = xcb_randr_get_screen_resources_current_outputs(sr);
+    int crtcCount = xcb_randr_get_screen_resources_current_crtcs_length(sr);
+    xcb_randr_crtc_t *crtcs = xcb_randr_get_screen_resources_current_crtcs(sr);
+
+    // outputs, crtcs and size range
+    xcb_intern_atom_cookie_t atomCookie;
+    atomCookie.sequence = 0;
+    if (!edidAtom) { atomCookie = xcb_intern_atom(conn, 1, 4, "EDID"); }
+    xcb_randr_get_screen_size_range_cookie_t rangeCookie =
+            xcb_randr_get_screen_size_range(conn, root);
+    QVector<xcb_randr_get_output_info_cookie_t> outputCookies(outputCount);
+    for (int i=0;i<outputCount;++i) {
+        outputCookies[i] = xcb_randr_get_output_info(conn, outputs[i], sr->config_timestamp);
+    }
+    QVector<xcb_randr_get_crtc_info_cookie_t> crtcCookies(crtcCount);
+    for (int i=0;i<crtcCount;++i) {
+        crtcCookies[i] = xcb_randr_get_crtc_info(conn, crtcs[i], sr->config_timestamp);
+    }
+
+    if (!edidAtom) {
+        xcb_intern_atom_reply_t *atom = xcb_intern_atom_reply(conn, atomCookie, NULL);
+        if (atom) {
+            edidAtom = atom->atom;
+            free(atom);
+        }
+    }
+    int maxWidth = 0;
+    int maxHeight = 0;
+    xcb_randr_get_screen_size_range_reply_t *range =
+            xcb_randr_get_screen_size_range_reply(conn, rangeCookie, NULL);
+    if (range) {
+        maxWidth = range->max_width;
+        maxHeight = range->max_height;
+        free(range);
+    }
+
+    QVector<RandRMonitor> monitors;
+    for (int i=0;i<outputCount;++i) {
+        xcb_randr_get_output_info_reply_t *info =
+                xcb_randr_get_output_info_reply(conn, outputCookies.at(i), NULL);
+        if (info == NULL) { continue; }
+        RandRMonitor monitor;
+        monitor.output = outputs[i];
+        monitor.name = QString::fromUtf8((const char*)xcb_randr_get_output_info_name(info),
+                                         xcb_randr_get_output_info_name_length(info));
+        monitor.connected = info->connection == XCB_RANDR_CONNECTION_CONNECTED;
+        monitor.crtc = info->crtc;
+        monitor.preferred = info->num_preferred;
+        xcb_randr_mode_t *modes = xcb_randr_get_output_info_modes(info);
+        for (int m=0;m<xcb_randr_get_output_info_modes_length(info);++m) {
+            monitor.modes << modes[m];
+        }
+        xcb_randr_crtc_t *possible = xcb_randr_get_output_info_crtcs(info);
+        for (int c=0;c<xcb_randr_get_output_info_crtcs_length(info);++c) {
+            monitor.crtcs << possible[c];
+        }
+        monitors << monitor;
+        free(info);
+    }
+
+    QMap<xcb_randr_crtc_t, RandRCrtc> current;
+    for (int i=0;i<crtcCount;++i) {
+        xcb_randr_get_crtc_info_reply_t *info =
+                xcb_randr_get_crtc_info_reply(conn, crtcCookies.at(i), NULL);
+        RandRCrtc state;
+        if (info) {
+            state.mode = info->mode;
+            state.x = info->x;
+            state.y = info->y;
+            if (info->num_outputs>0) {
+                state.output = xcb_randr_get_crtc_info_outputs(info)[0];
+            }
+            free(info);
+        }
+        current[crtcs[i]] = state;
+    }
+
+    // EDID of connected outputs
+    QVector<xcb_randr_get_output_property_cookie_t> edidCookies(monitors.size());
+    for (int i=0;i<monitors.size();++i) {
+        if (!monitors.at(i).connected || !edidAtom) { continue; }
+        edidCookies[i] = xcb_randr_get_output_property(conn,
+                                                       monitors.at(i).output,
+                                                       edidAtom,
+                                                       XCB_ATOM_ANY,
+                                                       0,
+                                                       EDID_BLOCK_SIZE/4,
+                                                       0,
+                                                       0);
+    }
+    for (int i=0;i<monitors.size();++i) {
+        RandRMonitor &monitor = monitors[i];
+        if (monitor.connected && edidAtom) {
+            xcb_randr_get_output_property_reply_t *edid =
+                    xcb_randr_get_output_property_reply(conn, edidCookies.at(i), NULL);
+            if (edid) {
+                monitor.id = edidIdentity(xcb_randr_get_output_property_data(edid),
+                                          xcb_randr_get_output_property_data_length(edid));
+                free(edid);
+            }
+        }
+        if (monitor.id.isEmpty()) { monitor.id = monitor.name; }
+    }
+
+    QString internal = _screens->cachedInternal();
+    if (internal.isEmpty() && !monitors.isEmpty()) { internal = monitors.at(0).name; }
+    bool externalConnected = false;
+    for (int i=0;i<monitors.size();++i) {
+        const RandRMonitor &monitor = monitors.at(i);
+        if (monitor.connected &&
+            monitor.name != internal &&
+            !monitor.name.startsWith(VIRTUAL_MONITOR)) { externalConnected = true; }
+    }
+
+    // saved layouts (the live arrangement is only learned after
+    // applying, a monitor that comes up at the server default keeps its own)
+    for (int i=0;i<monitors.size();++i) {
+        RandRMonitor &monitor = monitors[i];
+        monitor.enabled = monitor.connected && !monitor.modes.isEmpty();
+        if (monitor.name == internal && internalOff && externalConnected) {
+            monitor.enabled = false;
+        }
+        if (!monitor.enabled || !layouts.contains(monitor.id)) { continue; }
+        QStringList layout = layouts.value(monitor.id).toString().split(",");
+        if (layout.size() != 4) { continue; }
+        xcb_randr_mode_t mode = findMode(monitor,
+                                         modeTable,
+                                         layout.at(2).toInt(),
+                                         layout.at(3).toInt());
+        if (!mode) { continue; }
+        monitor.mode = mode;
+        monitor.x = layout.at(0).toInt();
+        monitor.y = layout.at(1).toInt();
+        monitor.width = modeTable.value(mode).width;
+        monitor.height = modeTable.value(mode).height;
+        monitor.placed = true;
+    }
+
+    // new monitors are placed by policy
+    int action = RANDR_ACTION_DEFAULT;
+    if (Common::validPowerSettings(CONF_RANDR_ACTION)) {
+        action = Common::loadPowerSettings(CONF_RANDR_ACTION).toInt();
+    }
+    for (int i=0;i<monitors.size();++i) {
+        RandRMonitor &monitor = monitors[i];
+        if (!monitor.enabled || monitor.placed) { continue; }
+        int reference = -1;
+        int right = 0;
+        for (int r=0;r<monitors.size();++r) {
+            const RandRMonitor &other = monitors.at(r);
+            if (!other.placed) { continue; }
+            if (reference<0 || other.name == internal) { reference = r; }
+            right = qMax(right, other.x+other.width);
+        }
+        monitor.mode = monitor.modes.at(0);
+        if (reference>=0 && action == randrSameAs) {
+            xcb_randr_mode_t mode = findMode(monitor,
+                                             modeTable,
+                                             monitors.at(reference).width,
+                                             monitors.at(reference).height);
+            if (mode) { monitor.mode = mode; }
+        }
+        monitor.width = modeTable.value(monitor.mode).width;
+        monitor.height = modeTable.value(monitor.mode).height;
+        if (reference>=0) {
+            const RandRMonitor &other = monitors.at(reference);
+            switch (action) {
+            case randrLeftOf:
+                monitor.x = other.x-monitor.width;
+                monitor.y = other.y;
+                break;
+            case randrRightOf:
+                monitor.x = other.x+other.width;
+                monitor.y = other.y;
+                break;
+            case randrAbove:
+                monitor.x = other.x;
+                monitor.y = other.y-monitor.height;
+                break;
+            case randrBelow:
+                monitor.x = other.x;
+                monitor.y = other.y+other.height;
+                break;
+            case randrSameAs:
+                monitor.x = other.x;
+                monitor.y = other.y;
+                break;
+            default:
+                monitor.x = right;
+                monitor.y = 0;
+            }
+        }
+        monitor.placed = true;
+        qDebug() << "placing new monitor" << monitor.name << monitor.x << monitor.y << action;
+    }
+
+    // crtcs, keep current if possible
+    QMap<xcb_randr_crtc_t, int> targets;
+    for (int i=0;i<monitors.size();++i) {
+        const RandRMonitor &monitor = monitors.at(i);
+        if (!monitor.enabled || !monitor.crtc) { continue; }
+        if (monitor.crtcs.contains(monitor.crtc)) { targets[monitor.crtc] = i; }
+    }
+    for (int i=0;i<monitors.size();++i) {
+        RandRMonitor &monitor = monitors[i];
+        if (!monitor.enabled) { continue; }
+        if (monitor.crtc && targets.value(monitor.crtc, -1) == i) { continue; }
+        monitor.crtc = 0;
+        for (int c=0;c<monitor.crtcs.size();++c) {
+            if (targets.contains(monitor.crtcs.at(c))) { continue; }
+            monitor.crtc = monitor.crtcs.at(c);
+            targets[monitor.crtc] = i;
+            break;
+        }
+        if (!monitor.crtc) {
+            qWarning() << "no free crtc for" << monitor.name;
+            monitor.enabled = false;
+        }
+    }
+
+    // screen size
+    int minX = 0;
+    int minY = 0;
+    int width = 0;
+    int height = 0;
+    bool first = true;
+    for (int i=0;i<monitors.size();++i) {
+        const RandRMonitor &monitor = monitors.at(i);
+        if (!monitor.enabled) { continue; }
+        if (first || monitor.x<minX) { minX = monitor.x; }
+        if (first || monitor.y<minY) { minY = monitor.y; }
+        first = false;
+    }
+    for (int i=0;i<monitors.size();++i) {
+        RandRMonitor &monitor = monitors[i];
+        if (!monitor.enabled) { continue; }
+        monitor.x -= minX;
+        monitor.y -= minY;
+        width = qMax(width, monitor.x+monitor.width);
+        height = qMax(height, monitor.y+monitor.height);
+    }
+    if (first || (maxWidth && width>maxWidth) || (maxHeight && height>maxHeight)) {
+        qWarning() << "unable to apply layout" << width << height << maxWidth << maxHeight;
+        xcb_ungrab_server(conn);
+        xcb_flush(conn);
+        free(sr);
+        return false;
+    }
+
+    // what changed
+    QList<xcb_randr_crtc_t> disable;
+    QList<xcb_randr_crtc_t> enable;
+    for (int i=0;i<crtcCount;++i) {
+        RandRCrtc state = current.value(crtcs[i]);
+        int target = targets.value(crtcs[i], -1);
+        if (target<0 || !monitors.at(target).enabled) {
+            if (state.mode) { disable << crtcs[i]; }
+            continue;
+        }
+        const RandRMonitor &monitor = monitors.at(target);
+        if (state.mode == monitor.mode &&
+            state.output == monitor.output &&
+            state.x == monitor.x &&
+            state.y == monitor.y) { continue; }
+        if (state.mode) { disable << crtcs[i]; }
+        enable << crtcs[i];
+    }
+
+    bool result = true;
+    int screen = DefaultScreen(dpy);
+    bool resize = width != DisplayWidth(dpy, screen) || height != DisplayHeight(dpy, screen);
+    if (!disable.isEmpty() || !enable.isEmpty() || resize) {
+        QList<xcb_randr_set_crtc_config_cookie_t> cookies;
+        for (int i=0;i<disable.size();++i) {
+            cookies << xcb_randr_set_crtc_config(conn,
+                                                 disable.at(i),
+                                                 XCB_CURRENT_TIME,
+                                                 sr->config_timestamp,
+                                                 0,
+                                                 0,
+                                                 XCB_NONE,
+                                                 XCB_RANDR_ROTATION_ROTATE_0,
+                                                 0,
+                                                 NULL);
+        }
+        xcb_void_cookie_t sizeCookie;
+        sizeCookie.sequence = 0;
+        if (resize) {
+            // keep dpi
+            int mmWidth = DisplayWidthMM(dpy, screen)*width/qMax(1, DisplayWidth(dpy, screen));
+            int mmHeight = DisplayHeightMM(dpy, screen)*height/qMax(1, DisplayHeight(dpy, screen));
+            sizeCookie = xcb_randr_set_screen_size_checked(conn,
+                                                           root,
+                                                           width,
+                                                           height,
+                                                           mmWidth,
+                                                           mmHeight);
+        }
+        for (int i=0;i<enable.size();++i) {
+            const RandRMonitor &monitor = monitors.at(targets.value(enable.at(i)));
+            cookies << xcb_randr_set_crtc_config(conn,
+                                                 enable.at(i),
+                                                 XCB_CURRENT_TIME,
+                                                 sr->config_timestamp,
+                                                 monitor.x,
+                                                 monitor.y,
+                                                 monitor.mode,
+                                                 XCB_RANDR_ROTATION_ROTATE_0,
+                                                 1,
+                                                 &monitor.output);
+        }
+        for (int i=0;i<cookies.size();++i) {
+            xcb_generic_error_t *error = NULL;
+            xcb_randr_set_crtc_config_reply_t *reply =
+                    xcb_randr_set_crtc_config_reply(conn, cookies.at(i), &error);
+            if (reply == NULL || reply->status != XCB_RANDR_SET_CONFIG_SUCCESS) { result = false; }
+            if (reply) { free(reply); }
+            if (error) { free(error); }
+        }
+        if (resize) {
+            xcb_generic_error_t *error = xcb_request_check(conn, sizeCookie);
+            if (error) {
+                result = false;
+                free(error);
+            }
+        }
+        qDebug() << "applied layout" << width << height << result
+                 << "disabled" << disable.size() << "enabled" << enable.size();
+    }
+    xcb_ungrab_server(conn);
+    xcb_flush(conn);
+    free(sr);
+    // events read while waiting for replies
+    QTimer::singleShot(0, _screens, SLOT(handleEvents()));
+
+    // remember what was applied
+    for (int i=0;i<monitors.size();++i) {
+        const RandRMonitor &monitor = monitors.at(i);
+        if (!monitor.enabled) { continue; }
+        layouts[monitor.id] = QString("%1,%2,%3,%4")
+                              .arg(monitor.x).arg(monitor.y).arg(monitor.width).arg(monitor.height);
+    }
+    if (layouts != oldLayouts) { saveLayouts(); }
+    return result;
+}
@@ -0,0 +1,42 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef RANDRLAYOUT_H
+#define RANDRLAYOUT_H
+
+#include <QObject>
+#include <QString>
+#include <QVariantMap>
+
+#include "screens.h"
+
+#define RANDR_LAYOUTS_FILE "randr_layouts.conf"
+
+// applies monitor layouts through RandR (no xrandr process),
+// layouts are remembered per monitor (EDID)
+class RandRLayout : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RandRLayout(Screens *screens, QObject *parent = NULL);
+    static QString edidIdentity(const unsigned char *edid, int length);
+
+private:
+    Screens *_screens;
+    unsigned long edidAtom;
+    QVariantMap layouts;
+
+    void loadLayouts();
+    void saveLayouts();
+
+public slots:
+    bool apply(bool internalOff = false);
+};
+
+#endif // RANDRLAYOUT_H
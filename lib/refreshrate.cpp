@@ -0,0 +1,293 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "refreshrate.h"
+
+#include <QVector>
+#include <QDebug>
+
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
+#include <stdlib.h>
+
+static double modeRate(const xcb_randr_mode_info_t &info)
+{
+    if (!info.htotal || !info.vtotal) { return 0; }
+    return (double)info.dot_clock/((double)info.htotal*info.vtotal);
+}
+
+RefreshRate::RefreshRate(Screens *screens, QObject *parent)
+    : QObject(parent)
+    , _screens(screens)
+    , retry(0)
+    , shifted(false)
+    , wanted(false)
+{
+    for (int i=0;i<3;++i) { wmAtoms[i] = 0; }
+    retry = new QTimer(this);
+    retry->setInterval(REFRESH_RETRY_INTERVAL);
+    connect(retry, SIGNAL(timeout()),
+            this, SLOT(retrySwitch()));
+    if (!_screens) { return; }
+    connect(_screens, SIGNAL(outputsChanged()),
+            this, SLOT(clearModes()));
+    connect(_screens, SIGNAL(crtcChanged(unsigned long,unsigned long,int,int,int)),
+            this, SLOT(handleCrtcChanged(unsigned long,unsigned long,int,int,int)));
+}
+
+bool RefreshRate::isLowest()
+{
+    return shifted;
+}
+
+// is the active window fullscreen? (EWMH)
+bool RefreshRate::fullscreenActive()
+{
+    if (!_screens || !_screens->isValid()) { return false; }
+    Display *dpy = _screens->display();
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+    xcb_window_t root = DefaultRootWindow(dpy);
+
+    // atoms live as long as the server, intern them once
+    if (!wmAtoms[0] || !wmAtoms[1] || !wmAtoms[2]) {
+        xcb_intern_atom_cookie_t cookies[3] = {
+            xcb_intern_atom(conn, 0, 18, "_NET_ACTIVE_WINDOW"),
+            xcb_intern_atom(conn, 0, 13, "_NET_WM_STATE"),
+            xcb_intern_atom(conn, 0, 24, "_NET_WM_STATE_FULLSCREEN")
+        };
+        for (int i=0;i<3;++i) {
+            xcb_intern_atom_reply_t *atom = xcb_intern_atom_reply(conn, cookies[i], NULL);
+            if (atom) {
+                wmAtoms[i] = atom->atom;
+                free(atom);
+            }
+        }
+    }
+    if (!wmAtoms[0] || !wmAtoms[1] || !wmAtoms[2]) { return false; }
+    xcb_atom_t atoms[3] = { (xcb_atom_t)wmAtoms[0],
+                            (xcb_atom_t)wmAtoms[1],
+                            (xcb_atom_t)wmAtoms[2] };
+
+    xcb_window_t window = XCB_NONE;
+    xcb_get_property_reply_t *active =
+            xcb_get_property_reply(conn,
+                                   xcb_get_property(conn, 0, root, atoms[0], XCB_ATOM_WINDOW, 0, 1),
+                                   NULL);
+    if (active) {
+        if (xcb_get_property_value_length(active) >= (int)sizeof(xcb_window_t)) {
+            window = *(xcb_window_t*)xcb_get_property_value(active);
+        }
+        free(active);
+    }
+    if (!window) { return false; }
+
+    bool result = false;
+    xcb_generic_error_t *error = NULL;
+    xcb_get_property_reply_t *state =
+            xcb_get_property_reply(conn,
+                                   xcb_get_property(conn, 0, window, atoms[1], XCB_ATOM_ATOM, 0, 64),
+                                   &error);
+    if (state) {
+        xcb_atom_t *values = (xcb_atom_t*)xcb_get_property_value(state);
+        int count = xcb_get_property_value_length(state)/sizeof(xcb_atom_t);
+        for (int i=0;i<count;++i) {
+            if (values[i] == atoms[2]) { result = true; }
+        }
+        free(state);
+    }
+    if (error) { free(error); }
+    return result;
+}
+
+// cache lowest/highest mode at the current resolution of output
+bool RefreshRate::findModes(const QString &output)
+{
+    if (!_screens || !_screens->isValid()) { return false; }
+    Display *dpy = _screens->display();
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+
+    xcb_randr_get_screen_resources_current_reply_t *sr =
+            xcb_randr_get_screen_resources_current_reply(conn,
+                                                         xcb_randr_get_screen_resources_current(conn, DefaultRootWindow(dpy)),
+                                                         NULL);
+    if (sr == NULL) { return false; }
+    QMap<xcb_randr_mode_t, xcb_randr_mode_info_t> modeTable;
+    xcb_randr_mode_info_t *modeInfo = xcb_randr_get_screen_resources_current_modes(sr);
+    for (int i=0;i<xcb_randr_get_screen_resources_current_modes_length(sr);++i) {
+        modeTable[modeInfo[i].id] = modeInfo[i];
+    }
+    int outputCount = xcb_randr_get_screen_resources_current_outputs_length(sr);
+    xcb_randr_output_t *outputs = xcb_randr_get_screen_resources_current_outputs(sr);
+    QVector<xcb_randr_get_output_info_cookie_t> cookies(outputCount);
+    for (int i=0;i<outputCount;++i) {
+        cookies[i] = xcb_randr_get_output_info(conn, outputs[i], sr->config_timestamp);
+    }
+
+    bool found = false;
+    for (int i=0;i<outputCount;++i) {
+        xcb_randr_get_output_info_reply_t *info =
+                xcb_randr_get_output_info_reply(conn, cookies.at(i), NULL);
+        if (info == NULL) { continue; }
+        QString name = QString::fromUtf8((const char*)xcb_randr_get_output_info_name(info),
+                                         xcb_randr_get_output_info_name_length(info));
+        if (found || name != output || !info->crtc) {
+            free(info);
+            continue;
+        }
+        xcb_randr_get_crtc_info_reply_t *crtc =
+                xcb_randr_get_crtc_info_reply(conn,
+                                              xcb_randr_get_crtc_info(conn, info->crtc, sr->config_timestamp),
+                                              NULL);
+        if (crtc && crtc->mode && modeTable.contains(crtc->mode)) {
+            xcb_randr_mode_info_t current = modeTable.value(crtc->mode);
+            RefreshModes result;
+            result.output = outputs[i];
+            result.crtc = info->crtc;
+            result.timestamp = sr->config_timestamp;
+            result.current = crtc->mode;
+            result.x = crtc->x;
+            result.y = crtc->y;
+            result.rotation = crtc->rotation;
+            result.low = 0;
+            result.high = 0;
+            double lowRate = 0;
+            double highRate = 0;
+            xcb_randr_mode_t *available = xcb_randr_get_output_info_modes(info);
+            for (int m=0;m<xcb_randr_get_output_info_modes_length(info);++m) {
+                if (!modeTable.contains(available[m])) { continue; }
+                xcb_randr_mode_info_t mode = modeTable.value(available[m]);
+                if (mode.width != current.width ||
+                    mode.height != current.height ||
+                    (mode.mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE) !=
+                    (current.mode_flags & XCB_RANDR_MODE_FLAG_INTERLACE)) { continue; }
+                double rate = modeRate(mode);
+                if (!result.low || rate<lowRate) {
+                    result.low = mode.id;
+                    lowRate = rate;
+                }
+                if (rate>highRate) { highRate = rate; }
+            }
+            // restore to what the user had (kept if we shifted before the
+            // cache was rebuilt), a user running at the lowest rate is left alone
+            result.high = userModes.value(output, crtc->mode);
+            modes[output] = result;
+            found = true;
+            qDebug() << "refresh rates for" << output << lowRate << highRate;
+        }
+        if (crtc) { free(crtc); }
+        free(info);
+    }
+    free(sr);
+    return found;
+}
+
+// one set crtc config request, true if the output is now shifted
+// down (lowest) or back at the user's mode
+bool RefreshRate::setMode(const QString &output, bool lowest)
+{
+    if (!modes.contains(output) && !findModes(output)) { return false; }
+    for (int attempt=0;attempt<2;++attempt) {
+        RefreshModes cache = modes.value(output);
+        xcb_randr_mode_t mode = lowest?cache.low:cache.high;
+        if (!mode || cache.low == cache.high) { return false; }
+        if (mode == cache.current) {
+            if (lowest) { return false; } // not switched by us
+            userModes.remove(output);
+            return true;
+        }
+
+        xcb_connection_t *conn = XGetXCBConnection(_screens->display());
+        xcb_randr_output_t crtcOutput = cache.output;
+        xcb_randr_set_crtc_config_reply_t *reply =
+                xcb_randr_set_crtc_config_reply(conn,
+                                                xcb_randr_set_crtc_config(conn,
+                                                                          cache.crtc,
+                                                                          XCB_CURRENT_TIME,
+                                                                          cache.timestamp,
+                                                                          cache.x,
+                                                                          cache.y,
+                                                                          mode,
+                                                                          cache.rotation,
+                                                                          1,
+                                                                          &crtcOutput),
+                                                NULL);
+        int status = reply?reply->status:-1;
+        if (reply) { free(reply); }
+        if (status == XCB_RANDR_SET_CONFIG_SUCCESS) {
+            modes[output].current = mode;
+            if (!lowest) { userModes.remove(output); }
+            else if (!userModes.contains(output)) { userModes[output] = cache.current; }
+            qDebug() << "switched refresh rate" << output << (lowest?"low":"high");
+            return true;
+        }
+        // config changed behind our back, refresh cache and try again
+        qDebug() << "failed to switch refresh rate" << output << status;
+        modes.remove(output);
+        if (!findModes(output)) { return false; }
+    }
+    return false;
+}
+
+void RefreshRate::setLowest(bool lowest)
+{
+    wanted = lowest;
+    if (!lowest && !shifted) { // never touched, leave user mode alone
+        retry->stop();
+        return;
+    }
+    if (lowest == shifted) {
+        retry->stop();
+        return;
+    }
+    if (fullscreenActive()) {
+        qDebug() << "fullscreen client is active, delay refresh rate switch";
+        if (!retry->isActive()) { retry->start(); }
+        return;
+    }
+    retry->stop();
+    QString output = _screens?_screens->cachedInternal():QString();
+    if (output.isEmpty()) { return; }
+    if (setMode(output, lowest)) { shifted = lowest; }
+    // events read while waiting for replies
+    QTimer::singleShot(0, _screens, SLOT(handleEvents()));
+}
+
+void RefreshRate::retrySwitch()
+{
+    setLowest(wanted);
+}
+
+void RefreshRate::clearModes()
+{
+    if (shifted) { return; } // keep the mode to restore
+    modes.clear();
+}
+
+// keep cached crtc state current, forget output if user changed mode
+void RefreshRate::handleCrtcChanged(unsigned long crtc,
+                                    unsigned long mode,
+                                    int x,
+                                    int y,
+                                    int rotation)
+{
+    QMutableMapIterator<QString, RefreshModes> i(modes);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value().crtc != crtc) { continue; }
+        if (!mode || (mode != i.value().low && mode != i.value().high)) {
+            userModes.remove(i.key());
+            i.remove();
+            shifted = false;
+            continue;
+        }
+        i.value().current = mode;
+        i.value().x = x;
+        i.value().y = y;
+        i.value().rotation = rotation;
+    }
+}
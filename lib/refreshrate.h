@@ -0,0 +1,70 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef REFRESHRATE_H
+#define REFRESHRATE_H
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QTimer>
+
+#include "screens.h"
+
+#define REFRESH_RETRY_INTERVAL 30000 // ms between retries while fullscreen
+
+// candidate modes for an output (same resolution)
+struct RefreshModes
+{
+    unsigned long output;
+    unsigned long crtc;
+    unsigned long timestamp;
+    unsigned long low;
+    unsigned long high;
+    unsigned long current;
+    int x;
+    int y;
+    int rotation;
+};
+
+// switch an output to the lowest refresh rate at the current resolution
+class RefreshRate : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit RefreshRate(Screens *screens, QObject *parent = NULL);
+    bool isLowest();
+    bool fullscreenActive();
+
+private:
+    Screens *_screens;
+    QMap<QString, RefreshModes> modes;
+    QMap<QString, unsigned long> userModes; // to restore, kept across cache rebuilds
+    QTimer *retry;
+    bool shifted;
+    bool wanted;
+    unsigned long wmAtoms[3]; // active window, state, fullscreen
+
+    bool findModes(const QString &output);
+    bool setMode(const QString &output, bool lowest);
+
+public slots:
+    void setLowest(bool lowest);
+
+private slots:
+    void retrySwitch();
+    void clearModes();
+    void handleCrtcChanged(unsigned long crtc,
+                           unsigned long mode,
+                           int x,
+                           int y,
+                           int rotation);
+};
+
+#endif // REFRESHRATE_H
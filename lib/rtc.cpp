@@ -7,6 +7,9 @@
 */
 
 #include "rtc.h"
+#include "sysfsattribute.h"
+
+#include <QFile>
 
 #ifdef Q_OS_LINUX
 #include <linux/rtc.h>
@@ -14,55 +17,81 @@
 #include <sys/time.h>
 #include <sys/types.h>
 #include <fcntl.h>
+#include <string.h>
 #include <unistd.h>
-#define RTC_DEV "/dev/rtc"
-#endif
 
-bool RTC::setAlarm(const QDateTime &date)
+// RTC_WKALM_* on the rtc device, the RTC is expected to run in UTC
+static bool wakeAlarmDevice(const QDateTime &date, bool enabled)
 {
-#ifdef Q_OS_LINUX
-    if (!date.isValid() || date.isNull()) { return false; }
+    int fd = open(QFile::encodeName(SysfsAttribute::path(RTC_DEV)).constData(),
+                  O_RDONLY|O_CLOEXEC);
+    if (fd == -1) { return false; }
 
-    int fd, result = 0;
-    struct rtc_time rtc;
-
-    fd = open(RTC_DEV, O_RDONLY);
-    if (fd ==  -1) { return false; }
-
-    result = ioctl(fd, RTC_UIE_OFF, 0);
-    if (result == -1) {
+    struct rtc_wkalrm alarm;
+    memset(&alarm, 0, sizeof(alarm));
+    if (enabled) {
+        QDateTime utc = date.toUTC();
+        alarm.time.tm_year = utc.date().year()-1900;
+        alarm.time.tm_mon = utc.date().month()-1;
+        alarm.time.tm_mday = utc.date().day();
+        alarm.time.tm_hour = utc.time().hour();
+        alarm.time.tm_min = utc.time().minute();
+        alarm.time.tm_sec = utc.time().second();
+    } else if (ioctl(fd, RTC_WKALM_RD, &alarm) == -1) {
         close(fd);
         return false;
     }
+    alarm.time.tm_wday = -1;
+    alarm.time.tm_yday = -1;
+    alarm.time.tm_isdst = -1;
+    alarm.enabled = enabled?1:0;
+    alarm.pending = 0;
 
-    result = ioctl(fd, RTC_RD_TIME, &rtc);
-    if (result == -1) {
-        close(fd);
-        return false;
-    }
-
-    rtc.tm_year = date.date().year();
-    rtc.tm_mon = date.date().month();
-    rtc.tm_mday = date.date().day();
-    rtc.tm_hour = date.time().hour();
-    rtc.tm_min = date.time().minute();
-    rtc.tm_sec = date.time().second();
+    int result = ioctl(fd, RTC_WKALM_SET, &alarm);
+    close(fd);
+    return result != -1;
+}
+#endif
 
-    result = ioctl(fd, RTC_ALM_SET, &rtc);
-    if (result == -1) {
-        close(fd);
-        return false;
-    }
+// absolute alarm (no 24 hour limit)
+bool RTC::setAlarm(const QDateTime &date)
+{
+#ifdef Q_OS_LINUX
+    if (!date.isValid() || date.isNull()) { return false; }
 
-    result = ioctl(fd, RTC_AIE_ON, 0);
-    if (result == -1) {
-        close(fd);
-        return false;
+    // seconds since epoch, the kernel converts to RTC time.
+    // a set alarm must be cleared before it can be changed.
+    SysfsAttribute wakealarm(RTC_WAKEALARM);
+    if (wakealarm.isWritable()) {
+        if (!wakealarm.write(0)) { return false; }
+        return wakealarm.write(QByteArray::number((qulonglong)date.toTime_t()));
     }
+    return wakeAlarmDevice(date, true);
+#else
+    Q_UNUSED(date)
+    return false;
+#endif
+}
 
-    close(fd);
-    return true;
+bool RTC::clearAlarm()
+{
+#ifdef Q_OS_LINUX
+    SysfsAttribute wakealarm(RTC_WAKEALARM);
+    if (wakealarm.isWritable()) { return wakealarm.write(0); }
+    return wakeAlarmDevice(QDateTime(), false);
 #else
     return false;
 #endif
 }
+
+// programmed alarm (invalid if none)
+QDateTime RTC::alarm()
+{
+    QDateTime date;
+    QString value = SysfsAttribute::readString(RTC_WAKEALARM);
+    if (value.isEmpty()) { return date; }
+    bool ok = false;
+    uint seconds = value.toUInt(&ok);
+    if (ok && seconds>0) { date = QDateTime::fromTime_t(seconds); }
+    return date;
+}
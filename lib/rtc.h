@@ -11,10 +11,17 @@
 
 #include <QDateTime>
 
+#define RTC_DEV "/dev/rtc0"
+#define RTC_WAKEALARM "/sys/class/rtc/rtc0/wakealarm"
+
+// wake alarm through sysfs (wakealarm) or RTC_WKALM_SET,
+// both paths honour the sysfs root prefix (fake RTC)
 class RTC
 {
 public:
     static bool setAlarm(const QDateTime &date);
+    static bool clearAlarm();
+    static QDateTime alarm();
 };
 
 #endif // RTC_H
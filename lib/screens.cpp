@@ -8,28 +8,92 @@
 
 #include "screens.h"
 
+#include <QVector>
+#include <QDebug>
+
+#include <X11/Xlib-xcb.h>
+#include <X11/extensions/Xrandr.h>
+#include <xcb/randr.h>
+#include <stdlib.h>
+
+// get all outputs, the output info requests are sent at once
+// and the replies collected afterwards (one round trip)
+static void queryOutputs(Display *dpy,
+                         QMap<QString,bool> *result,
+                         QMap<unsigned long,QString> *names,
+                         QString *first)
+{
+    if (dpy == NULL) { return; }
+    xcb_connection_t *conn = XGetXCBConnection(dpy);
+    if (conn == NULL) { return; }
+
+    xcb_randr_get_screen_resources_current_cookie_t srCookie =
+            xcb_randr_get_screen_resources_current(conn, DefaultRootWindow(dpy));
+    xcb_randr_get_screen_resources_current_reply_t *sr =
+            xcb_randr_get_screen_resources_current_reply(conn, srCookie, NULL);
+    if (sr == NULL) { return; }
+
+    int count = xcb_randr_get_screen_resources_current_outputs_length(sr);
+    xcb_randr_output_t *outputs = xcb_randr_get_screen_resources_current_outputs(sr);
+    QVector<xcb_randr_get_output_info_cookie_t> cookies(count);
+    for (int i=0;i<count;++i) {
+        cookies[i] = xcb_randr_get_output_info(conn, outputs[i], sr->config_timestamp);
+    }
+    for (int i=0;i<count;++i) {
+        xcb_randr_get_output_info_reply_t *info =
+                xcb_randr_get_output_info_reply(conn, cookies.at(i), NULL);
+        if (info == NULL) { continue; }
+        QString output = QString::fromUtf8((const char*)xcb_randr_get_output_info_name(info),
+                                           xcb_randr_get_output_info_name_length(info));
+        bool screenConnected = false;
+        if (info->connection == XCB_RANDR_CONNECTION_CONNECTED) { screenConnected = true; }
+        if (result) { (*result)[output] = screenConnected; }
+        if (names) { (*names)[outputs[i]] = output; }
+        if (first && i == 0) { *first = output; }
+        free(info);
+    }
+    free(sr);
+}
+
+Screens::Screens(QObject *parent)
+    : QObject(parent)
+    , dpy(NULL)
+    , randrEvent(0)
+    , notifier(0)
+{
+    if ((dpy = XOpenDisplay(NULL)) == NULL) {
+        qWarning() << "failed to open X display";
+        return;
+    }
+    int randrError;
+    if (!XRRQueryExtension(dpy, &randrEvent, &randrError)) {
+        qWarning() << "no RandR extension";
+        XCloseDisplay(dpy);
+        dpy = NULL;
+        return;
+    }
+    XRRSelectInput(dpy,
+                   DefaultRootWindow(dpy),
+                   RROutputChangeNotifyMask|RRCrtcChangeNotifyMask|RRScreenChangeNotifyMask);
+    refresh();
+
+    notifier = new QSocketNotifier(ConnectionNumber(dpy),
+                                   QSocketNotifier::Read,
+                                   this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(handleEvents()));
+    handleEvents(); // anything queued while we did setup
+}
+
+Screens::~Screens()
+{
+    if (dpy) { XCloseDisplay(dpy); }
+}
+
 QMap<QString, bool> Screens::outputsDpy(Display *dpy)
 {
     QMap<QString,bool> result;
-    if (dpy == NULL) { return result; }
-    XRRScreenResources *sr;
-    XRROutputInfo *info;
-    sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
-    if (sr) {
-        for (int i = 0; i< sr->noutput;++i) {
-            info = XRRGetOutputInfo(dpy, sr, sr->outputs[i]);
-            if (info == NULL) {
-                XRRFreeOutputInfo(info);
-                continue;
-            }
-            QString output = info->name;
-            bool screenConnected = false;
-            if (info->connection == RR_Connected) { screenConnected = true; }
-            result[output] = screenConnected;
-            XRRFreeOutputInfo(info);
-        }
-    }
-    XRRFreeScreenResources(sr);
+    queryOutputs(dpy, &result, NULL, NULL);
     return result;
 }
 
@@ -46,15 +110,7 @@ QMap<QString, bool> Screens::outputs()
 QString Screens::internalDpy(Display *dpy)
 {
     QString result;
-    if (dpy == NULL) { return result; }
-    XRRScreenResources *sr;
-    sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
-    if (sr) {
-        XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, sr->outputs[0]);
-        if (info) { result = info->name; }
-        XRRFreeOutputInfo(info);
-    }
-    XRRFreeScreenResources(sr);
+    queryOutputs(dpy, NULL, NULL, &result);
     return result;
 }
 
@@ -67,3 +123,83 @@ QString Screens::internal()
     XCloseDisplay(dpy);
     return result;
 }
+
+bool Screens::isValid()
+{
+    return dpy != NULL;
+}
+
+Display *Screens::display()
+{
+    return dpy;
+}
+
+QMap<QString, bool> Screens::cachedOutputs()
+{
+    return connected;
+}
+
+QString Screens::cachedInternal()
+{
+    return internalOutput;
+}
+
+bool Screens::isConnected(const QString &output)
+{
+    return connected.value(output, false);
+}
+
+// rebuild output cache
+void Screens::refresh()
+{
+    if (dpy == NULL) { return; }
+    QMap<QString,bool> result;
+    QMap<unsigned long,QString> ids;
+    QString first;
+    queryOutputs(dpy, &result, &ids, &first);
+    names = ids;
+    internalOutput = first;
+    if (result == connected) { return; }
+    connected = result;
+    qDebug() << "outputs" << connected;
+    emit outputsChanged();
+}
+
+// update cache from RandR events (no round trips for known outputs)
+void Screens::handleEvents()
+{
+    if (dpy == NULL) { return; }
+    bool needRefresh = false;
+    bool changed = false;
+    while (XPending(dpy)) {
+        XEvent ev;
+        XNextEvent(dpy, &ev);
+        if (ev.type == randrEvent+RRScreenChangeNotify) {
+            XRRUpdateConfiguration(&ev);
+            needRefresh = true;
+            continue;
+        }
+        if (ev.type != randrEvent+RRNotify) { continue; }
+        XRRNotifyEvent *notify = (XRRNotifyEvent*)&ev;
+        if (notify->subtype == RRNotify_CrtcChange) {
+            XRRCrtcChangeNotifyEvent *crtc = (XRRCrtcChangeNotifyEvent*)&ev;
+            emit crtcChanged(crtc->crtc, crtc->mode, crtc->x, crtc->y, crtc->rotation);
+            continue;
+        }
+        if (notify->subtype != RRNotify_OutputChange) { continue; }
+        XRROutputChangeNotifyEvent *change = (XRROutputChangeNotifyEvent*)&ev;
+        if (!names.contains(change->output)) {
+            needRefresh = true;
+            continue;
+        }
+        QString output = names.value(change->output);
+        bool screenConnected = change->connection == RR_Connected;
+        if (connected.value(output) == screenConnected) { continue; }
+        connected[output] = screenConnected;
+        changed = true;
+        qDebug() << "output changed" << output << screenConnected;
+        emit outputChanged(output, screenConnected);
+    }
+    if (needRefresh) { refresh(); }
+    else if (changed) { emit outputsChanged(); }
+}
@@ -9,18 +9,51 @@
 #ifndef SCREENS_H
 #define SCREENS_H
 
+#include <QObject>
 #include <QMap>
 #include <QString>
+#include <QSocketNotifier>
 
-#include <X11/extensions/Xrandr.h>
+// no X11 headers here, they clash with Qt and users of this header
+typedef struct _XDisplay Display;
 
-class Screens
+// keeps one X connection and an output cache (updated from RandR events)
+class Screens : public QObject
 {
+    Q_OBJECT
+
 public:
+    explicit Screens(QObject *parent = NULL);
+    ~Screens();
     static QMap<QString,bool> outputsDpy(Display *dpy);
     static QMap<QString,bool> outputs();
     static QString internalDpy(Display *dpy);
     static QString internal();
+
+    bool isValid();
+    Display *display();
+    QMap<QString,bool> cachedOutputs();
+    QString cachedInternal();
+    bool isConnected(const QString &output);
+
+private:
+    Display *dpy;
+    int randrEvent;
+    QSocketNotifier *notifier;
+    QMap<unsigned long,QString> names;
+    QMap<QString,bool> connected;
+    QString internalOutput;
+
+signals:
+    void outputsChanged();
+    void outputChanged(const QString &output, bool connected);
+    void crtcChanged(unsigned long crtc, unsigned long mode, int x, int y, int rotation);
+
+public slots:
+    void refresh();
+
+private slots:
+    void handleEvents();
 };
 
 #endif // SCREENS_H
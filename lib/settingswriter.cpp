@@ -0,0 +1,97 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "settingswriter.h"
+#include "common.h"
+#include "def.h"
+
+#include <QFile>
+#include <QSettings>
+#include <QMapIterator>
+#include <QDebug>
+
+#include <stdio.h>
+#include <unistd.h>
+
+SettingsWriter::SettingsWriter(QObject *parent) : QObject(parent)
+{
+    timer.setSingleShot(true);
+    timer.setInterval(CONF_WRITE_DELAY);
+    connect(&timer, SIGNAL(timeout()),
+            this, SLOT(flush()));
+}
+
+SettingsWriter::~SettingsWriter()
+{
+    flush();
+}
+
+bool SettingsWriter::hasPending()
+{
+    return !pending.isEmpty();
+}
+
+void SettingsWriter::setValue(const QString &type, const QVariant &value)
+{
+    if (Common::lockedPowerSettings(type)) {
+        qWarning() << "setting is locked by the system administrator" << type;
+        return;
+    }
+    pending[type] = value;
+    timer.start(); // restart quiet period
+}
+
+bool SettingsWriter::flush()
+{
+    timer.stop();
+    if (pending.isEmpty()) { return true; }
+
+    QString config = Common::confFile();
+    QString temp = QString("%1.tmp").arg(config);
+    QFile::remove(temp);
+
+    // write current + pending settings to a temp file
+    {
+        QSettings current(config, QSettings::IniFormat);
+        QSettings settings(temp, QSettings::IniFormat);
+        foreach (QString key, current.allKeys()) {
+            settings.setValue(key, current.value(key));
+        }
+        QMapIterator<QString, QVariant> i(pending);
+        while (i.hasNext()) {
+            i.next();
+            settings.setValue(i.key(), i.value());
+        }
+        settings.sync();
+        if (settings.status() != QSettings::NoError) {
+            qWarning() << "failed to write settings" << temp;
+            QFile::remove(temp);
+            return false;
+        }
+    }
+
+    // make sure data is on disk before we replace the old file
+    QFile tempFile(temp);
+    if (tempFile.open(QIODevice::ReadOnly)) {
+        fsync(tempFile.handle());
+        tempFile.close();
+    }
+    if (rename(QFile::encodeName(temp).constData(),
+               QFile::encodeName(config).constData()) != 0) {
+        qWarning() << "failed to replace settings" << config;
+        QFile::remove(temp);
+        return false;
+    }
+
+    Common::invalidatePowerSettings();
+    QStringList keys = pending.keys();
+    pending.clear();
+    qDebug() << "settings written" << keys;
+    emit flushed(keys);
+    return true;
+}
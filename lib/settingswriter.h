@@ -0,0 +1,42 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SETTINGSWRITER_H
+#define SETTINGSWRITER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVariant>
+
+// collects settings changes and writes them in one go
+// after a short quiet period (replaces the old file atomically)
+class SettingsWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SettingsWriter(QObject *parent = NULL);
+    ~SettingsWriter();
+    bool hasPending();
+
+private:
+    QTimer timer;
+    QMap<QString, QVariant> pending;
+
+signals:
+    void flushed(const QStringList &keys);
+
+public slots:
+    void setValue(const QString &type, const QVariant &value);
+    bool flush();
+};
+
+#endif // SETTINGSWRITER_H
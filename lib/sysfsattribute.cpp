@@ -0,0 +1,198 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "sysfsattribute.h"
+
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QFile>
+#include <QDebug>
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+static QString sysfsRoot;
+static bool sysfsRootValid = false;
+
+// shared attributes
+static QMap<QString, SysfsAttribute*> sharedAttributes;
+static QMutex sharedMutex;
+
+SysfsAttribute::SysfsAttribute(const QString &path, QObject *parent)
+    : QObject(parent)
+    , file(path)
+    , fd(-1)
+    , writable(false)
+    , notifier(0)
+{
+    openFile();
+}
+
+SysfsAttribute::~SysfsAttribute()
+{
+    closeFile();
+}
+
+void SysfsAttribute::setRoot(const QString &root)
+{
+    sysfsRoot = root;
+    sysfsRootValid = true;
+}
+
+QString SysfsAttribute::root()
+{
+    if (!sysfsRootValid) {
+        sysfsRoot = QString::fromLocal8Bit(qgetenv(SYSFS_ROOT_ENV));
+        sysfsRootValid = true;
+    }
+    return sysfsRoot;
+}
+
+// real path of a sysfs path (root prefix added)
+QString SysfsAttribute::path(const QString &path)
+{
+    QString prefix = root();
+    if (prefix.isEmpty()) { return path; }
+    return prefix+path;
+}
+
+// process wide instance for path, reopened if the device went away
+SysfsAttribute *SysfsAttribute::shared(const QString &path)
+{
+    QMutexLocker lock(&sharedMutex);
+    SysfsAttribute *attribute = sharedAttributes.value(path);
+    if (attribute && attribute->isValid()) { return attribute; }
+    if (attribute) { delete attribute; }
+    attribute = new SysfsAttribute(path);
+    sharedAttributes[path] = attribute;
+    return attribute;
+}
+
+QString SysfsAttribute::readString(const QString &path)
+{
+    SysfsAttribute attribute(path);
+    return attribute.toString();
+}
+
+int SysfsAttribute::readInt(const QString &path, int fallback)
+{
+    SysfsAttribute attribute(path);
+    return attribute.toInt(fallback);
+}
+
+bool SysfsAttribute::isValid()
+{
+    return fd>=0;
+}
+
+bool SysfsAttribute::isWritable()
+{
+    return fd>=0 && writable;
+}
+
+QString SysfsAttribute::fileName()
+{
+    return file;
+}
+
+QString SysfsAttribute::toString()
+{
+    char buffer[SYSFS_BUFFER_SIZE];
+    int length = readBuffer(buffer, sizeof(buffer));
+    if (length<0) { return QString(); }
+    return QString::fromLatin1(buffer, length).trimmed();
+}
+
+int SysfsAttribute::toInt(int fallback)
+{
+    char buffer[SYSFS_BUFFER_SIZE];
+    if (readBuffer(buffer, sizeof(buffer))<=0) { return fallback; }
+    char *end = NULL;
+    long value = strtol(buffer, &end, 10);
+    if (end == buffer) { return fallback; }
+    return (int)value;
+}
+
+bool SysfsAttribute::write(const QByteArray &value)
+{
+    if (!isWritable() && !openFile()) { return false; }
+    if (!writable) { return false; }
+    ssize_t length = pwrite(fd, value.constData(), value.size(), 0);
+    if (length == value.size()) { return true; }
+    if (length<0 && errno == ENODEV) { closeFile(); }
+    qWarning() << "failed to write" << file << value;
+    return false;
+}
+
+bool SysfsAttribute::write(int value)
+{
+    char buffer[SYSFS_BUFFER_SIZE];
+    int length = snprintf(buffer, sizeof(buffer), "%d", value);
+    return write(QByteArray::fromRawData(buffer, length));
+}
+
+// report changes (only for attributes the kernel notifies on)
+bool SysfsAttribute::watch()
+{
+    if (notifier) { return true; }
+    if (!isValid() && !openFile()) { return false; }
+    char buffer[SYSFS_BUFFER_SIZE];
+    readBuffer(buffer, sizeof(buffer)); // arm
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Exception, this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(handleNotify()));
+    return true;
+}
+
+bool SysfsAttribute::openFile()
+{
+    closeFile();
+    QByteArray real = QFile::encodeName(path(file));
+    fd = open(real.constData(), O_RDWR|O_CLOEXEC);
+    writable = fd>=0;
+    if (fd<0) { fd = open(real.constData(), O_RDONLY|O_CLOEXEC); }
+    return fd>=0;
+}
+
+void SysfsAttribute::closeFile()
+{
+    if (notifier) {
+        notifier->setEnabled(false);
+        notifier->deleteLater();
+        notifier = 0;
+    }
+    if (fd>=0) { close(fd); }
+    fd = -1;
+    writable = false;
+}
+
+// read whole attribute into buffer (nul terminated)
+int SysfsAttribute::readBuffer(char *buffer, int size)
+{
+    buffer[0] = '\0';
+    if (!isValid() && !openFile()) { return -1; }
+    ssize_t length = pread(fd, buffer, size-1, 0);
+    if (length<0) {
+        if (errno == ENODEV) { closeFile(); }
+        return -1;
+    }
+    buffer[length] = '\0';
+    return length;
+}
+
+void SysfsAttribute::handleNotify()
+{
+    char buffer[SYSFS_BUFFER_SIZE];
+    readBuffer(buffer, sizeof(buffer)); // rearm
+    emit changed(file);
+}
@@ -0,0 +1,62 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SYSFSATTRIBUTE_H
+#define SYSFSATTRIBUTE_H
+
+#include <QObject>
+#include <QString>
+#include <QByteArray>
+#include <QSocketNotifier>
+
+#define SYSFS_ROOT_ENV "POWERKIT_SYSFS_ROOT" // prefix for fixture trees
+#define SYSFS_BUFFER_SIZE 64
+
+// sysfs attribute kept open, read with pread() and written with pwrite().
+// watch() reports sysfs_notify() changes (POLLPRI).
+class SysfsAttribute : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SysfsAttribute(const QString &path, QObject *parent = NULL);
+    ~SysfsAttribute();
+    static void setRoot(const QString &root);
+    static QString root();
+    static QString path(const QString &path);
+    static SysfsAttribute *shared(const QString &path);
+    static QString readString(const QString &path);
+    static int readInt(const QString &path, int fallback = 0);
+
+    bool isValid();
+    bool isWritable();
+    QString fileName();
+    QString toString();
+    int toInt(int fallback = 0);
+    bool write(const QByteArray &value);
+    bool write(int value);
+    bool watch();
+
+private:
+    QString file;
+    int fd;
+    bool writable;
+    QSocketNotifier *notifier;
+
+    bool openFile();
+    void closeFile();
+    int readBuffer(char *buffer, int size);
+
+signals:
+    void changed(const QString &path);
+
+private slots:
+    void handleNotify();
+};
+
+#endif // SYSFSATTRIBUTE_H
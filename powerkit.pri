@@ -28,4 +28,4 @@ CONFIG(release, debug|release) {
     CONFIG += staticlib
 }
 
-LIBS += -lX11 -lXss -lXrandr
+LIBS += -lX11 -lXss -lXrandr -lX11-xcb -lxcb -lxcb-randr
@@ -11,3 +11,8 @@ CONFIG -= ordered
 SUBDIRS += lib app daemon
 app.depends += lib
 daemon.depends += lib
+
+CONFIG(tests) {
+    SUBDIRS += tests
+    tests.depends += lib
+}
@@ -0,0 +1,22 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT -= gui
+TARGET = tst_daemonstate
+include(../tests.pri)
+
+INCLUDEPATH += ../../daemon
+SOURCES += tst_daemonstate.cpp \
+    ../../daemon/manager.cpp \
+    ../../daemon/workqueue.cpp \
+    ../../daemon/state.cpp \
+    ../../daemon/scheduler.cpp
+HEADERS += ../../daemon/manager.h \
+    ../../daemon/workqueue.h \
+    ../../daemon/state.h \
+    ../../daemon/scheduler.h
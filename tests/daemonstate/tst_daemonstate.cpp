@@ -0,0 +1,155 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QElapsedTimer>
+#include <QSettings>
+
+#include "manager.h"
+#include "sysfsattribute.h"
+#include "backlight.h"
+#include "rtc.h"
+
+#define TEST_BACKLIGHT "/sys/class/backlight/test"
+#define TEST_WAKE_ENTRIES 64
+
+// powerkitd started by the bus with a state file from the last run,
+// sysfs (backlight and RTC) and the boot id/uptime are a fixture tree
+class TestDaemonState : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir root;
+    QString stateFile;
+    void writeFixture(const QString &path, const QByteArray &value);
+    void writeState(int light, bool otherBoot);
+
+private slots:
+    void initTestCase();
+    void roundTrip();
+    void startupBudget();
+    void restoreBacklightOnBoot();
+    void keepBacklightLateInBoot();
+    void keepBacklightSameBoot();
+};
+
+void TestDaemonState::writeFixture(const QString &path, const QByteArray &value)
+{
+    QString file = SysfsAttribute::path(path);
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    QFile fixture(file);
+    QVERIFY(fixture.open(QIODevice::WriteOnly|QIODevice::Truncate));
+    fixture.write(value);
+}
+
+void TestDaemonState::writeState(int light, bool otherBoot)
+{
+    QFile::remove(stateFile);
+    QStringList entries;
+    QDateTime date = QDateTime::currentDateTime().addDays(1);
+    for (int i=1;i<=TEST_WAKE_ENTRIES;++i) {
+        entries << QString("%1;%2;%3;%4;%5")
+                   .arg(i)
+                   .arg(i%4?1000:0) // actions are root only
+                   .arg(date.addSecs(i*60).toString(WAKE_DATE_FORMAT))
+                   .arg(i%4?0:86400)
+                   .arg(i%4?WAKE_ACTION_NONE:WAKE_ACTION_MAINTENANCE);
+    }
+    DaemonState state(stateFile);
+    state.setWakeEntries(entries);
+    state.setBacklight(TEST_BACKLIGHT, light);
+    QVERIFY(state.save());
+    if (otherBoot) {
+        QSettings settings(stateFile, QSettings::IniFormat);
+        settings.setValue("boot", "00000000-0000-0000-0000-000000000000");
+    }
+}
+
+void TestDaemonState::initTestCase()
+{
+    QVERIFY(root.isValid());
+    stateFile = QString("%1/state").arg(root.path());
+    SysfsAttribute::setRoot(root.path());
+    writeFixture(QString("%1/type").arg(TEST_BACKLIGHT), "raw\n");
+    writeFixture(QString("%1/max_brightness").arg(TEST_BACKLIGHT), "99\n");
+    writeFixture(QString("%1/brightness").arg(TEST_BACKLIGHT), "10\n");
+    writeFixture(RTC_WAKEALARM, "");
+    writeFixture(DAEMON_BOOT_ID, "6f0c3c6e-5d1b-4f4e-9a63-2f1b8f0d7c11\n");
+    writeFixture(DAEMON_UPTIME, "30.00 60.00\n");
+    Backlight::invalidate();
+    QVERIFY(Backlight::contains(TEST_BACKLIGHT));
+}
+
+void TestDaemonState::roundTrip()
+{
+    writeState(42, false);
+    DaemonState state(stateFile);
+    QVERIFY(state.load());
+    QVERIFY(!state.isDirty());
+    QCOMPARE(state.wakeEntries().size(), TEST_WAKE_ENTRIES);
+    QCOMPARE(state.backlight().value(TEST_BACKLIGHT), 42);
+}
+
+// state load and re-arming the scheduler, see main.cpp
+void TestDaemonState::startupBudget()
+{
+    writeState(42, false);
+    QElapsedTimer startup;
+    startup.start();
+    Manager man(stateFile);
+    man.setIdleTimeout(0);
+    qint64 elapsed = startup.elapsed();
+    QCOMPARE(man.wakeAlarms().size(), TEST_WAKE_ENTRIES);
+    QVERIFY2(elapsed <= DAEMON_STARTUP_BUDGET,
+             qPrintable(QString("startup took %1 ms").arg(elapsed)));
+}
+
+// activated right after boot
+void TestDaemonState::restoreBacklightOnBoot()
+{
+    writeFixture(DAEMON_UPTIME, "30.00 60.00\n");
+    writeFixture(QString("%1/brightness").arg(TEST_BACKLIGHT), "10\n");
+    writeState(60, true);
+    Manager man(stateFile);
+    man.setIdleTimeout(0);
+    QTRY_COMPARE(SysfsAttribute::readInt(QString("%1/brightness").arg(TEST_BACKLIGHT)), 60);
+}
+
+// first activated hours later (suspend sets a wake alarm), the
+// values from the last boot are stale by then
+void TestDaemonState::keepBacklightLateInBoot()
+{
+    writeFixture(DAEMON_UPTIME, "7200.00 14000.00\n");
+    writeFixture(QString("%1/brightness").arg(TEST_BACKLIGHT), "20\n");
+    writeState(60, true);
+    {
+        Manager man(stateFile);
+        man.setIdleTimeout(0);
+        QTest::qWait(100);
+    } // queue done
+    QCOMPARE(SysfsAttribute::readInt(QString("%1/brightness").arg(TEST_BACKLIGHT)), 20);
+}
+
+// later activations leave changes made while we were gone alone
+void TestDaemonState::keepBacklightSameBoot()
+{
+    writeFixture(DAEMON_UPTIME, "30.00 60.00\n");
+    writeFixture(QString("%1/brightness").arg(TEST_BACKLIGHT), "20\n");
+    writeState(60, false);
+    {
+        Manager man(stateFile);
+        man.setIdleTimeout(0);
+        QTest::qWait(100);
+    } // queue done
+    QCOMPARE(SysfsAttribute::readInt(QString("%1/brightness").arg(TEST_BACKLIGHT)), 20);
+}
+
+QTEST_GUILESS_MAIN(TestDaemonState)
+#include "tst_daemonstate.moc"
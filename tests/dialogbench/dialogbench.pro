@@ -0,0 +1,23 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT += gui
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+TARGET = tst_dialogbench
+include(../tests.pri)
+
+INCLUDEPATH += ../../app
+SOURCES += tst_dialogbench.cpp \
+    ../../app/dialog.cpp \
+    ../../app/theme.cpp \
+    ../../app/devicemodel.cpp \
+    ../../app/batteryicons.cpp
+HEADERS += ../../app/dialog.h \
+    ../../app/theme.h \
+    ../../app/devicemodel.h \
+    ../../app/batteryicons.h
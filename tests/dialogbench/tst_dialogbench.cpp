@@ -0,0 +1,63 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QtTest>
+#include <QTemporaryDir>
+#include <QTabWidget>
+#include <QScrollArea>
+
+#include "dialog.h"
+
+// time from constructing the config dialog until it is on screen,
+// and until the (lazy) settings tab is built
+class DialogBench : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir home;
+
+private slots:
+    void initTestCase();
+    void open();
+    void openSettings();
+};
+
+// keep the user config and cache out of it
+void DialogBench::initTestCase()
+{
+    QVERIFY(home.isValid());
+    qputenv("HOME", home.path().toLocal8Bit());
+    qputenv("XDG_CACHE_HOME", QString("%1/.cache").arg(home.path()).toLocal8Bit());
+}
+
+void DialogBench::open()
+{
+    QBENCHMARK {
+        Dialog dialog;
+        dialog.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&dialog));
+    }
+}
+
+void DialogBench::openSettings()
+{
+    QBENCHMARK {
+        Dialog dialog;
+        dialog.show();
+        QVERIFY(QTest::qWaitForWindowExposed(&dialog));
+        QTabWidget *tabs = dialog.findChild<QTabWidget*>();
+        QScrollArea *settings = dialog.findChild<QScrollArea*>();
+        QVERIFY(tabs && settings);
+        tabs->setCurrentWidget(settings);
+        QCoreApplication::processEvents();
+    }
+}
+
+QTEST_MAIN(DialogBench)
+#include "tst_dialogbench.moc"
@@ -0,0 +1,13 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT -= gui
+TARGET = tst_refreshrate
+include(../tests.pri)
+
+SOURCES += tst_refreshrate.cpp
@@ -0,0 +1,191 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QtTest>
+
+#include "screens.h"
+#include "refreshrate.h"
+
+#include <X11/Xlib-xcb.h>
+#include <xcb/randr.h>
+#include <stdlib.h>
+
+// fix X11 inc
+#undef Bool
+#undef Status
+#undef None
+
+#define TEST_WIDTH 1000 // unused by Xvfb, so only our modes match
+#define TEST_HEIGHT 700
+
+// runs against Xvfb (xvfb-run), modes are added to its output
+class TestRefreshRate : public QObject
+{
+    Q_OBJECT
+
+private:
+    Screens *screens;
+    xcb_connection_t *conn;
+    xcb_window_t root;
+    xcb_randr_output_t output;
+    xcb_randr_crtc_t crtc;
+    xcb_randr_mode_t mode30;
+    xcb_randr_mode_t mode60;
+    xcb_randr_mode_t mode75;
+
+    xcb_randr_mode_t addMode(int rate, const char *name);
+    bool setCrtc(xcb_randr_mode_t mode);
+    xcb_randr_mode_t crtcMode();
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void restoreUserMode();
+    void restoreWhenStartedLow();
+};
+
+xcb_randr_mode_t TestRefreshRate::addMode(int rate, const char *name)
+{
+    xcb_randr_mode_info_t info;
+    memset(&info, 0, sizeof(info));
+    info.width = TEST_WIDTH;
+    info.height = TEST_HEIGHT;
+    info.hsync_start = info.hsync_end = info.htotal = TEST_WIDTH;
+    info.vsync_start = info.vsync_end = info.vtotal = TEST_HEIGHT;
+    info.dot_clock = rate*TEST_WIDTH*TEST_HEIGHT;
+    info.name_len = strlen(name);
+    xcb_randr_create_mode_reply_t *reply =
+            xcb_randr_create_mode_reply(conn,
+                                        xcb_randr_create_mode(conn, root, info, info.name_len, name),
+                                        NULL);
+    if (!reply) { return 0; }
+    xcb_randr_mode_t mode = reply->mode;
+    free(reply);
+    xcb_void_cookie_t cookie = xcb_randr_add_output_mode_checked(conn, output, mode);
+    xcb_generic_error_t *error = xcb_request_check(conn, cookie);
+    if (error) {
+        free(error);
+        return 0;
+    }
+    return mode;
+}
+
+bool TestRefreshRate::setCrtc(xcb_randr_mode_t mode)
+{
+    xcb_randr_get_screen_resources_current_reply_t *sr =
+            xcb_randr_get_screen_resources_current_reply(conn,
+                                                         xcb_randr_get_screen_resources_current(conn, root),
+                                                         NULL);
+    if (!sr) { return false; }
+    xcb_randr_set_crtc_config_reply_t *reply =
+            xcb_randr_set_crtc_config_reply(conn,
+                                            xcb_randr_set_crtc_config(conn,
+                                                                      crtc,
+                                                                      XCB_CURRENT_TIME,
+                                                                      sr->config_timestamp,
+                                                                      0,
+                                                                      0,
+                                                                      mode,
+                                                                      XCB_RANDR_ROTATION_ROTATE_0,
+                                                                      1,
+                                                                      &output),
+                                            NULL);
+    free(sr);
+    bool result = reply && reply->status == XCB_RANDR_SET_CONFIG_SUCCESS;
+    if (reply) { free(reply); }
+    return result;
+}
+
+xcb_randr_mode_t TestRefreshRate::crtcMode()
+{
+    xcb_randr_get_crtc_info_reply_t *info =
+            xcb_randr_get_crtc_info_reply(conn,
+                                          xcb_randr_get_crtc_info(conn, crtc, XCB_CURRENT_TIME),
+                                          NULL);
+    if (!info) { return 0; }
+    xcb_randr_mode_t mode = info->mode;
+    free(info);
+    return mode;
+}
+
+void TestRefreshRate::initTestCase()
+{
+    screens = new Screens();
+    if (!screens->isValid()) { QSKIP("no X display with RandR, use xvfb-run"); }
+    conn = XGetXCBConnection(screens->display());
+    root = DefaultRootWindow(screens->display());
+
+    // the internal output is the first one (see Screens)
+    output = 0;
+    crtc = 0;
+    xcb_randr_get_screen_resources_current_reply_t *sr =
+            xcb_randr_get_screen_resources_current_reply(conn,
+                                                         xcb_randr_get_screen_resources_current(conn, root),
+                                                         NULL);
+    QVERIFY(sr);
+    if (xcb_randr_get_screen_resources_current_outputs_length(sr)>0) {
+        output = xcb_randr_get_screen_resources_current_outputs(sr)[0];
+        xcb_randr_get_output_info_reply_t *info =
+                xcb_randr_get_output_info_reply(conn,
+                                                xcb_randr_get_output_info(conn, output, sr->config_timestamp),
+                                                NULL);
+        if (info) {
+            crtc = info->crtc;
+            free(info);
+        }
+    }
+    free(sr);
+    if (!output || !crtc) { QSKIP("no active output"); }
+
+    mode30 = addMode(30, "powerkit-test-30");
+    mode60 = addMode(60, "powerkit-test-60");
+    mode75 = addMode(75, "powerkit-test-75");
+    if (!mode30 || !mode60 || !mode75) { QSKIP("server does not allow new modes"); }
+}
+
+void TestRefreshRate::cleanupTestCase()
+{
+    delete screens;
+}
+
+// back on AC the mode the user had is used, not the highest
+void TestRefreshRate::restoreUserMode()
+{
+    QVERIFY(setCrtc(mode60));
+    QCoreApplication::processEvents();
+
+    RefreshRate rate(screens);
+    rate.setLowest(true);
+    QVERIFY(rate.isLowest());
+    QCOMPARE(crtcMode(), mode30);
+    QCoreApplication::processEvents();
+
+    rate.setLowest(false);
+    QVERIFY(!rate.isLowest());
+    QCOMPARE(crtcMode(), mode60);
+}
+
+// the user already runs at the lowest rate, nothing to shift or restore
+void TestRefreshRate::restoreWhenStartedLow()
+{
+    QVERIFY(setCrtc(mode30));
+    QCoreApplication::processEvents();
+
+    RefreshRate rate(screens);
+    rate.setLowest(true);
+    QVERIFY(!rate.isLowest());
+    QCOMPARE(crtcMode(), mode30);
+    QCoreApplication::processEvents();
+
+    rate.setLowest(false);
+    QVERIFY(!rate.isLowest());
+    QCOMPARE(crtcMode(), mode30);
+}
+
+QTEST_GUILESS_MAIN(TestRefreshRate)
+#include "tst_refreshrate.moc"
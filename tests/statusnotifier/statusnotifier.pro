@@ -0,0 +1,15 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT += gui
+TARGET = tst_statusnotifier
+include(../tests.pri)
+
+INCLUDEPATH += ../../app
+SOURCES += tst_statusnotifier.cpp ../../app/statusnotifier.cpp
+HEADERS += ../../app/statusnotifier.h
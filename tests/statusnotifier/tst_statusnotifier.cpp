@@ -0,0 +1,180 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QtTest>
+#include <QDBusConnection>
+#include <QDBusConnectionInterface>
+#include <QPixmap>
+
+#include "statusnotifier.h"
+
+// local stand-in for org.kde.StatusNotifierWatcher,
+// run the test on a private bus (dbus-run-session)
+class FakeWatcher : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", SNI_WATCHER_INTERFACE)
+    Q_PROPERTY(bool IsStatusNotifierHostRegistered READ isHostRegistered)
+
+public:
+    FakeWatcher() : host(false) {}
+    bool isHostRegistered() const { return host; }
+    void setHost(bool registered)
+    {
+        host = registered;
+        if (host) { emit StatusNotifierHostRegistered(); }
+    }
+    QStringList items;
+
+private:
+    bool host;
+
+signals:
+    void StatusNotifierHostRegistered();
+
+public slots:
+    void RegisterStatusNotifierItem(const QString &service) { items << service; }
+};
+
+class TestStatusNotifier : public QObject
+{
+    Q_OBJECT
+
+private:
+    FakeWatcher *watcher;
+    bool startWatcher();
+    void stopWatcher();
+    bool itemOnBus();
+
+private slots:
+    void initTestCase();
+    void cleanup();
+    void noWatcher();
+    void noHost();
+    void hostRegisteredLater();
+    void iconName();
+    void newIconOnChange();
+};
+
+bool TestStatusNotifier::startWatcher()
+{
+    QDBusConnection session = QDBusConnection::sessionBus();
+    watcher = new FakeWatcher();
+    if (!session.registerObject(SNI_WATCHER_PATH,
+                                watcher,
+                                QDBusConnection::ExportAllSlots|
+                                QDBusConnection::ExportAllSignals|
+                                QDBusConnection::ExportAllProperties)) { return false; }
+    return session.registerService(SNI_WATCHER_SERVICE);
+}
+
+void TestStatusNotifier::stopWatcher()
+{
+    if (!watcher) { return; }
+    QDBusConnection session = QDBusConnection::sessionBus();
+    session.unregisterService(SNI_WATCHER_SERVICE);
+    session.unregisterObject(SNI_WATCHER_PATH);
+    delete watcher;
+    watcher = 0;
+}
+
+bool TestStatusNotifier::itemOnBus()
+{
+    return QDBusConnection::sessionBus().objectRegisteredAt(SNI_PATH) != 0;
+}
+
+void TestStatusNotifier::initTestCase()
+{
+    watcher = 0;
+    QDBusConnection session = QDBusConnection::sessionBus();
+    if (!session.isConnected()) { QSKIP("no session bus"); }
+    if (session.interface()->isServiceRegistered(SNI_WATCHER_SERVICE)) {
+        QSKIP("a status notifier watcher is running, use dbus-run-session");
+    }
+}
+
+void TestStatusNotifier::cleanup()
+{
+    stopWatcher();
+}
+
+void TestStatusNotifier::noWatcher()
+{
+    StatusNotifierItem item;
+    QVERIFY(!item.registerItem());
+    QVERIFY(!itemOnBus());
+}
+
+// a failed registration must not leave the item on the bus
+void TestStatusNotifier::noHost()
+{
+    QVERIFY(startWatcher());
+    StatusNotifierItem item;
+    QVERIFY(!item.registerItem());
+    QVERIFY(!item.isRegistered());
+    QVERIFY(!itemOnBus());
+    QVERIFY(watcher->items.isEmpty());
+}
+
+// watcher up at login, host (panel) shows up afterwards
+void TestStatusNotifier::hostRegisteredLater()
+{
+    QVERIFY(startWatcher());
+    StatusNotifierItem item;
+    QVERIFY(!item.registerItem());
+
+    QSignalSpy spy(&item, SIGNAL(hostRegistered()));
+    watcher->setHost(true);
+    QTRY_VERIFY(spy.count() > 0);
+    QVERIFY(item.registerItem());
+    QVERIFY(itemOnBus());
+    QCOMPARE(watcher->items.size(), 1);
+}
+
+// theme name for the host, the rendered icon as a fallback
+void TestStatusNotifier::iconName()
+{
+    StatusNotifierItem item;
+    QPixmap pixmap(22, 22);
+    pixmap.fill(Qt::red);
+    item.setIcon("battery-good", QIcon(pixmap));
+    QCOMPARE(item.iconName(), QString("battery-good"));
+    QVERIFY(!item.iconPixmap().isEmpty());
+
+    item.setIcon("ac-adapter", QIcon());
+    QCOMPARE(item.iconName(), QString("ac-adapter"));
+}
+
+void TestStatusNotifier::newIconOnChange()
+{
+    StatusNotifierItem item;
+    QSignalSpy spy(&item, SIGNAL(NewIcon()));
+    QPixmap pixmap(22, 22);
+    pixmap.fill(Qt::red);
+    QIcon icon(pixmap);
+    item.setIcon("battery-good", icon);
+    item.setIcon("battery-good", icon);
+    QCOMPARE(spy.count(), 1);
+
+    // 1% steps within the same theme icon are not announced
+    QPixmap next(22, 22);
+    next.fill(Qt::green);
+    item.setIcon("battery-good", QIcon(next));
+    QCOMPARE(spy.count(), 1);
+
+    item.setIcon("ac-adapter", QIcon());
+    QCOMPARE(spy.count(), 2);
+
+    // without a name the pixmap is all the host has
+    item.setIcon(QString(), icon);
+    item.setIcon(QString(), QIcon(next));
+    QCOMPARE(spy.count(), 4);
+}
+
+QTEST_MAIN(TestStatusNotifier)
+#include "tst_statusnotifier.moc"
@@ -0,0 +1,16 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2018, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT += testlib dbus
+CONFIG += testcase console
+CONFIG -= app_bundle
+TEMPLATE = app
+
+LIBS += -L$$OUT_PWD/../../lib -lPowerKit
+INCLUDEPATH += $$PWD/../lib
+include($$PWD/../powerkit.pri)
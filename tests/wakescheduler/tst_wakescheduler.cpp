@@ -0,0 +1,236 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QtTest>
+#include <QTemporaryDir>
+
+#include "scheduler.h"
+#include "sysfsattribute.h"
+#include "rtc.h"
+
+// the RTC is a fixture wakealarm file, emptied before each step
+// (a regular file keeps the tail of longer values)
+class TestWakeScheduler : public QObject
+{
+    Q_OBJECT
+
+private:
+    QTemporaryDir root;
+    WorkQueue *queue;
+    WakeScheduler *scheduler;
+    void resetAlarm();
+    QByteArray alarm();
+    QByteArray stamp(const QDateTime &date);
+    bool settle();
+
+private slots:
+    void initTestCase();
+    void init();
+    void cleanup();
+    void add();
+    void cancel();
+    void replace();
+    void check();
+    void farPast();
+    void rootActions();
+};
+
+void TestWakeScheduler::resetAlarm()
+{
+    QFile fixture(SysfsAttribute::path(RTC_WAKEALARM));
+    QVERIFY(fixture.open(QIODevice::WriteOnly|QIODevice::Truncate));
+}
+
+QByteArray TestWakeScheduler::alarm()
+{
+    QFile fixture(SysfsAttribute::path(RTC_WAKEALARM));
+    if (!fixture.open(QIODevice::ReadOnly)) { return QByteArray(); }
+    return fixture.readAll().trimmed();
+}
+
+QByteArray TestWakeScheduler::stamp(const QDateTime &date)
+{
+    return QByteArray::number((qulonglong)date.toTime_t());
+}
+
+// alarm jobs are done
+bool TestWakeScheduler::settle()
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (!queue->isIdle() && timer.elapsed()<5000) { QTest::qWait(10); }
+    return queue->isIdle();
+}
+
+void TestWakeScheduler::initTestCase()
+{
+    QVERIFY(root.isValid());
+    SysfsAttribute::setRoot(root.path());
+    QVERIFY(QDir().mkpath(QFileInfo(SysfsAttribute::path(RTC_WAKEALARM)).absolutePath()));
+}
+
+void TestWakeScheduler::init()
+{
+    resetAlarm();
+    queue = new WorkQueue();
+    scheduler = new WakeScheduler(queue);
+}
+
+void TestWakeScheduler::cleanup()
+{
+    delete scheduler;
+    delete queue;
+}
+
+// the RTC holds the earliest entry, and is only written when that changes
+void TestWakeScheduler::add()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    QVERIFY(!scheduler->add(now.addSecs(-60), 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(!scheduler->add(now.addSecs(3600), 0, "reboot", 1000));
+
+    QDateTime later = now.addSecs(7200);
+    QVERIFY(scheduler->add(later, 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(later));
+
+    resetAlarm();
+    QDateTime earlier = now.addSecs(3600);
+    uint id = scheduler->add(earlier, 0, WAKE_ACTION_NONE, 1001);
+    QVERIFY(id);
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(earlier));
+
+    resetAlarm();
+    QVERIFY(scheduler->add(now.addSecs(10800), 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(settle());
+    QVERIFY(alarm().isEmpty());
+
+    QList<WakeEntry> entries = scheduler->entries();
+    QCOMPARE(entries.size(), 3);
+    QCOMPARE(entries.first().id, id);
+    QCOMPARE(scheduler->next(), earlier);
+}
+
+// owner or root, the alarm is cleared with the last entry
+void TestWakeScheduler::cancel()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    QDateTime later = now.addSecs(7200);
+    uint first = scheduler->add(later, 0, WAKE_ACTION_NONE, 1000);
+    uint second = scheduler->add(now.addSecs(3600), 0, WAKE_ACTION_NONE, 1000);
+    QVERIFY(first && second);
+    QVERIFY(settle());
+
+    QVERIFY(!scheduler->cancel(second, 1001));
+    QVERIFY(!scheduler->cancel(second+1, 0));
+
+    resetAlarm();
+    QVERIFY(scheduler->cancel(second, 1000));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(later));
+
+    resetAlarm();
+    QVERIFY(scheduler->cancel(first, 0));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), QByteArray("0"));
+    QVERIFY(scheduler->entries().isEmpty());
+}
+
+// one plain alarm per user, other entries are kept
+void TestWakeScheduler::replace()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    QVERIFY(scheduler->add(now.addSecs(3600), 86400, WAKE_ACTION_NONE, 1000));
+    QVERIFY(scheduler->replace(now.addSecs(1800), 1000));
+    QVERIFY(scheduler->replace(now.addSecs(1200), 1000));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(now.addSecs(1200)));
+    QCOMPARE(scheduler->entries().size(), 2);
+
+    resetAlarm();
+    QVERIFY(scheduler->replace(now.addSecs(2400), 1000));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(now.addSecs(2400)));
+    QCOMPARE(scheduler->entries().size(), 2);
+
+    QVERIFY(scheduler->replace(now.addSecs(4800), 1001));
+    QCOMPARE(scheduler->entries().size(), 3);
+
+    // a waiting caller gets the RTC written even if unchanged
+    QVERIFY(settle());
+    resetAlarm();
+    WorkBatch *batch = new WorkBatch(QDBusConnection::systemBus(), QDBusMessage(), 1);
+    QVERIFY(scheduler->replace(now.addSecs(2400), 1000, batch));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(now.addSecs(2400)));
+    QCOMPARE(scheduler->entries().size(), 3);
+}
+
+// due entries are dropped or moved forward, and the RTC follows
+void TestWakeScheduler::check()
+{
+    QDateTime now = QDateTime::currentDateTime();
+    QDateTime due = now.addSecs(2);
+    QVERIFY(scheduler->add(due, 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(scheduler->add(due, 3600, WAKE_ACTION_NONE, 1000));
+    QVERIFY(scheduler->add(now.addSecs(7200), 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(due));
+
+    resetAlarm();
+    QTRY_COMPARE_WITH_TIMEOUT(scheduler->entries().size(), 2, 10000);
+    QCOMPARE(scheduler->next(), due.addSecs(3600));
+    QVERIFY(settle());
+    QCOMPARE(alarm(), stamp(due.addSecs(3600)));
+}
+
+// recurring entries from long ago are moved forward in one step
+void TestWakeScheduler::farPast()
+{
+    QVERIFY(!scheduler->add(QDateTime::currentDateTime(), 1, WAKE_ACTION_NONE, 1000));
+    QDateTime epoch = QDateTime::fromString("1970-01-01 00:00:00", WAKE_DATE_FORMAT);
+    QElapsedTimer timer;
+    timer.start();
+    QVERIFY(scheduler->add(epoch, WAKE_MIN_INTERVAL, WAKE_ACTION_NONE, 1000));
+    QVERIFY(timer.elapsed()<1000);
+    QDateTime next = scheduler->next();
+    QDateTime now = QDateTime::currentDateTime();
+    QVERIFY(next>now);
+    QVERIFY(now.secsTo(next) <= WAKE_MIN_INTERVAL);
+    QCOMPARE(epoch.secsTo(next)%WAKE_MIN_INTERVAL, (qint64)0);
+
+    QStringList state;
+    state << QString("1;1000;0001-01-01 00:00:00;%1;none").arg(WAKE_MIN_INTERVAL);
+    timer.restart();
+    scheduler->restore(state);
+    QVERIFY(timer.elapsed()<1000);
+    QCOMPARE(scheduler->entries().size(), 1);
+    QVERIFY(scheduler->next()>now);
+}
+
+// actions run as root, other users may only wake the machine
+void TestWakeScheduler::rootActions()
+{
+    QDateTime date = QDateTime::currentDateTime().addSecs(3600);
+    QVERIFY(!scheduler->add(date, 0, WAKE_ACTION_SUSPEND, 1000));
+    QVERIFY(!scheduler->add(date, 86400, WAKE_ACTION_MAINTENANCE, 1000));
+    QVERIFY(scheduler->add(date, 0, WAKE_ACTION_NONE, 1000));
+    QVERIFY(scheduler->add(date, 86400, WAKE_ACTION_MAINTENANCE, 0));
+
+    // nor sneak them in through the state file
+    QStringList state;
+    state << QString("1;1000;%1;0;suspend").arg(date.toString(WAKE_DATE_FORMAT));
+    state << QString("2;0;%1;0;suspend").arg(date.toString(WAKE_DATE_FORMAT));
+    scheduler->restore(state);
+    QCOMPARE(scheduler->entries().size(), 1);
+    QCOMPARE(scheduler->entries().first().uid, (uint)0);
+}
+
+QTEST_GUILESS_MAIN(TestWakeScheduler)
+#include "tst_wakescheduler.moc"
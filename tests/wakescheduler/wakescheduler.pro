@@ -0,0 +1,18 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+
+QT -= gui
+TARGET = tst_wakescheduler
+include(../tests.pri)
+
+INCLUDEPATH += ../../daemon
+SOURCES += tst_wakescheduler.cpp \
+    ../../daemon/workqueue.cpp \
+    ../../daemon/scheduler.cpp
+HEADERS += ../../daemon/workqueue.h \
+    ../../daemon/scheduler.h